@@ -22,9 +22,18 @@ struct InstanceData {
     uint vertexOffset;
     uint indexOffset;
     uint materialIndex;
-    uint pad;
+    uint meshIndex;
 };
 
+// Whether the pipeline writes first-hit AOVs (Renderer's normal/depth,
+// albedo and ID images). A preprocessor switch rather than a specialization
+// constant because it sizes the payload below, which every closest-hit and
+// miss invocation carries: CMake builds each shader that uses the payload a
+// second time with -DWRITE_AOVS=1 and RTPipeline picks one set.
+#ifndef WRITE_AOVS
+#define WRITE_AOVS 0
+#endif
+
 // Path-tracing payload (location 0).
 // Produced by closesthit / miss; consumed by raygen.
 struct RayPayload {
@@ -34,6 +43,14 @@ struct RayPayload {
     vec3  direction;   // next ray direction
     bool  done;        // no further bounces needed
     uint  seed;        // RNG state carried through the bounce chain
+#if WRITE_AOVS
+    // AOVs of this hit; raygen keeps the primary hit's
+    vec3  normal;      // shading normal; towards the viewer on emitters and the sky
+    float hitT;        // ray distance, the miss distance for the sky
+    vec3  albedo;      // base colour; 1 on emitters and the sky
+    int   instanceId;  // InstanceData index, -1 for the sky
+    int   materialId;  // scene material index, -1 for the sky
+#endif
 };
 
 // PCG-based random number generator ----------------------------------------
@@ -0,0 +1,176 @@
+// Shared by the closest-hit shaders (one per material type). Each includes
+// this after common.glsl and implements only its own BRDF.
+// Requires GL_EXT_ray_tracing and GL_EXT_scalar_block_layout.
+
+// ---------------------------------------------------------------------------
+// Bindings
+// ---------------------------------------------------------------------------
+layout(binding = 0, set = 0) uniform accelerationStructureEXT tlas;
+
+layout(binding = 3, set = 0, scalar) readonly buffer VertexBuf   { Vertex       vertices[];  };
+layout(binding = 4, set = 0, scalar) readonly buffer IndexBuf    { uint         indices[];   };
+layout(binding = 5, set = 0, scalar) readonly buffer InstBuf     { InstanceData instances[]; };
+
+// Hit record data: the material of the instance (one record per material,
+// selected by instanceShaderBindingTableRecordOffset)
+layout(shaderRecordEXT, scalar) buffer HitRecord { Material mat; } record;
+
+layout(location = 0) rayPayloadInEXT RayPayload payload;
+layout(location = 1) rayPayloadEXT   float      shadowPayload;
+
+hitAttributeEXT vec2 baryCoords;
+
+// ---------------------------------------------------------------------------
+// Constants
+// ---------------------------------------------------------------------------
+const float PI     = 3.14159265358979;
+const vec3  SUN_DIR   = normalize(vec3(0.5, 1.0, 0.3));
+const vec3  SUN_COLOR = vec3(2.2, 2.0, 1.8);
+
+// ---------------------------------------------------------------------------
+// GGX / PBR helper functions
+// ---------------------------------------------------------------------------
+
+float D_GGX(float NdotH, float a2) {
+    float d = NdotH * NdotH * (a2 - 1.0) + 1.0;
+    return a2 / max(PI * d * d, 1e-7);
+}
+
+float G_SchlickGGX(float NdotV, float k) {
+    return NdotV / max(NdotV * (1.0 - k) + k, 1e-7);
+}
+
+float G_Smith(float NdotV, float NdotL, float roughness) {
+    float r = roughness + 1.0;
+    float k = (r * r) / 8.0;
+    return G_SchlickGGX(max(NdotV, 0.0), k)
+         * G_SchlickGGX(max(NdotL, 0.0), k);
+}
+
+vec3 F_Schlick(float cosTheta, vec3 F0) {
+    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+// Build a tangent frame around N
+void buildFrame(vec3 N, out vec3 T, out vec3 B) {
+    vec3 up = abs(N.z) < 0.999 ? vec3(0, 0, 1) : vec3(1, 0, 0);
+    T = normalize(cross(up, N));
+    B = cross(N, T);
+}
+
+vec3 toWorld(vec3 local, vec3 N, vec3 T, vec3 B) {
+    return normalize(local.x * T + local.y * B + local.z * N);
+}
+
+// GGX importance sampling — returns a HALF vector in world space
+vec3 sampleGGX(vec2 xi, vec3 N, float roughness) {
+    float a  = roughness * roughness;
+    float a2 = a * a;
+    float phi      = 2.0 * PI * xi.x;
+    float cosTheta = sqrt((1.0 - xi.y) / max(1.0 + (a2 - 1.0) * xi.y, 1e-7));
+    float sinTheta = sqrt(max(1.0 - cosTheta * cosTheta, 0.0));
+
+    vec3 T, B;
+    buildFrame(N, T, B);
+    return toWorld(vec3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta), N, T, B);
+}
+
+// Cosine-weighted hemisphere sample — returns a world-space direction
+vec3 sampleCosineHemi(vec2 xi, vec3 N) {
+    float phi = 2.0 * PI * xi.x;
+    float r   = sqrt(xi.y);
+    vec3 T, B;
+    buildFrame(N, T, B);
+    return toWorld(vec3(r * cos(phi), r * sin(phi), sqrt(max(1.0 - xi.y, 0.0))), N, T, B);
+}
+
+// ---------------------------------------------------------------------------
+// Hit point
+// ---------------------------------------------------------------------------
+struct Surface {
+    vec3 pos;       // world-space hit position
+    vec3 N;         // world normal, facing the incoming ray
+    vec3 V;         // direction back along the incoming ray
+};
+
+Surface fetchSurface()
+{
+    InstanceData inst = instances[gl_InstanceCustomIndexEXT];
+
+    uint i0 = indices[inst.indexOffset + gl_PrimitiveID * 3 + 0];
+    uint i1 = indices[inst.indexOffset + gl_PrimitiveID * 3 + 1];
+    uint i2 = indices[inst.indexOffset + gl_PrimitiveID * 3 + 2];
+
+    Vertex v0 = vertices[inst.vertexOffset + i0];
+    Vertex v1 = vertices[inst.vertexOffset + i1];
+    Vertex v2 = vertices[inst.vertexOffset + i2];
+
+    vec3 bary = vec3(1.0 - baryCoords.x - baryCoords.y,
+                     baryCoords.x, baryCoords.y);
+
+    vec3 localPos  = v0.pos    * bary.x + v1.pos    * bary.y + v2.pos    * bary.z;
+    vec3 localNorm = v0.normal * bary.x + v1.normal * bary.y + v2.normal * bary.z;
+
+    Surface s;
+    // gl_ObjectToWorldEXT is mat4x3 (4 cols, 3 rows)
+    s.pos = vec3(gl_ObjectToWorldEXT * vec4(localPos, 1.0));
+    // Normal: multiply by transpose(inverse(M)) = localNorm * WorldToObject
+    s.N   = normalize(localNorm * mat3(gl_WorldToObjectEXT));
+    s.V   = -normalize(gl_WorldRayDirectionEXT);
+
+    // Ensure normal faces the incoming ray
+    if (dot(s.N, s.V) < 0.0) s.N = -s.N;
+
+    // AOVs (raygen keeps the primary hit's)
+#if WRITE_AOVS
+    payload.normal     = s.N;
+    payload.hitT       = gl_HitTEXT;
+    payload.albedo     = record.mat.baseColor;
+    payload.instanceId = gl_InstanceCustomIndexEXT;
+    payload.materialId = int(inst.materialIndex);
+#endif
+    return s;
+}
+
+// Emissive surfaces end the path with their own radiance
+bool emit(uint seed)
+{
+    if (dot(record.mat.emissive, record.mat.emissive) <= 0.001)
+        return false;
+    payload.radiance = record.mat.emissive;
+    payload.done     = true;
+    payload.seed     = seed;
+#if WRITE_AOVS
+    payload.normal     = -normalize(gl_WorldRayDirectionEXT);
+    payload.hitT       = gl_HitTEXT;
+    payload.albedo     = vec3(1.0);
+    payload.instanceId = gl_InstanceCustomIndexEXT;
+    payload.materialId = int(instances[gl_InstanceCustomIndexEXT].materialIndex);
+#endif
+    return true;
+}
+
+// Sun visibility from `hitPos` (1 = lit)
+float traceShadow(vec3 hitPos)
+{
+    shadowPayload = 0.0;
+    traceRayEXT(tlas,
+                gl_RayFlagsTerminateOnFirstHitEXT |
+                gl_RayFlagsSkipClosestHitShaderEXT,
+                0xFF,
+                0, 0,   // SBT offset / stride
+                1,      // miss index 1 → shadow.rmiss
+                hitPos, 1e-3, SUN_DIR, 1e4,
+                1);     // payload location 1
+    return shadowPayload;
+}
+
+void continuePath(vec3 radiance, vec3 throughput, vec3 origin, vec3 direction, uint seed)
+{
+    payload.radiance   = radiance;
+    payload.throughput = throughput;
+    payload.origin     = origin;
+    payload.direction  = direction;
+    payload.done       = false;
+    payload.seed       = seed;
+}
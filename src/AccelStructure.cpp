@@ -1,130 +1,280 @@
 #include "AccelStructure.h"
+#include "CpuProfiler.h"
 #include "types.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <stdexcept>
 #include <iostream>
 
 // ---------------------------------------------------------------------------
-// buildSingleBLAS
+// buildBLASes
+//
+// All BLASes are recorded into one command buffer and submitted once. Builds
+// are grouped into batches whose scratch regions fit a single shared arena;
+// each batch is one cmdBuildAccelerationStructures call, and a barrier between
+// batches lets the next one reuse the arena.
 // ---------------------------------------------------------------------------
 
-BLAS AccelStructure::buildSingleBLAS(VulkanContext& ctx,
-                                      const MeshData& mesh,
-                                      VkDeviceAddress vertexBaseAddress,
-                                      VkDeviceAddress indexBaseAddress,
-                                      uint32_t        vertexOffset,
-                                      uint32_t        indexOffset)
+void AccelStructure::buildBLASes(VulkanContext& ctx, const Scene& scene)
 {
-    // Triangle geometry description
-    VkAccelerationStructureGeometryTrianglesDataKHR triData{
-        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR};
-    triData.vertexFormat             = VK_FORMAT_R32G32B32_SFLOAT;
-    triData.vertexData.deviceAddress = vertexBaseAddress + vertexOffset * sizeof(Vertex);
-    triData.vertexStride             = sizeof(Vertex);
-    triData.maxVertex                = static_cast<uint32_t>(mesh.vertices.size()) - 1;
-    triData.indexType                = VK_INDEX_TYPE_UINT32;
-    triData.indexData.deviceAddress  = indexBaseAddress + indexOffset * sizeof(uint32_t);
+    CPU_ZONE("AccelStructure::buildBLASes");
+    auto t0 = std::chrono::steady_clock::now();
 
-    VkAccelerationStructureGeometryKHR geometry{
-        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR};
-    geometry.geometryType       = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-    geometry.geometry.triangles = triData;
-    geometry.flags              = VK_GEOMETRY_OPAQUE_BIT_KHR;
+    const size_t count = scene.meshes.size();
+    if (count == 0)
+        return;
 
-    // Query sizes
-    VkAccelerationStructureBuildGeometryInfoKHR buildInfo{
-        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR};
-    buildInfo.type          = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-    buildInfo.flags         = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-    buildInfo.geometryCount = 1;
-    buildInfo.pGeometries   = &geometry;
+    std::vector<MeshRange> layout;
+    size_t vertexCount, indexCount;
+    scene.layoutMeshes(layout, vertexCount, indexCount);
 
-    uint32_t primitiveCount = static_cast<uint32_t>(mesh.indices.size()) / 3;
+    std::vector<VkAccelerationStructureGeometryKHR>          geometries(count);
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos(count);
+    std::vector<VkAccelerationStructureBuildRangeInfoKHR>    ranges(count);
+    std::vector<VkDeviceSize>                                scratchSizes(count);
 
-    VkAccelerationStructureBuildSizesInfoKHR sizeInfo{
-        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR};
-    ctx.rt.getAccelerationStructureBuildSizes(
-        ctx.device,
-        VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-        &buildInfo, &primitiveCount, &sizeInfo);
+    const VkDeviceSize scratchAlign =
+        std::max<VkDeviceSize>(1, ctx.asProperties.minAccelerationStructureScratchOffsetAlignment);
 
-    // Allocate AS storage buffer
-    BLAS blas{};
-    blas.buffer = ctx.createBuffer(
-        sizeInfo.accelerationStructureSize,
-        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR |
-        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    VkDeviceSize asMemory   = 0;
+    VkDeviceSize maxScratch = 0;
+    VkDeviceSize sumScratch = 0;
+    size_t       triangles  = 0;
 
-    // Create AS handle
-    VkAccelerationStructureCreateInfoKHR createInfo{
-        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
-    createInfo.buffer = blas.buffer.buffer;
-    createInfo.size   = sizeInfo.accelerationStructureSize;
-    createInfo.type   = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-    ctx.rt.createAccelerationStructure(ctx.device, &createInfo, nullptr, &blas.handle);
+    blases.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const MeshData& mesh = scene.meshes[i];
 
-    // Scratch buffer (aligned to hardware requirement)
-    uint32_t scratchAlign = ctx.asProperties.minAccelerationStructureScratchOffsetAlignment;
-    VkDeviceSize scratchSize = sizeInfo.buildScratchSize +
-                               alignUp(static_cast<uint32_t>(sizeInfo.buildScratchSize),
-                                       scratchAlign);
+        // Triangle geometry description
+        VkAccelerationStructureGeometryTrianglesDataKHR triData{
+            VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR};
+        triData.vertexFormat             = VK_FORMAT_R32G32B32_SFLOAT;
+        triData.vertexData.deviceAddress = scene.vertexBuffer.address + layout[i].vertexOffset * sizeof(Vertex);
+        triData.vertexStride             = sizeof(Vertex);
+        triData.maxVertex                = mesh.vertexCount() - 1;
+        triData.indexType                = VK_INDEX_TYPE_UINT32;
+        triData.indexData.deviceAddress  = scene.indexBuffer.address + layout[i].indexOffset * sizeof(uint32_t);
+
+        VkAccelerationStructureGeometryKHR& geometry = geometries[i];
+        geometry = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR};
+        geometry.geometryType       = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+        geometry.geometry.triangles = triData;
+        geometry.flags              = VK_GEOMETRY_OPAQUE_BIT_KHR;
+
+        VkAccelerationStructureBuildGeometryInfoKHR& buildInfo = buildInfos[i];
+        buildInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR};
+        buildInfo.type          = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        buildInfo.flags         = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+        if (compactBLASes)
+            buildInfo.flags    |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+        buildInfo.mode          = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+        buildInfo.geometryCount = 1;
+        buildInfo.pGeometries   = &geometry;
+
+        uint32_t primitiveCount = mesh.indexCount() / 3;
+        ranges[i] = {};
+        ranges[i].primitiveCount = primitiveCount;
+        triangles += primitiveCount;
+
+        // Query sizes
+        VkAccelerationStructureBuildSizesInfoKHR sizeInfo{
+            VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR};
+        ctx.rt.getAccelerationStructureBuildSizes(
+            ctx.device,
+            VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+            &buildInfo, &primitiveCount, &sizeInfo);
+
+        // Allocate AS storage buffer and handle
+        BLAS& blas = blases[i];
+        blas.buffer = ctx.createBuffer(
+            sizeInfo.accelerationStructureSize,
+            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+
+        VkAccelerationStructureCreateInfoKHR createInfo{
+            VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
+        createInfo.buffer = blas.buffer.buffer;
+        createInfo.size   = sizeInfo.accelerationStructureSize;
+        createInfo.type   = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        ctx.rt.createAccelerationStructure(ctx.device, &createInfo, nullptr, &blas.handle);
+        buildInfo.dstAccelerationStructure = blas.handle;
+        blas.size      = sizeInfo.accelerationStructureSize;
+        blas.builtSize = sizeInfo.accelerationStructureSize;
+
+        scratchSizes[i] = alignUp(sizeInfo.buildScratchSize, scratchAlign);
+        maxScratch      = std::max(maxScratch, scratchSizes[i]);
+        sumScratch     += scratchSizes[i];
+        asMemory       += sizeInfo.accelerationStructureSize;
+    }
+
+    // Scratch arena: everything at once if it fits the budget, otherwise the
+    // budget (or the largest single build, if that is bigger still)
+    const VkDeviceSize arenaSize = std::min(sumScratch, std::max(blasScratchBudget, maxScratch));
 
     AllocatedBuffer scratch = ctx.createBuffer(
-        scratchSize,
+        arenaSize + scratchAlign,
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    const VkDeviceAddress scratchBase = alignUp(scratch.address, scratchAlign);
+
+    // Compacted sizes are queried in the same submission as the builds
+    VkQueryPool sizeQueries = VK_NULL_HANDLE;
+    if (compactBLASes) {
+        VkQueryPoolCreateInfo queryInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        queryInfo.queryType  = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+        queryInfo.queryCount = static_cast<uint32_t>(count);
+        if (vkCreateQueryPool(ctx.device, &queryInfo, nullptr, &sizeQueries) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create BLAS compaction query pool");
+    }
 
-    // Align scratch address
-    VkDeviceAddress scratchAddr = scratch.address;
-    if (scratchAlign > 1)
-        scratchAddr = (scratchAddr + scratchAlign - 1) & ~VkDeviceAddress(scratchAlign - 1);
-
-    // Build
-    buildInfo.mode                     = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-    buildInfo.dstAccelerationStructure = blas.handle;
-    buildInfo.scratchData.deviceAddress = scratchAddr;
-
-    VkAccelerationStructureBuildRangeInfoKHR range{};
-    range.primitiveCount = primitiveCount;
-    const VkAccelerationStructureBuildRangeInfoKHR* pRange = &range;
-
+    // Record every batch into one command buffer
     VkCommandBuffer cmd = ctx.beginSingleTimeCommands();
-    ctx.rt.cmdBuildAccelerationStructures(cmd, 1, &buildInfo, &pRange);
-    ctx.endSingleTimeCommands(cmd);
+    if (sizeQueries)
+        vkCmdResetQueryPool(cmd, sizeQueries, 0, static_cast<uint32_t>(count));
+
+    std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> rangePtrs(count);
+    uint32_t scope   = ctx.profiler.begin(cmd, "blas build");
+    uint32_t batches = 0;
+    size_t   first   = 0;
+    while (first < count) {
+        VkDeviceSize offset = 0;
+        size_t       last   = first;
+        while (last < count && offset + scratchSizes[last] <= arenaSize) {
+            buildInfos[last].scratchData.deviceAddress = scratchBase + offset;
+            rangePtrs[last] = &ranges[last];
+            offset += scratchSizes[last];
+            ++last;
+        }
+
+        if (batches > 0) {
+            // Previous batch must be done with the scratch arena
+            VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+            barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+            barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+                                    VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+            vkCmdPipelineBarrier(cmd,
+                VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+        ctx.rt.cmdBuildAccelerationStructures(cmd, static_cast<uint32_t>(last - first),
+                                              &buildInfos[first], &rangePtrs[first]);
+        ++batches;
+        first = last;
+    }
+    ctx.profiler.end(cmd, scope);
+
+    if (sizeQueries) {
+        // Builds must be complete before their compacted size is read
+        VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+        vkCmdPipelineBarrier(cmd,
+            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        std::vector<VkAccelerationStructureKHR> handles(count);
+        for (size_t i = 0; i < count; ++i)
+            handles[i] = blases[i].handle;
+        ctx.rt.cmdWriteAccelerationStructuresProperties(cmd, static_cast<uint32_t>(count), handles.data(),
+            VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, sizeQueries, 0);
+    }
 
+    ctx.endSingleTimeCommands(cmd);
     ctx.destroyBuffer(scratch);
 
-    // Get device address
-    VkAccelerationStructureDeviceAddressInfoKHR addrInfo{
-        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR};
-    addrInfo.accelerationStructure = blas.handle;
-    blas.address = ctx.rt.getAccelerationStructureDeviceAddress(ctx.device, &addrInfo);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "  " << count << " BLASes built — " << triangles << " triangles in "
+              << batches << (batches == 1 ? " batch, " : " batches, ") << ms << " ms, peak scratch "
+              << arenaSize / (1024.0 * 1024.0) << " MiB (budget "
+              << blasScratchBudget / (1024.0 * 1024.0) << " MiB), AS memory "
+              << asMemory / (1024.0 * 1024.0) << " MiB\n";
+
+    if (sizeQueries) {
+        compact(ctx, sizeQueries);
+        vkDestroyQueryPool(ctx.device, sizeQueries, nullptr);
+    }
 
-    return blas;
+    // Device addresses for the TLAS instances
+    for (BLAS& blas : blases) {
+        VkAccelerationStructureDeviceAddressInfoKHR addrInfo{
+            VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR};
+        addrInfo.accelerationStructure = blas.handle;
+        blas.address = ctx.rt.getAccelerationStructureDeviceAddress(ctx.device, &addrInfo);
+    }
 }
 
 // ---------------------------------------------------------------------------
-// buildBLASes
+// compact — copy each BLAS into an allocation of its compacted size and free
+// the original. `sizeQueries` holds one compacted-size result per BLAS.
 // ---------------------------------------------------------------------------
 
-void AccelStructure::buildBLASes(VulkanContext& ctx, const Scene& scene)
+void AccelStructure::compact(VulkanContext& ctx, VkQueryPool sizeQueries)
 {
-    uint32_t vertexOffset = 0;
-    uint32_t indexOffset  = 0;
+    CPU_ZONE("AccelStructure::compact");
+    auto t0 = std::chrono::steady_clock::now();
+
+    const uint32_t count = static_cast<uint32_t>(blases.size());
+    std::vector<VkDeviceSize> compactedSizes(count);
+    if (vkGetQueryPoolResults(ctx.device, sizeQueries, 0, count,
+                              count * sizeof(VkDeviceSize), compactedSizes.data(), sizeof(VkDeviceSize),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS)
+        throw std::runtime_error("Failed to read BLAS compacted sizes");
+
+    std::vector<BLAS> compacted(count);
+    VkCommandBuffer cmd   = ctx.beginSingleTimeCommands();
+    uint32_t        scope = ctx.profiler.begin(cmd, "blas compact");
+    for (uint32_t i = 0; i < count; ++i) {
+        BLAS& dst = compacted[i];
+        dst.size      = compactedSizes[i];
+        dst.builtSize = blases[i].builtSize;
+        dst.buffer    = ctx.createBuffer(
+            dst.size,
+            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+
+        VkAccelerationStructureCreateInfoKHR createInfo{
+            VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
+        createInfo.buffer = dst.buffer.buffer;
+        createInfo.size   = dst.size;
+        createInfo.type   = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        ctx.rt.createAccelerationStructure(ctx.device, &createInfo, nullptr, &dst.handle);
+
+        VkCopyAccelerationStructureInfoKHR copyInfo{VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR};
+        copyInfo.src  = blases[i].handle;
+        copyInfo.dst  = dst.handle;
+        copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+        ctx.rt.cmdCopyAccelerationStructure(cmd, &copyInfo);
+    }
+    ctx.profiler.end(cmd, scope);
+    ctx.endSingleTimeCommands(cmd);
 
-    for (size_t i = 0; i < scene.meshes.size(); ++i) {
-        const MeshData& mesh = scene.meshes[i];
-        blases.push_back(buildSingleBLAS(ctx, mesh,
-            scene.vertexBuffer.address,
-            scene.indexBuffer.address,
-            vertexOffset, indexOffset));
-
-        vertexOffset += static_cast<uint32_t>(mesh.vertices.size());
-        indexOffset  += static_cast<uint32_t>(mesh.indices.size());
-        std::cout << "  BLAS[" << i << "] built — " << mesh.indices.size() / 3 << " triangles\n";
+    // Originals are no longer referenced once the copies have completed
+    VkDeviceSize before = 0, after = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        before += blases[i].size;
+        after  += compacted[i].size;
+        ctx.rt.destroyAccelerationStructure(ctx.device, blases[i].handle, nullptr);
+        ctx.destroyBuffer(blases[i].buffer);
+    }
+    blases = std::move(compacted);
+
+    const double MiB = 1024.0 * 1024.0;
+    if (count <= 32) {
+        for (uint32_t i = 0; i < count; ++i)
+            std::cout << "    BLAS[" << i << "] " << blases[i].builtSize / 1024.0 << " KiB -> "
+                      << blases[i].size / 1024.0 << " KiB\n";
     }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "  BLAS compaction: " << before / MiB << " MiB -> " << after / MiB << " MiB (saved "
+              << (before - after) / MiB << " MiB, " << (before ? 100.0 * (before - after) / before : 0.0)
+              << "%) in " << ms << " ms\n";
 }
 
 // ---------------------------------------------------------------------------
@@ -133,73 +283,65 @@ void AccelStructure::buildBLASes(VulkanContext& ctx, const Scene& scene)
 
 void AccelStructure::buildTLAS(VulkanContext& ctx, const Scene& scene)
 {
-    // One VkAccelerationStructureInstanceKHR per scene instance
-    std::vector<VkAccelerationStructureInstanceKHR> vkInstances;
-    vkInstances.reserve(scene.instances.size());
-
-    for (size_t i = 0; i < scene.instances.size(); ++i) {
-        const SceneInstance& si = scene.instances[i];
-
-        VkAccelerationStructureInstanceKHR vkInst{};
-
-        // VkTransformMatrixKHR is row-major 3x4; GLM is column-major 4x4
-        glm::mat4 rowMaj = glm::transpose(si.transform);
-        std::memcpy(&vkInst.transform, &rowMaj, sizeof(VkTransformMatrixKHR));
-
-        vkInst.instanceCustomIndex                    = si.meshIndex; // used in closesthit
-        vkInst.mask                                   = 0xFF;
-        vkInst.instanceShaderBindingTableRecordOffset = 0;
-        vkInst.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-        vkInst.accelerationStructureReference         = blases[si.meshIndex].address;
-
-        vkInstances.push_back(vkInst);
+    CPU_ZONE("AccelStructure::buildTLAS");
+    // instanceCustomIndex and instanceShaderBindingTableRecordOffset are 24 bits wide
+    if (scene.instances.size() > (1u << 24))
+        throw std::runtime_error("Too many instances for instanceCustomIndex");
+    if (scene.materials.size() > (1u << 24))
+        throw std::runtime_error("Too many materials for instanceShaderBindingTableRecordOffset");
+
+    tlasInstanceCount = static_cast<uint32_t>(scene.instances.size());
+    updatesSinceBuild = 0;
+    tlasRefits = tlasRebuilds = 0;
+
+    meshMin.resize(scene.meshes.size());
+    meshMax.resize(scene.meshes.size());
+    for (size_t m = 0; m < scene.meshes.size(); ++m)
+        scene.meshes[m].bounds(meshMin[m], meshMax[m]);
+
+    // Per-frame instance buffers: written in place by the host every update,
+    // so there is no staging copy on the way
+    VkDeviceSize instSize = std::max<VkDeviceSize>(1, tlasInstanceCount) *
+                            sizeof(VkAccelerationStructureInstanceKHR);
+    instanceBuffers.resize(ctx.framesInFlight);
+    instancesMapped.resize(ctx.framesInFlight);
+    for (uint32_t f = 0; f < ctx.framesInFlight; ++f) {
+        instanceBuffers[f] = ctx.createBuffer(
+            instSize,
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+            VMA_MEMORY_USAGE_AUTO,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+            VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+        VmaAllocationInfo ai{};
+        vmaGetAllocationInfo(ctx.allocator, instanceBuffers[f].allocation, &ai);
+        instancesMapped[f] = static_cast<VkAccelerationStructureInstanceKHR*>(ai.pMappedData);
     }
 
-    VkDeviceSize instSize = vkInstances.size() * sizeof(VkAccelerationStructureInstanceKHR);
-
-    // Upload instance data
-    AllocatedBuffer staging = ctx.createBuffer(
-        instSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VMA_MEMORY_USAGE_AUTO,
-        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-
-    void* mapped;
-    vmaMapMemory(ctx.allocator, staging.allocation, &mapped);
-    std::memcpy(mapped, vkInstances.data(), instSize);
-    vmaUnmapMemory(ctx.allocator, staging.allocation);
-
-    instanceBuffer = ctx.createBuffer(
-        instSize,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
-
-    // Copy and barrier in one command buffer, then build TLAS
-    VkAccelerationStructureGeometryInstancesDataKHR instData{
-        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR};
-    instData.data.deviceAddress = instanceBuffer.address;
+    writeInstances(0, ctx, scene);
+    captureInstanceBounds(scene);
 
+    // Sizes (same geometry description recordTLASBuild uses)
     VkAccelerationStructureGeometryKHR geometry{
         VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR};
-    geometry.geometryType          = VK_GEOMETRY_TYPE_INSTANCES_KHR;
-    geometry.geometry.instances    = instData;
+    geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+    geometry.geometry.instances.sType =
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
 
     VkAccelerationStructureBuildGeometryInfoKHR buildInfo{
         VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR};
     buildInfo.type          = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-    buildInfo.flags         = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+    buildInfo.flags         = tlasFlags();
     buildInfo.geometryCount = 1;
     buildInfo.pGeometries   = &geometry;
 
-    uint32_t primitiveCount = static_cast<uint32_t>(vkInstances.size());
-
     VkAccelerationStructureBuildSizesInfoKHR sizeInfo{
         VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR};
     ctx.rt.getAccelerationStructureBuildSizes(
         ctx.device,
         VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-        &buildInfo, &primitiveCount, &sizeInfo);
+        &buildInfo, &tlasInstanceCount, &sizeInfo);
 
     // Allocate TLAS storage
     tlasBuffer = ctx.createBuffer(
@@ -214,46 +356,183 @@ void AccelStructure::buildTLAS(VulkanContext& ctx, const Scene& scene)
     createInfo.type   = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
     ctx.rt.createAccelerationStructure(ctx.device, &createInfo, nullptr, &tlas);
 
-    // Scratch
-    uint32_t scratchAlign = ctx.asProperties.minAccelerationStructureScratchOffsetAlignment;
-    AllocatedBuffer scratch = ctx.createBuffer(
-        sizeInfo.buildScratchSize + scratchAlign,
+    // Scratch is kept for the per-frame updates and rebuilds
+    const VkDeviceSize scratchAlign =
+        std::max<VkDeviceSize>(1, ctx.asProperties.minAccelerationStructureScratchOffsetAlignment);
+    VkDeviceSize scratchSize = sizeInfo.buildScratchSize;
+    if (allowTLASUpdate)
+        scratchSize = std::max(scratchSize, sizeInfo.updateScratchSize);
+    tlasScratch = ctx.createBuffer(
+        scratchSize + scratchAlign,
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    tlasScratchAddress = alignUp(tlasScratch.address, scratchAlign);
 
-    VkDeviceAddress scratchAddr = scratch.address;
-    if (scratchAlign > 1)
-        scratchAddr = (scratchAddr + scratchAlign - 1) & ~VkDeviceAddress(scratchAlign - 1);
+    // Host writes to the instance buffer are visible to the submission
+    VkCommandBuffer cmd = ctx.beginSingleTimeCommands();
+    {
+        GpuScope scope(ctx.profiler, cmd, "tlas build");
+        recordTLASBuild(cmd, 0, false, ctx);
+    }
+    ctx.endSingleTimeCommands(cmd);
 
-    buildInfo.mode                      = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-    buildInfo.dstAccelerationStructure  = tlas;
-    buildInfo.scratchData.deviceAddress = scratchAddr;
+    std::cout << "  TLAS built — " << tlasInstanceCount << " instances"
+              << (allowTLASUpdate ? " (updatable)" : "") << "\n";
+}
 
-    VkAccelerationStructureBuildRangeInfoKHR range{};
-    range.primitiveCount = primitiveCount;
-    const VkAccelerationStructureBuildRangeInfoKHR* pRange = &range;
+// ---------------------------------------------------------------------------
+// updateTLAS — per-frame refit, recorded into the frame's command buffer
+// ---------------------------------------------------------------------------
 
-    // Single command buffer: copy instances → barrier → build TLAS
-    VkCommandBuffer cmd = ctx.beginSingleTimeCommands();
+void AccelStructure::updateTLAS(VkCommandBuffer cmd, uint32_t frame,
+                                VulkanContext& ctx, const Scene& scene)
+{
+    CPU_ZONE("AccelStructure::updateTLAS");
+    if (scene.instances.size() != tlasInstanceCount)
+        throw std::runtime_error("updateTLAS: instance count changed since buildTLAS");
+
+    float growth = writeInstances(frame, ctx, scene);
+
+    bool rebuild = !allowTLASUpdate ||
+                   ++updatesSinceBuild >= tlasRebuildInterval ||
+                   growth > tlasRebuildThreshold;
+    if (rebuild) {
+        captureInstanceBounds(scene);
+        updatesSinceBuild = 0;
+        ++tlasRebuilds;
+    } else {
+        ++tlasRefits;
+    }
+
+    // The previous frame's traversal and build (same TLAS, same scratch) must
+    // be finished before this build overwrites them
+    VkMemoryBarrier before{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    before.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    before.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+                           VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    vkCmdPipelineBarrier(cmd,
+        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR |
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        0, 1, &before, 0, nullptr, 0, nullptr);
 
-    VkBufferCopy copyRegion{0, 0, instSize};
-    vkCmdCopyBuffer(cmd, staging.buffer, instanceBuffer.buffer, 1, &copyRegion);
+    {
+        GpuScope scope(ctx.profiler, cmd, rebuild ? "tlas rebuild" : "tlas refit");
+        recordTLASBuild(cmd, frame, !rebuild, ctx);
+    }
 
-    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    VkMemoryBarrier after{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    after.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    after.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
     vkCmdPipelineBarrier(cmd,
-        VK_PIPELINE_STAGE_TRANSFER_BIT,
         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
-        0, 1, &barrier, 0, nullptr, 0, nullptr);
+        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+        0, 1, &after, 0, nullptr, 0, nullptr);
+}
+
+VkBuildAccelerationStructureFlagsKHR AccelStructure::tlasFlags() const
+{
+    VkBuildAccelerationStructureFlagsKHR flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+    if (allowTLASUpdate)
+        flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+    return flags;
+}
+
+void AccelStructure::recordTLASBuild(VkCommandBuffer cmd, uint32_t frame, bool update,
+                                     VulkanContext& ctx)
+{
+    VkAccelerationStructureGeometryInstancesDataKHR instData{
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR};
+    instData.data.deviceAddress = instanceBuffers[frame].address;
+
+    VkAccelerationStructureGeometryKHR geometry{
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR};
+    geometry.geometryType       = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+    geometry.geometry.instances = instData;
+
+    VkAccelerationStructureBuildGeometryInfoKHR buildInfo{
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR};
+    buildInfo.type                      = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+    buildInfo.flags                     = tlasFlags();
+    buildInfo.mode                      = update ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR
+                                                 : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    buildInfo.srcAccelerationStructure  = update ? tlas : VK_NULL_HANDLE;   // refit in place
+    buildInfo.dstAccelerationStructure  = tlas;
+    buildInfo.geometryCount             = 1;
+    buildInfo.pGeometries               = &geometry;
+    buildInfo.scratchData.deviceAddress = tlasScratchAddress;
+
+    VkAccelerationStructureBuildRangeInfoKHR range{};
+    range.primitiveCount = tlasInstanceCount;
+    const VkAccelerationStructureBuildRangeInfoKHR* pRange = &range;
 
     ctx.rt.cmdBuildAccelerationStructures(cmd, 1, &buildInfo, &pRange);
+}
 
-    ctx.endSingleTimeCommands(cmd);
+// World-space AABB of an instance from its mesh bounds (Arvo: transform the
+// centre, grow the half-extent by |M|)
+void AccelStructure::instanceBounds(const SceneInstance& si, glm::vec3& min, glm::vec3& max) const
+{
+    const glm::vec3& lo = meshMin[si.meshIndex];
+    const glm::vec3& hi = meshMax[si.meshIndex];
+    if (lo.x > hi.x) {
+        min = max = glm::vec3(si.transform[3]);
+        return;
+    }
+    glm::vec3 c = glm::vec3(si.transform * glm::vec4((lo + hi) * 0.5f, 1.0f));
+    glm::vec3 e = (hi - lo) * 0.5f;
+    glm::vec3 r{0.0f};
+    for (int col = 0; col < 3; ++col)
+        r += glm::abs(glm::vec3(si.transform[col])) * e[col];
+    min = c - r;
+    max = c + r;
+}
 
-    ctx.destroyBuffer(staging);
-    ctx.destroyBuffer(scratch);
+void AccelStructure::captureInstanceBounds(const Scene& scene)
+{
+    builtMin.resize(scene.instances.size());
+    builtMax.resize(scene.instances.size());
+    for (size_t i = 0; i < scene.instances.size(); ++i)
+        instanceBounds(scene.instances[i], builtMin[i], builtMax[i]);
+}
+
+float AccelStructure::writeInstances(uint32_t frame, VulkanContext& ctx, const Scene& scene)
+{
+    auto area = [](const glm::vec3& min, const glm::vec3& max) {
+        glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    };
+
+    VkAccelerationStructureInstanceKHR* dst = instancesMapped[frame];
+    const bool haveBuilt = builtMin.size() == scene.instances.size();
+    double currentArea = 0.0, unionArea = 0.0;
+
+    for (size_t i = 0; i < scene.instances.size(); ++i) {
+        const SceneInstance& si = scene.instances[i];
+
+        VkAccelerationStructureInstanceKHR vkInst{};
+
+        // VkTransformMatrixKHR is row-major 3x4; GLM is column-major 4x4
+        glm::mat4 rowMaj = glm::transpose(si.transform);
+        std::memcpy(&vkInst.transform, &rowMaj, sizeof(VkTransformMatrixKHR));
+
+        vkInst.instanceCustomIndex                    = static_cast<uint32_t>(i); // InstanceData index in the hit shaders
+        vkInst.mask                                   = 0xFF;
+        vkInst.instanceShaderBindingTableRecordOffset = si.materialIndex;           // hit record of its material
+        vkInst.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+        vkInst.accelerationStructureReference         = blases[si.meshIndex].address;
+
+        dst[i] = vkInst;   // whole-struct store into write-combined memory
+
+        if (haveBuilt) {
+            glm::vec3 lo, hi;
+            instanceBounds(si, lo, hi);
+            currentArea += area(lo, hi);
+            unionArea   += area(glm::min(lo, builtMin[i]), glm::max(hi, builtMax[i]));
+        }
+    }
+    vmaFlushAllocation(ctx.allocator, instanceBuffers[frame].allocation, 0, VK_WHOLE_SIZE);
 
-    std::cout << "  TLAS built — " << primitiveCount << " instances\n";
+    return currentArea > 0.0 ? static_cast<float>(unionArea / currentArea) : 1.0f;
 }
 
 // ---------------------------------------------------------------------------
@@ -270,5 +549,7 @@ void AccelStructure::destroy(VulkanContext& ctx)
     if (tlas != VK_NULL_HANDLE)
         ctx.rt.destroyAccelerationStructure(ctx.device, tlas, nullptr);
     ctx.destroyBuffer(tlasBuffer);
-    ctx.destroyBuffer(instanceBuffer);
+    ctx.destroyBuffer(tlasScratch);
+    for (AllocatedBuffer& buf : instanceBuffers)
+        ctx.destroyBuffer(buf);
 }
@@ -8,6 +8,8 @@ struct BLAS {
     VkAccelerationStructureKHR handle  = VK_NULL_HANDLE;
     AllocatedBuffer            buffer;
     VkDeviceAddress            address = 0;
+    VkDeviceSize               size      = 0;   // current AS storage size
+    VkDeviceSize               builtSize = 0;   // size as built, before compaction
 };
 
 class AccelStructure {
@@ -17,19 +19,66 @@ public:
     VkAccelerationStructureKHR tlas       = VK_NULL_HANDLE;
     AllocatedBuffer            tlasBuffer;
 
+    // Upper bound for the shared BLAS build scratch arena. Builds are packed
+    // into batches that fit; a single BLAS needing more gets an arena of its
+    // own size.
+    VkDeviceSize               blasScratchBudget = 256ull << 20;
+
+    // Copy every BLAS into a tightly sized allocation after the build
+    bool                       compactBLASes = true;
+
+    // TLAS updates. With allowTLASUpdate the TLAS is built updatable and
+    // updateTLAS() refits it in place; it is rebuilt from scratch instead
+    // every tlasRebuildInterval updates, or once the instances have moved far
+    // enough that refitted bounds would be loose: the summed surface area of
+    // each instance's (bounds at last build ∪ current bounds) exceeds
+    // tlasRebuildThreshold times that of its current bounds.
+    bool                       allowTLASUpdate      = true;
+    uint32_t                   tlasRebuildInterval  = 240;
+    float                      tlasRebuildThreshold = 1.5f;
+
+    // Counters since buildTLAS
+    uint32_t                   tlasRefits   = 0;
+    uint32_t                   tlasRebuilds = 0;
+
     void buildBLASes(VulkanContext& ctx, const Scene& scene);
     void buildTLAS  (VulkanContext& ctx, const Scene& scene);
+
+    // Record a refit (or rebuild, see above) of the TLAS from the current
+    // scene.instances into `cmd`, followed by a barrier for ray tracing
+    // reads. `frame` selects the per-frame instance buffer; the GPU must be
+    // done with that frame. The instance count must match buildTLAS.
+    void updateTLAS(VkCommandBuffer cmd, uint32_t frame,
+                    VulkanContext& ctx, const Scene& scene);
+
     void destroy    (VulkanContext& ctx);
 
 private:
-    AllocatedBuffer instanceBuffer; // lives as long as the TLAS
+    // Persistently mapped instance buffers, one per frame in flight; the
+    // build reads them straight from host-visible memory
+    std::vector<AllocatedBuffer>                     instanceBuffers;
+    std::vector<VkAccelerationStructureInstanceKHR*> instancesMapped;
+
+    AllocatedBuffer tlasScratch;             // sized for both build and update
+    VkDeviceAddress tlasScratchAddress = 0;
+    uint32_t        tlasInstanceCount  = 0;
+    uint32_t        updatesSinceBuild  = 0;
+
+    // Object-space bounds per mesh, world-space bounds per instance at the
+    // last full TLAS build
+    std::vector<glm::vec3> meshMin, meshMax;
+    std::vector<glm::vec3> builtMin, builtMax;
+
+    void compact(VulkanContext& ctx, VkQueryPool sizeQueries);
 
-    BLAS buildSingleBLAS(VulkanContext& ctx,
-                         const MeshData& mesh,
-                         VkDeviceAddress vertexBaseAddress,
-                         VkDeviceAddress indexBaseAddress,
-                         uint32_t        vertexOffset,
-                         uint32_t        indexOffset);
+    // Write scene.instances into instance buffer `frame`; returns the bounds
+    // growth ratio against the last full build (see tlasRebuildThreshold)
+    float writeInstances(uint32_t frame, VulkanContext& ctx, const Scene& scene);
+    void  captureInstanceBounds(const Scene& scene);
+    void  instanceBounds(const SceneInstance& si, glm::vec3& min, glm::vec3& max) const;
+    void  recordTLASBuild(VkCommandBuffer cmd, uint32_t frame, bool update,
+                          VulkanContext& ctx);
+    VkBuildAccelerationStructureFlagsKHR tlasFlags() const;
 
-    static uint32_t alignUp(uint32_t v, uint32_t a) { return (v + a - 1) & ~(a - 1); }
+    static VkDeviceSize alignUp(VkDeviceSize v, VkDeviceSize a) { return (v + a - 1) & ~(a - 1); }
 };
@@ -0,0 +1,290 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <utility>
+
+namespace {
+
+struct Bin {
+    Aabb     bounds;
+    uint32_t count = 0;
+};
+
+using BinSet = std::array<std::array<Bin, 16>, 3>;  // [axis][bin]
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// build
+// ---------------------------------------------------------------------------
+
+void Bvh::build(const std::vector<Aabb>& primBounds, uint32_t threadCount)
+{
+    static_assert(BIN_COUNT == 16, "BinSet is sized for 16 bins");
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    stats = {};
+    nodes.clear();
+    primIndices.resize(primBounds.size());
+    std::iota(primIndices.begin(), primIndices.end(), 0u);
+    if (primBounds.empty())
+        return;
+
+    BuildContext bc;
+    bc.primBounds = &primBounds;
+    bc.maxThreads = threadCount ? threadCount
+                                : std::max(1u, std::thread::hardware_concurrency());
+    bc.centroids.resize(primBounds.size());
+    for (size_t i = 0; i < primBounds.size(); ++i)
+        bc.centroids[i] = primBounds[i].centroid();
+
+    // A binary tree never needs more than 2N - 1 nodes. Node pairs are
+    // claimed with an atomic counter so subtrees can be built concurrently.
+    nodes.resize(primBounds.size() * 2);
+    bc.nodeCount = 1;
+
+    subdivide(bc, 0, 0, static_cast<uint32_t>(primBounds.size()), 1);
+
+    nodes.resize(bc.nodeCount.load());
+    nodes.shrink_to_fit();
+
+    stats.buildMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - t0).count();
+    computeStats();
+    assert(stats.maxDepth <= MAX_DEPTH);
+}
+
+// ---------------------------------------------------------------------------
+// subdivide — binned SAH split over all three axes
+// ---------------------------------------------------------------------------
+
+void Bvh::subdivide(BuildContext& bc, uint32_t nodeIdx, uint32_t first, uint32_t count,
+                    uint32_t depth)
+{
+    const std::vector<Aabb>&      bounds    = *bc.primBounds;
+    const std::vector<glm::vec3>& centroids = bc.centroids;
+
+    // ---- Node bounds + centroid bounds (threaded for huge nodes) ----------
+    auto gatherBounds = [&](uint32_t begin, uint32_t end, Aabb& b, Aabb& cb) {
+        for (uint32_t i = begin; i < end; ++i) {
+            b.grow(bounds[primIndices[i]]);
+            cb.grow(centroids[primIndices[i]]);
+        }
+    };
+
+    // Huge nodes split their bounds and binning passes across threads, but
+    // only across cores no subtree task is using: the extra workers are
+    // claimed in busyThreads like a fork and handed back once binned
+    uint32_t splitThreads = 1;
+    if (count >= PARALLEL_BIN_THRESHOLD) {
+        const uint32_t wanted = std::min<uint32_t>(bc.maxThreads, count / (PARALLEL_BIN_THRESHOLD / 4));
+        uint32_t busy  = bc.busyThreads.load();
+        uint32_t extra = 0;
+        do {
+            extra = busy < bc.maxThreads ? std::min(wanted - 1, bc.maxThreads - busy) : 0;
+        } while (extra > 0 && !bc.busyThreads.compare_exchange_weak(busy, busy + extra));
+        splitThreads = 1 + extra;
+    }
+
+    auto parallelChunks = [&](auto&& fn) {
+        std::vector<std::thread> pool;
+        const uint32_t chunk = (count + splitThreads - 1) / splitThreads;
+        for (uint32_t t = 1; t < splitThreads; ++t) {
+            uint32_t b = first + t * chunk;
+            uint32_t e = std::min(first + count, b + chunk);
+            if (b < e) pool.emplace_back(fn, t, b, e);
+        }
+        fn(0u, first, std::min(first + count, first + chunk));
+        for (auto& th : pool) th.join();
+    };
+
+    Aabb nodeBounds, centroidBounds;
+    if (splitThreads > 1) {
+        std::vector<std::pair<Aabb, Aabb>> partial(splitThreads);
+        parallelChunks([&](uint32_t t, uint32_t b, uint32_t e) {
+            gatherBounds(b, e, partial[t].first, partial[t].second);
+        });
+        for (auto& p : partial) { nodeBounds.grow(p.first); centroidBounds.grow(p.second); }
+    } else {
+        gatherBounds(first, first + count, nodeBounds, centroidBounds);
+    }
+
+    BvhNode& node    = nodes[nodeIdx];
+    node.boundsMin   = nodeBounds.min;
+    node.boundsMax   = nodeBounds.max;
+    node.leftOrFirst = first;
+    node.count       = count;
+
+    if (count <= 2)
+        return;
+
+    // ---- Binning ----------------------------------------------------------
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    glm::vec3 scale;
+    for (int a = 0; a < 3; ++a)
+        scale[a] = extent[a] > 0.0f ? BIN_COUNT / extent[a] : 0.0f;
+
+    auto binIndex = [&](const glm::vec3& c, int a) {
+        uint32_t b = static_cast<uint32_t>((c[a] - centroidBounds.min[a]) * scale[a]);
+        return std::min(b, BIN_COUNT - 1);
+    };
+
+    auto fillBins = [&](uint32_t begin, uint32_t end, BinSet& bins) {
+        for (uint32_t i = begin; i < end; ++i) {
+            uint32_t         p = primIndices[i];
+            const glm::vec3& c = centroids[p];
+            for (int a = 0; a < 3; ++a) {
+                Bin& bin = bins[a][binIndex(c, a)];
+                bin.bounds.grow(bounds[p]);
+                ++bin.count;
+            }
+        }
+    };
+
+    BinSet bins{};
+    if (splitThreads > 1) {
+        std::vector<BinSet> partial(splitThreads);
+        parallelChunks([&](uint32_t t, uint32_t b, uint32_t e) { fillBins(b, e, partial[t]); });
+        for (const BinSet& ps : partial)
+            for (int a = 0; a < 3; ++a)
+                for (uint32_t i = 0; i < BIN_COUNT; ++i) {
+                    bins[a][i].bounds.grow(ps[a][i].bounds);
+                    bins[a][i].count += ps[a][i].count;
+                }
+    } else {
+        fillBins(first, first + count, bins);
+    }
+    bc.busyThreads -= splitThreads - 1;
+
+    // ---- Sweep: best plane over all axes ----------------------------------
+    float    bestCost  = std::numeric_limits<float>::max();
+    int      bestAxis  = -1;
+    uint32_t bestSplit = 0;
+
+    for (int a = 0; a < 3; ++a) {
+        if (scale[a] == 0.0f) continue;
+
+        std::array<float,    BIN_COUNT - 1> leftArea{}, rightArea{};
+        std::array<uint32_t, BIN_COUNT - 1> leftCount{}, rightCount{};
+        Aabb     lb, rb;
+        uint32_t lc = 0, rc = 0;
+        for (uint32_t i = 0; i < BIN_COUNT - 1; ++i) {
+            lb.grow(bins[a][i].bounds);                 lc += bins[a][i].count;
+            rb.grow(bins[a][BIN_COUNT - 1 - i].bounds); rc += bins[a][BIN_COUNT - 1 - i].count;
+            leftArea [i]                 = lb.area(); leftCount [i]                 = lc;
+            rightArea[BIN_COUNT - 2 - i] = rb.area(); rightCount[BIN_COUNT - 2 - i] = rc;
+        }
+        for (uint32_t i = 0; i < BIN_COUNT - 1; ++i) {
+            if (leftCount[i] == 0 || rightCount[i] == 0) continue;
+            float cost = leftArea[i] * leftCount[i] + rightArea[i] * rightCount[i];
+            if (cost < bestCost) { bestCost = cost; bestAxis = a; bestSplit = i; }
+        }
+    }
+
+    // ---- Leaf or split ----------------------------------------------------
+    const float parentArea = nodeBounds.area();
+    const float leafCost   = INTERSECT_COST * count;
+    const float splitCost  = bestAxis >= 0 && parentArea > 0.0f
+        ? TRAVERSAL_COST + INTERSECT_COST * bestCost / parentArea
+        : std::numeric_limits<float>::max();
+
+    if (splitCost >= leafCost && count <= MAX_LEAF_SIZE)
+        return;
+
+    uint32_t leftCount;
+    auto begin = primIndices.begin() + first;
+    if (depth >= SAH_MAX_DEPTH) {
+        // Depth limit: halve at the centroid median of the widest axis, so
+        // the levels left always suffice however lopsided SAH would split
+        const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0
+                       : extent.y >= extent.z                         ? 1 : 2;
+        leftCount = count / 2;
+        std::nth_element(begin, begin + leftCount, begin + count, [&](uint32_t p, uint32_t q) {
+            return centroids[p][axis] < centroids[q][axis];
+        });
+    } else if (bestAxis >= 0) {
+        auto mid = std::partition(begin, begin + count, [&](uint32_t p) {
+            return binIndex(centroids[p], bestAxis) <= bestSplit;
+        });
+        leftCount = static_cast<uint32_t>(mid - begin);
+    } else {
+        // All centroids coincide but the leaf would be too large — split
+        // the range in half; any order is as good as another.
+        leftCount = count / 2;
+    }
+
+    // ---- Children ---------------------------------------------------------
+    const uint32_t leftIdx = bc.nodeCount.fetch_add(2);
+    node.leftOrFirst = leftIdx;
+    node.count       = 0;
+
+    const uint32_t rightCount = count - leftCount;
+
+    // Fork the left subtree if it is big enough and a thread is free
+    bool fork = leftCount >= SPAWN_THRESHOLD && rightCount >= SPAWN_THRESHOLD;
+    if (fork) {
+        uint32_t busy = bc.busyThreads.load();
+        fork = false;
+        while (busy < bc.maxThreads &&
+               !(fork = bc.busyThreads.compare_exchange_weak(busy, busy + 1))) {}
+    }
+
+    if (fork) {
+        std::thread left([&, leftIdx, first, leftCount]() {
+            subdivide(bc, leftIdx, first, leftCount, depth + 1);
+            --bc.busyThreads;
+        });
+        subdivide(bc, leftIdx + 1, first + leftCount, rightCount, depth + 1);
+        left.join();
+    } else {
+        subdivide(bc, leftIdx,     first,             leftCount,  depth + 1);
+        subdivide(bc, leftIdx + 1, first + leftCount, rightCount, depth + 1);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// computeStats — node/leaf counts, depth and normalised SAH cost
+// ---------------------------------------------------------------------------
+
+void Bvh::computeStats()
+{
+    stats.nodeCount = static_cast<uint32_t>(nodes.size());
+    if (nodes.empty())
+        return;
+
+    Aabb root;
+    root.min = nodes[0].boundsMin;
+    root.max = nodes[0].boundsMax;
+    const float rootArea = root.area();
+    const float invRoot  = rootArea > 0.0f ? 1.0f / rootArea : 0.0f;
+
+    double cost = 0.0;
+    std::vector<std::pair<uint32_t, uint32_t>> stack{{0u, 1u}};  // (node, depth)
+    while (!stack.empty()) {
+        auto [idx, depth] = stack.back();
+        stack.pop_back();
+
+        const BvhNode& n = nodes[idx];
+        Aabb b;
+        b.min = n.boundsMin;
+        b.max = n.boundsMax;
+        const float rel = b.area() * invRoot;
+
+        stats.maxDepth = std::max(stats.maxDepth, depth);
+        if (n.isLeaf()) {
+            ++stats.leafCount;
+            cost += rel * INTERSECT_COST * n.count;
+        } else {
+            cost += rel * TRAVERSAL_COST;
+            stack.push_back({n.leftOrFirst,     depth + 1});
+            stack.push_back({n.leftOrFirst + 1, depth + 1});
+        }
+    }
+    stats.sahCost = static_cast<float>(cost);
+}
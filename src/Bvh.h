@@ -0,0 +1,133 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Axis-aligned bounding box
+// ---------------------------------------------------------------------------
+
+struct Aabb {
+    glm::vec3 min{ std::numeric_limits<float>::max()};
+    glm::vec3 max{-std::numeric_limits<float>::max()};
+
+    void grow(const glm::vec3& p) { min = glm::min(min, p);     max = glm::max(max, p); }
+    void grow(const Aabb& b)      { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+
+    bool      valid()    const { return min.x <= max.x; }
+    glm::vec3 centroid() const { return (min + max) * 0.5f; }
+    float     area()     const {
+        glm::vec3 e = max - min;
+        return valid() ? 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x) : 0.0f;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Ray / triangle (Möller–Trumbore, no backface culling — matches the
+// TRIANGLE_FACING_CULL_DISABLE flag on every TLAS instance)
+// ---------------------------------------------------------------------------
+
+inline bool intersectTriangle(const glm::vec3& origin, const glm::vec3& dir,
+                              const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2,
+                              float tMin, float tMax, float& t, float& u, float& v)
+{
+    glm::vec3 e1   = p1 - p0;
+    glm::vec3 e2   = p2 - p0;
+    glm::vec3 pvec = glm::cross(dir, e2);
+    float     det  = glm::dot(e1, pvec);
+    if (det > -1e-12f && det < 1e-12f) return false;
+    float     inv  = 1.0f / det;
+    glm::vec3 tvec = origin - p0;
+    u = glm::dot(tvec, pvec) * inv;
+    if (u < 0.0f || u > 1.0f) return false;
+    glm::vec3 qvec = glm::cross(tvec, e1);
+    v = glm::dot(dir, qvec) * inv;
+    if (v < 0.0f || u + v > 1.0f) return false;
+    t = glm::dot(e2, qvec) * inv;
+    return t >= tMin && t <= tMax;
+}
+
+// Reciprocal direction with zero components mapped to a large finite value,
+// so slab tests never produce 0 * inf = NaN.
+inline glm::vec3 safeInverse(const glm::vec3& d)
+{
+    auto inv = [](float x) {
+        return (x > 1e-20f || x < -1e-20f) ? 1.0f / x : (x < 0.0f ? -1e20f : 1e20f);
+    };
+    return {inv(d.x), inv(d.y), inv(d.z)};
+}
+
+// ---------------------------------------------------------------------------
+// Binary BVH over an arbitrary set of primitive bounds
+// ---------------------------------------------------------------------------
+
+// 32-byte node. Siblings are stored next to each other, so an interior node
+// only needs the index of its left child (the right child is left + 1).
+struct BvhNode {
+    glm::vec3 boundsMin;
+    uint32_t  leftOrFirst;  // interior: left child index, leaf: first primIndices slot
+    glm::vec3 boundsMax;
+    uint32_t  count;        // primitives in the leaf, 0 for interior nodes
+
+    bool isLeaf() const { return count != 0; }
+};
+
+// Quality / cost report filled in by Bvh::build
+struct BvhStats {
+    double   buildMs   = 0.0;
+    uint32_t nodeCount = 0;
+    uint32_t leafCount = 0;
+    uint32_t maxDepth  = 0;
+    float    sahCost   = 0.0f;  // expected cost per ray, normalised to root area
+};
+
+// Binned-SAH builder. Subtrees above a size threshold are built on their own
+// threads, and the binning pass of very large nodes is split across threads,
+// so build time scales with core count on multi-million triangle meshes.
+class Bvh {
+public:
+    std::vector<BvhNode>  nodes;        // nodes[0] is the root
+    std::vector<uint32_t> primIndices;  // leaf ranges index into the caller's primitives
+    BvhStats              stats;
+
+    // Build over one AABB per primitive (triangles, instances, ...).
+    // threadCount = 0 uses all hardware threads.
+    void build(const std::vector<Aabb>& primBounds, uint32_t threadCount = 0);
+
+    bool empty() const { return nodes.empty(); }
+
+    // Deepest tree build() produces, counting the root as 1. Traversal stacks
+    // are sized from it: depth-first binary traversal never holds more than
+    // MAX_DEPTH entries.
+    static constexpr uint32_t MAX_DEPTH = 64;
+
+    // SAH constants, also used for the reported cost
+    static constexpr float TRAVERSAL_COST = 1.0f;
+    static constexpr float INTERSECT_COST = 1.0f;
+
+private:
+    static constexpr uint32_t BIN_COUNT              = 16;
+    static constexpr uint32_t MAX_LEAF_SIZE          = 8;
+    static constexpr uint32_t SPAWN_THRESHOLD        = 4096;   // min prims to fork a subtree
+    static constexpr uint32_t PARALLEL_BIN_THRESHOLD = 65536;  // min prims to split binning
+    // From this depth on, nodes split at the centroid median of their widest
+    // axis instead of by SAH. Halving takes any range of fewer than 2^32
+    // primitives down to a leaf within 31 more levels, so degenerate SAH
+    // splits cannot push the tree past MAX_DEPTH.
+    static constexpr uint32_t SAH_MAX_DEPTH = MAX_DEPTH - 32;
+
+    struct BuildContext {
+        const std::vector<Aabb>* primBounds = nullptr;
+        std::vector<glm::vec3>   centroids;
+        std::atomic<uint32_t>    nodeCount{0};
+        std::atomic<uint32_t>    busyThreads{1};
+        uint32_t                 maxThreads = 1;
+    };
+
+    void subdivide(BuildContext& bc, uint32_t nodeIdx, uint32_t first, uint32_t count,
+                   uint32_t depth);
+    void computeStats();
+};
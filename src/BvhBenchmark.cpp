@@ -0,0 +1,242 @@
+#include "BvhBenchmark.h"
+#include "Bvh.h"
+#include "WideBvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct BenchRay {
+    glm::vec3 origin;
+    glm::vec3 dir;
+    uint32_t  mesh;
+};
+
+// Ordered scalar traversal of the binary BVH against the same indexed
+// geometry the wide BVH reads, so only the node layout and kernel differ.
+template <bool AnyHit>
+bool traverseBinary(const Bvh& bvh, const MeshGeometry& geo,
+                    const glm::vec3& origin, const glm::vec3& dir,
+                    float tMin, float tMax, TriangleHit* hit)
+{
+    if (bvh.empty())
+        return false;
+
+    const glm::vec3 invDir = safeInverse(dir);
+    auto slab = [&](const BvhNode& n) {
+        glm::vec3 t0 = (n.boundsMin - origin) * invDir;
+        glm::vec3 t1 = (n.boundsMax - origin) * invDir;
+        glm::vec3 lo = glm::min(t0, t1), hi = glm::max(t0, t1);
+        float tNear = std::max(std::max(lo.x, lo.y), std::max(lo.z, tMin));
+        float tFar  = std::min(std::min(hi.x, hi.y), std::min(hi.z, tMax));
+        return tNear <= tFar ? tNear : std::numeric_limits<float>::infinity();
+    };
+
+    uint32_t stack[Bvh::MAX_DEPTH];   // one pending entry per level at most
+    int      sp    = 0;
+    bool     found = false;
+    stack[sp++] = 0;
+
+    while (sp > 0) {
+        const BvhNode& node = bvh.nodes[stack[--sp]];
+        if (slab(node) == std::numeric_limits<float>::infinity())
+            continue;
+
+        if (node.isLeaf()) {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+                const uint32_t prim = bvh.primIndices[i];
+                float t, u, v;
+                if (!intersectTriangle(origin, dir,
+                        geo.vertices[geo.indices[prim * 3 + 0]].pos,
+                        geo.vertices[geo.indices[prim * 3 + 1]].pos,
+                        geo.vertices[geo.indices[prim * 3 + 2]].pos,
+                        tMin, tMax, t, u, v))
+                    continue;
+                if (AnyHit) return true;
+                tMax  = t;
+                *hit  = {t, u, v, prim};
+                found = true;
+            }
+            continue;
+        }
+
+        float tl = slab(bvh.nodes[node.leftOrFirst]);
+        float tr = slab(bvh.nodes[node.leftOrFirst + 1]);
+        constexpr float MISS = std::numeric_limits<float>::infinity();
+        if (tl <= tr) {
+            if (tr != MISS) stack[sp++] = node.leftOrFirst + 1;
+            if (tl != MISS) stack[sp++] = node.leftOrFirst;
+        } else {
+            if (tl != MISS) stack[sp++] = node.leftOrFirst;
+            stack[sp++] = node.leftOrFirst + 1;
+        }
+    }
+    return found;
+}
+
+// Run fn(rayIndex) over all rays on `threads` workers; returns seconds.
+template <typename Fn>
+double timeParallel(size_t count, uint32_t threads, Fn&& fn)
+{
+    std::atomic<size_t> next{0};
+    constexpr size_t BATCH = 1024;
+    auto worker = [&]() {
+        for (size_t b; (b = next.fetch_add(BATCH)) < count; )
+            for (size_t i = b; i < std::min(count, b + BATCH); ++i)
+                fn(i);
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (uint32_t i = 1; i < threads; ++i)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool)
+        t.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// runBvhBenchmark
+// ---------------------------------------------------------------------------
+
+void runBvhBenchmark(const Scene& scene, uint32_t rayCount, uint32_t threadCount)
+{
+    const uint32_t threads = threadCount ? threadCount
+                                         : std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<Vertex>       allVerts;
+    std::vector<uint32_t>     allIndices;
+    std::vector<MeshRange> ranges;
+    scene.flatten(allVerts, allIndices, ranges);
+
+    // ---- Build both layouts per mesh --------------------------------------
+    const size_t meshCount = scene.meshes.size();
+    std::vector<Bvh>          binary(meshCount);
+    std::vector<WideBvh>      wide(meshCount);
+    std::vector<MeshGeometry> geo(meshCount);
+    size_t totalTris = 0;
+
+    for (size_t m = 0; m < meshCount; ++m) {
+        const MeshData& mesh = scene.meshes[m];
+        const uint32_t  triCount = mesh.indexCount() / 3;
+        totalTris += triCount;
+
+        geo[m].vertices = allVerts.data()   + ranges[m].vertexOffset;
+        geo[m].indices  = allIndices.data() + ranges[m].indexOffset;
+
+        std::vector<Aabb> bounds(triCount);
+        for (uint32_t t = 0; t < triCount; ++t)
+            for (int k = 0; k < 3; ++k)
+                bounds[t].grow(geo[m].vertices[geo[m].indices[t * 3 + k]].pos);
+
+        binary[m].build(bounds, threads);
+        wide[m].build(binary[m]);
+    }
+    if (totalTris == 0) {
+        std::cout << "[BvhBenchmark] Scene has no triangles\n";
+        return;
+    }
+
+    // ---- Rays: from a shell around each mesh toward random interior points,
+    //      distributed proportionally to triangle count --------------------
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> U(0.0f, 1.0f);
+    std::vector<BenchRay> rays;
+    rays.reserve(rayCount);
+
+    for (size_t m = 0; m < meshCount && rays.size() < rayCount; ++m) {
+        if (binary[m].empty()) continue;
+        const BvhNode& root = binary[m].nodes[0];
+        glm::vec3 center = (root.boundsMin + root.boundsMax) * 0.5f;
+        float     radius = glm::length(root.boundsMax - root.boundsMin) * 0.75f + 1e-3f;
+
+        size_t n = std::max<size_t>(64, size_t(double(rayCount) *
+                                              (scene.meshes[m].indexCount() / 3) / totalTris));
+        for (size_t i = 0; i < n && rays.size() < rayCount; ++i) {
+            glm::vec3 dirOut;
+            do {
+                dirOut = glm::vec3(U(rng), U(rng), U(rng)) * 2.0f - glm::vec3(1.0f);
+            } while (glm::dot(dirOut, dirOut) > 1.0f || glm::dot(dirOut, dirOut) < 1e-4f);
+            glm::vec3 origin = center + glm::normalize(dirOut) * radius;
+            glm::vec3 target = root.boundsMin + (root.boundsMax - root.boundsMin)
+                                              * glm::vec3(U(rng), U(rng), U(rng));
+            rays.push_back({origin, glm::normalize(target - origin), static_cast<uint32_t>(m)});
+        }
+    }
+
+    // ---- Closest hit ------------------------------------------------------
+    std::vector<TriangleHit> binHits(rays.size()), wideHits(rays.size());
+    std::vector<uint8_t>     binFound(rays.size()), wideFound(rays.size());
+
+    double binClosest = timeParallel(rays.size(), threads, [&](size_t i) {
+        const BenchRay& r = rays[i];
+        binFound[i] = traverseBinary<false>(binary[r.mesh], geo[r.mesh], r.origin, r.dir,
+                                            1e-3f, 1e4f, &binHits[i]);
+    });
+    double wideClosest = timeParallel(rays.size(), threads, [&](size_t i) {
+        const BenchRay& r = rays[i];
+        wideFound[i] = wide[r.mesh].intersect(geo[r.mesh], r.origin, r.dir,
+                                              1e-3f, 1e4f, wideHits[i]);
+    });
+
+    // ---- Shadow (any hit) -------------------------------------------------
+    std::vector<uint8_t> binOcc(rays.size()), wideOcc(rays.size());
+    double binShadow = timeParallel(rays.size(), threads, [&](size_t i) {
+        const BenchRay& r = rays[i];
+        binOcc[i] = traverseBinary<true>(binary[r.mesh], geo[r.mesh], r.origin, r.dir,
+                                         1e-3f, 1e4f, nullptr);
+    });
+    double wideShadow = timeParallel(rays.size(), threads, [&](size_t i) {
+        const BenchRay& r = rays[i];
+        wideOcc[i] = wide[r.mesh].occluded(geo[r.mesh], r.origin, r.dir, 1e-3f, 1e4f);
+    });
+
+    // Agreement between the layouts is covered by tests/WideBvhTest.cpp
+    size_t hits = 0;
+    for (size_t i = 0; i < rays.size(); ++i)
+        hits += binFound[i];
+
+    // ---- Report -----------------------------------------------------------
+    size_t binNodes = 0, binBytes = 0, wideNodes = 0, wideBytes = 0;
+    for (size_t m = 0; m < meshCount; ++m) {
+        binNodes  += binary[m].nodes.size();
+        binBytes  += binary[m].nodes.size() * sizeof(BvhNode)
+                   + binary[m].primIndices.size() * sizeof(uint32_t);
+        wideNodes += wide[m].nodes.size();
+        wideBytes += wide[m].memoryBytes();
+    }
+
+    const double n = static_cast<double>(rays.size());
+    std::cout << "[BvhBenchmark] " << rays.size() << " rays over " << totalTris
+              << " triangles, " << threads << " threads, wide kernel: "
+              << WideBvh::kernelName() << ", hit rate "
+              << std::fixed << std::setprecision(1) << 100.0 * hits / n << "%\n";
+
+    std::cout << std::left  << std::setw(10) << "layout"
+              << std::right << std::setw(10) << "nodes" << std::setw(14) << "bytes"
+              << std::setw(18) << "closest Mrays/s" << std::setw(17) << "shadow Mrays/s" << '\n';
+    auto row = [&](const char* name, size_t nodes, size_t bytes, double closest, double shadow) {
+        std::cout << std::left  << std::setw(10) << name
+                  << std::right << std::setw(10) << nodes << std::setw(14) << bytes
+                  << std::setw(18) << std::setprecision(2) << n / closest * 1e-6
+                  << std::setw(17) << n / shadow * 1e-6 << '\n';
+    };
+    row("binary", binNodes,  binBytes,  binClosest,  binShadow);
+    row("wide8",  wideNodes, wideBytes, wideClosest, wideShadow);
+
+    std::cout << "[BvhBenchmark] Node memory " << std::setprecision(2)
+              << double(wideBytes) / double(binBytes) << "x, closest-hit speedup "
+              << binClosest / wideClosest << "x, shadow speedup "
+              << binShadow / wideShadow << "x\n";
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "Scene.h"
+
+#include <cstdint>
+
+// Compare the binary BVH (scalar traversal) against the 8-wide quantized BVH
+// (SIMD traversal) on the scene's meshes: node memory footprint plus
+// closest-hit and shadow (any-hit) throughput over the same random rays.
+void runBvhBenchmark(const Scene& scene, uint32_t rayCount, uint32_t threadCount);
@@ -0,0 +1,206 @@
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+std::atomic<bool> CpuProfiler::active{false};
+
+namespace {
+
+constexpr size_t kRingSize  = 1u << 14;   // events per thread between collects
+constexpr size_t kMaxEvents = 1u << 20;   // kept for the trace
+
+struct Event {
+    const char* name;
+    uint64_t    startNs;
+    uint64_t    endNs;
+};
+
+// Single producer (the owning thread), single consumer (collect, under the
+// registry mutex). A full ring drops new events rather than overwriting ones
+// the consumer may be reading.
+struct Ring {
+    Event                 events[kRingSize];
+    std::atomic<uint64_t> head{0};        // next write, published by the producer
+    std::atomic<uint64_t> tail{0};        // next read, published by the consumer
+    std::atomic<uint64_t> dropped{0};
+    uint32_t              thread = 0;
+};
+
+struct Totals {
+    uint64_t count   = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxNs   = 0;
+};
+
+struct TraceEvent {
+    const char* name;
+    uint32_t    thread;
+    uint64_t    startNs;
+    uint64_t    endNs;
+};
+
+struct Registry {
+    std::mutex                          mutex;
+    std::vector<std::unique_ptr<Ring>>  rings;
+    std::unordered_map<const char*, Totals> totals;   // by name pointer; merged by text in report()
+    std::vector<TraceEvent>             trace;
+    uint64_t                            dropped = 0;
+};
+
+Registry& registry()
+{
+    static Registry r;
+    return r;
+}
+
+thread_local Ring* threadRing = nullptr;
+
+Ring* ringForThisThread()
+{
+    if (!threadRing) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.rings.push_back(std::make_unique<Ring>());
+        threadRing         = reg.rings.back().get();
+        threadRing->thread = static_cast<uint32_t>(reg.rings.size() - 1);
+    }
+    return threadRing;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Recording
+// ---------------------------------------------------------------------------
+
+void CpuProfiler::record(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    Ring*    r = ringForThisThread();
+    uint64_t h = r->head.load(std::memory_order_relaxed);
+    if (h - r->tail.load(std::memory_order_acquire) >= kRingSize) {
+        r->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    r->events[h % kRingSize] = {name, startNs, endNs};
+    r->head.store(h + 1, std::memory_order_release);
+}
+
+void CpuProfiler::collect()
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    for (auto& ring : reg.rings) {
+        uint64_t h = ring->head.load(std::memory_order_acquire);
+        uint64_t t = ring->tail.load(std::memory_order_relaxed);
+        for (; t < h; ++t) {
+            const Event& e  = ring->events[t % kRingSize];
+            uint64_t     ns = e.endNs - e.startNs;
+
+            Totals& tot = reg.totals[e.name];
+            ++tot.count;
+            tot.totalNs += ns;
+            tot.maxNs    = std::max(tot.maxNs, ns);
+
+            if (reg.trace.size() < kMaxEvents)
+                reg.trace.push_back({e.name, ring->thread, e.startNs, e.endNs});
+            else
+                ++reg.dropped;
+        }
+        ring->tail.store(h, std::memory_order_release);
+        reg.dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Output
+// ---------------------------------------------------------------------------
+
+void CpuProfiler::report()
+{
+#ifndef RT_CPU_PROFILER
+    std::cout << "[CpuProfiler] Zones compiled out (build with ENABLE_CPU_PROFILER=ON)\n";
+    return;
+#endif
+    collect();
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    // The same literal may have several addresses across translation units
+    std::unordered_map<std::string, Totals> byName;
+    for (const auto& [name, t] : reg.totals) {
+        Totals& m = byName[name];
+        m.count   += t.count;
+        m.totalNs += t.totalNs;
+        m.maxNs    = std::max(m.maxNs, t.maxNs);
+    }
+    std::vector<std::pair<std::string, Totals>> rows(byName.begin(), byName.end());
+    std::sort(rows.begin(), rows.end(),
+              [](const auto& a, const auto& b) { return a.second.totalNs > b.second.totalNs; });
+
+    std::cout << "[CpuProfiler] CPU time per zone (ms)\n"
+              << std::left  << std::setw(28) << "zone"
+              << std::right << std::setw(10) << "calls" << std::setw(12) << "total"
+              << std::setw(10) << "avg" << std::setw(10) << "max" << '\n';
+    for (const auto& [name, t] : rows)
+        std::cout << std::left  << std::setw(28) << name
+                  << std::right << std::setw(10) << t.count
+                  << std::fixed << std::setprecision(3)
+                  << std::setw(12) << t.totalNs * 1e-6
+                  << std::setw(10) << t.totalNs * 1e-6 / t.count
+                  << std::setw(10) << t.maxNs * 1e-6 << '\n';
+    std::cout.unsetf(std::ios::floatfield);
+    if (reg.dropped)
+        std::cout << "[CpuProfiler] " << reg.dropped << " events not kept (ring or trace full)\n";
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string& path)
+{
+    collect();
+
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cerr << "[CpuProfiler] Cannot write " << path << "\n";
+        return false;
+    }
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    uint64_t origin = UINT64_MAX;
+    for (const TraceEvent& e : reg.trace)
+        origin = std::min(origin, e.startNs);
+
+    // Complete ("X") events in microseconds, one track per recording thread
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& ring : reg.rings) {
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring->thread
+            << ",\"args\":{\"name\":\"CPU thread " << ring->thread << "\"}}";
+        first = false;
+    }
+    out << std::fixed << std::setprecision(3);
+    for (const TraceEvent& e : reg.trace) {
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.thread
+            << ",\"ts\":" << (e.startNs - origin) * 1e-3 << ",\"dur\":" << (e.endNs - e.startNs) * 1e-3 << '}';
+        first = false;
+    }
+    out << "\n]}\n";
+
+    if (!out.flush()) {
+        std::cerr << "[CpuProfiler] Write to " << path << " failed\n";
+        return false;
+    }
+    std::cout << "[CpuProfiler] Wrote " << reg.trace.size() << " events to " << path << '\n';
+    return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// ---------------------------------------------------------------------------
+// CpuProfiler — scoped timing zones on the CPU
+//
+// CPU_ZONE("name") times the rest of the enclosing block. Each thread that
+// records a zone gets its own ring of events, written only by that thread
+// and read by collect() without locks; a thread that fills its ring before
+// the next collect() drops further events, never blocks. collect() folds
+// the rings into per-zone totals and (up to kMaxEvents) a trace for
+// writeChromeTrace(). Call it now and then (once a frame) on long runs.
+//
+// Built without RT_CPU_PROFILER (cmake -DENABLE_CPU_PROFILER=OFF) a zone
+// compiles to nothing; built with it, a zone costs one relaxed load while
+// profiling is off and two clock reads plus a ring write while it is on.
+// Zone names must outlive the profiler (string literals).
+// ---------------------------------------------------------------------------
+
+class CpuProfiler {
+public:
+    static void setEnabled(bool on) { active.store(on, std::memory_order_relaxed); }
+    static bool enabled()           { return active.load(std::memory_order_relaxed); }
+
+    // Move the events every thread has recorded so far into the profile
+    static void collect();
+
+    // Per-zone call count, total / average / max time, by total descending
+    static void report();
+    static bool writeChromeTrace(const std::string& path);
+
+    static uint64_t nowNs()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Used by CpuZone
+    static void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+private:
+    static std::atomic<bool> active;
+};
+
+class CpuZone {
+public:
+    explicit CpuZone(const char* name)
+        : name(CpuProfiler::enabled() ? name : nullptr),
+          startNs(this->name ? CpuProfiler::nowNs() : 0) {}
+    ~CpuZone()
+    {
+        if (name)
+            CpuProfiler::record(name, startNs, CpuProfiler::nowNs());
+    }
+
+    CpuZone(const CpuZone&)            = delete;
+    CpuZone& operator=(const CpuZone&) = delete;
+
+private:
+    const char* name;
+    uint64_t    startNs;
+};
+
+#define CPU_ZONE_CONCAT2(a, b) a##b
+#define CPU_ZONE_CONCAT(a, b)  CPU_ZONE_CONCAT2(a, b)
+
+#ifdef RT_CPU_PROFILER
+#define CPU_ZONE(name) CpuZone CPU_ZONE_CONCAT(cpuZone_, __LINE__)(name)
+#else
+#define CPU_ZONE(name) ((void)0)
+#endif
@@ -0,0 +1,921 @@
+#include "CpuTracer.h"
+#include "CpuProfiler.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+// ---------------------------------------------------------------------------
+// Shader constants and helpers — kept in lockstep with the GLSL sources
+// ---------------------------------------------------------------------------
+
+namespace {
+
+constexpr float PI = 3.14159265358979f;
+
+const glm::vec3 SUN_DIR   = glm::normalize(glm::vec3(0.5f, 1.0f, 0.3f));
+const glm::vec3 SUN_COLOR = glm::vec3(2.2f, 2.0f, 1.8f);
+
+// common.glsl: PCG hash
+inline uint32_t pcgHash(uint32_t v)
+{
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+inline float randFloat(uint32_t& seed)
+{
+    seed = pcgHash(seed);
+    return static_cast<float>(seed) / 4294967295.0f;
+}
+
+// GLSL evaluates constructor arguments left to right; C++ does not, so the
+// two draws are sequenced explicitly.
+inline glm::vec2 rand2(uint32_t& seed)
+{
+    float x = randFloat(seed);
+    float y = randFloat(seed);
+    return {x, y};
+}
+
+// hitcommon.glsl: GGX / PBR helpers
+inline float D_GGX(float NdotH, float a2)
+{
+    float d = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+    return a2 / std::max(PI * d * d, 1e-7f);
+}
+
+inline float G_SchlickGGX(float NdotV, float k)
+{
+    return NdotV / std::max(NdotV * (1.0f - k) + k, 1e-7f);
+}
+
+inline float G_Smith(float NdotV, float NdotL, float roughness)
+{
+    float r = roughness + 1.0f;
+    float k = (r * r) / 8.0f;
+    return G_SchlickGGX(std::max(NdotV, 0.0f), k)
+         * G_SchlickGGX(std::max(NdotL, 0.0f), k);
+}
+
+inline glm::vec3 F_Schlick(float cosTheta, const glm::vec3& F0)
+{
+    return F0 + (1.0f - F0) * std::pow(glm::clamp(1.0f - cosTheta, 0.0f, 1.0f), 5.0f);
+}
+
+inline void buildFrame(const glm::vec3& N, glm::vec3& T, glm::vec3& B)
+{
+    glm::vec3 up = std::fabs(N.z) < 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0);
+    T = glm::normalize(glm::cross(up, N));
+    B = glm::cross(N, T);
+}
+
+inline glm::vec3 toWorld(const glm::vec3& local, const glm::vec3& N,
+                         const glm::vec3& T, const glm::vec3& B)
+{
+    return glm::normalize(local.x * T + local.y * B + local.z * N);
+}
+
+inline glm::vec3 sampleGGX(const glm::vec2& xi, const glm::vec3& N, float roughness)
+{
+    float a  = roughness * roughness;
+    float a2 = a * a;
+    float phi      = 2.0f * PI * xi.x;
+    float cosTheta = std::sqrt((1.0f - xi.y) / std::max(1.0f + (a2 - 1.0f) * xi.y, 1e-7f));
+    float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+
+    glm::vec3 T, B;
+    buildFrame(N, T, B);
+    return toWorld({sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta}, N, T, B);
+}
+
+inline glm::vec3 sampleCosineHemi(const glm::vec2& xi, const glm::vec3& N)
+{
+    float phi = 2.0f * PI * xi.x;
+    float r   = std::sqrt(xi.y);
+    glm::vec3 T, B;
+    buildFrame(N, T, B);
+    return toWorld({r * std::cos(phi), r * std::sin(phi),
+                    std::sqrt(std::max(1.0f - xi.y, 0.0f))}, N, T, B);
+}
+
+// Slab test; returns the entry distance or +inf on a miss
+inline float intersectAabb(const glm::vec3& bmin, const glm::vec3& bmax,
+                           const glm::vec3& origin, const glm::vec3& invDir,
+                           float tMin, float tMax)
+{
+    glm::vec3 t0 = (bmin - origin) * invDir;
+    glm::vec3 t1 = (bmax - origin) * invDir;
+    glm::vec3 lo = glm::min(t0, t1);
+    glm::vec3 hi = glm::max(t0, t1);
+    float tNear = std::max(std::max(lo.x, lo.y), std::max(lo.z, tMin));
+    float tFar  = std::min(std::min(hi.x, hi.y), std::min(hi.z, tMax));
+    return tNear <= tFar ? tNear : std::numeric_limits<float>::infinity();
+}
+
+// Instance BVH traversal stack: depth-first binary traversal holds at most
+// one entry per level, and Bvh::build caps the depth
+constexpr int STACK_SIZE = static_cast<int>(Bvh::MAX_DEPTH);
+
+// Spread the low 7 bits of v to every third bit (Morton interleave)
+inline uint32_t spreadBits(uint32_t v)
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// LSD radix sort of (key << 32 | payload) items on the low keyBits of the key
+void radixSortKeys(std::vector<uint64_t>& items, std::vector<uint64_t>& tmp, int keyBits)
+{
+    tmp.resize(items.size());
+    for (int shift = 32; shift < 32 + keyBits; shift += 8) {
+        uint32_t count[257] = {};
+        for (uint64_t it : items) ++count[((it >> shift) & 0xFF) + 1];
+        for (int b = 0; b < 256; ++b) count[b + 1] += count[b];
+        for (uint64_t it : items) tmp[count[(it >> shift) & 0xFF]++] = it;
+        items.swap(tmp);
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// build
+// ---------------------------------------------------------------------------
+
+void CpuTracer::build(const Scene& scene)
+{
+    CPU_ZONE("CpuTracer::build");
+    auto t0 = std::chrono::steady_clock::now();
+
+    scene.flatten(allVerts, allIndices, meshRanges);
+
+    meshAccels.clear();
+    meshAccels.resize(scene.meshes.size());
+
+    const uint32_t threads = threadCount ? threadCount
+                                         : std::max(1u, std::thread::hardware_concurrency());
+
+    auto buildMesh = [&](size_t m, uint32_t builderThreads) {
+        MeshAccel& accel = meshAccels[m];
+        accel.geo.vertices = allVerts.data()   + meshRanges[m].vertexOffset;
+        accel.geo.indices  = allIndices.data() + meshRanges[m].indexOffset;
+
+        const uint32_t triCount = scene.meshes[m].indexCount() / 3;
+        std::vector<Aabb> bounds(triCount);
+        for (uint32_t t = 0; t < triCount; ++t)
+            for (int k = 0; k < 3; ++k)
+                bounds[t].grow(accel.geo.vertices[accel.geo.indices[t * 3 + k]].pos);
+
+        // Binary SAH build, then collapse into the 8-wide traversal layout
+        Bvh binary;
+        binary.build(bounds, builderThreads);
+        accel.bvh.build(binary);
+        accel.stats = binary.stats;
+        if (!binary.empty()) {
+            accel.bounds.min = binary.nodes[0].boundsMin;
+            accel.bounds.max = binary.nodes[0].boundsMax;
+        }
+    };
+
+    // Small meshes are built concurrently, one per worker. Large meshes
+    // are built one after another, each using every thread for its subtrees.
+    constexpr size_t LARGE_MESH_TRIS = 65536;
+    std::vector<size_t> largeMeshes;
+    std::atomic<size_t> nextMesh{0};
+
+    auto smallWorker = [&]() {
+        for (size_t m; (m = nextMesh.fetch_add(1)) < scene.meshes.size(); )
+            if (scene.meshes[m].indexCount() / 3 < LARGE_MESH_TRIS)
+                buildMesh(m, 1);
+    };
+    std::vector<std::thread> pool;
+    for (uint32_t i = 1; i < std::min<size_t>(threads, scene.meshes.size()); ++i)
+        pool.emplace_back(smallWorker);
+    smallWorker();
+    for (auto& t : pool)
+        t.join();
+
+    for (size_t m = 0; m < scene.meshes.size(); ++m)
+        if (scene.meshes[m].indexCount() / 3 >= LARGE_MESH_TRIS)
+            buildMesh(m, threads);
+
+    // Instance-level BVH over world-space bounds
+    instanceAccels.clear();
+    std::vector<Aabb> instBounds;
+    for (const SceneInstance& si : scene.instances) {
+        InstanceAccel ia;
+        ia.objectToWorld = si.transform;
+        ia.worldToObject = glm::inverse(si.transform);
+        ia.meshIndex     = si.meshIndex;
+        ia.materialIndex = si.materialIndex;
+        instanceAccels.push_back(ia);
+
+        Aabb world;
+        const Aabb& local = meshAccels[si.meshIndex].bounds;
+        if (local.valid()) {
+            for (int c = 0; c < 8; ++c) {
+                glm::vec3 corner{
+                    (c & 1) ? local.max.x : local.min.x,
+                    (c & 2) ? local.max.y : local.min.y,
+                    (c & 4) ? local.max.z : local.min.z};
+                world.grow(glm::vec3(si.transform * glm::vec4(corner, 1.0f)));
+            }
+        }
+        instBounds.push_back(world);
+    }
+    topLevel.build(instBounds, threads);
+
+    sceneBounds = Aabb{};
+    for (const Aabb& b : instBounds)
+        sceneBounds.grow(b);
+
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - t0).count();
+
+    size_t wideBytes = 0;
+    for (const MeshAccel& ma : meshAccels)
+        wideBytes += ma.bvh.memoryBytes();
+
+    std::cout << "[CpuTracer] BVHs built for " << scene.meshes.size() << " meshes / "
+              << scene.instances.size() << " instances in " << ms << " ms ("
+              << wideBytes / 1024 << " KiB wide nodes, " << WideBvh::kernelName()
+              << " kernel, " << threads << " threads)\n";
+}
+
+// ---------------------------------------------------------------------------
+// Traversal
+// ---------------------------------------------------------------------------
+
+bool CpuTracer::intersectMesh(const MeshAccel& mesh, const Ray& ray,
+                              bool anyHit, Hit& hit) const
+{
+    if (anyHit)
+        return mesh.bvh.occluded(mesh.geo, ray.origin, ray.dir, ray.tMin, ray.tMax);
+    return mesh.bvh.intersect(mesh.geo, ray.origin, ray.dir, ray.tMin, ray.tMax, hit);
+}
+
+bool CpuTracer::intersect(const Ray& ray, Hit& hit) const
+{
+    if (topLevel.empty())
+        return false;
+
+    const glm::vec3 invDir = safeInverse(ray.dir);
+    float tMax  = ray.tMax;
+    bool  found = false;
+
+    uint32_t stack[STACK_SIZE];
+    int      sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0) {
+        const BvhNode& node = topLevel.nodes[stack[--sp]];
+        if (intersectAabb(node.boundsMin, node.boundsMax, ray.origin, invDir,
+                          ray.tMin, tMax) == std::numeric_limits<float>::infinity())
+            continue;
+
+        if (!node.isLeaf()) {
+            assert(sp + 2 <= STACK_SIZE);
+            stack[sp++] = node.leftOrFirst + 1;
+            stack[sp++] = node.leftOrFirst;
+            continue;
+        }
+
+        for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+            uint32_t             instIdx = topLevel.primIndices[i];
+            const InstanceAccel& inst    = instanceAccels[instIdx];
+
+            // Object-space ray; the direction is left unnormalised so t is
+            // shared between spaces.
+            Ray local;
+            local.origin = glm::vec3(inst.worldToObject * glm::vec4(ray.origin, 1.0f));
+            local.dir    = glm::vec3(inst.worldToObject * glm::vec4(ray.dir, 0.0f));
+            local.tMin   = ray.tMin;
+            local.tMax   = tMax;
+
+            Hit h;
+            if (intersectMesh(meshAccels[inst.meshIndex], local, false, h)) {
+                tMax         = h.t;
+                hit          = h;
+                hit.instance = instIdx;
+                found        = true;
+            }
+        }
+    }
+    return found;
+}
+
+bool CpuTracer::occluded(const Ray& ray) const
+{
+    if (topLevel.empty())
+        return false;
+
+    const glm::vec3 invDir = safeInverse(ray.dir);
+
+    uint32_t stack[STACK_SIZE];
+    int      sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0) {
+        const BvhNode& node = topLevel.nodes[stack[--sp]];
+        if (intersectAabb(node.boundsMin, node.boundsMax, ray.origin, invDir,
+                          ray.tMin, ray.tMax) == std::numeric_limits<float>::infinity())
+            continue;
+
+        if (!node.isLeaf()) {
+            assert(sp + 2 <= STACK_SIZE);
+            stack[sp++] = node.leftOrFirst + 1;
+            stack[sp++] = node.leftOrFirst;
+            continue;
+        }
+
+        for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+            const InstanceAccel& inst = instanceAccels[topLevel.primIndices[i]];
+
+            Ray local;
+            local.origin = glm::vec3(inst.worldToObject * glm::vec4(ray.origin, 1.0f));
+            local.dir    = glm::vec3(inst.worldToObject * glm::vec4(ray.dir, 0.0f));
+            local.tMin   = ray.tMin;
+            local.tMax   = ray.tMax;
+
+            Hit h;
+            if (intersectMesh(meshAccels[inst.meshIndex], local, true, h))
+                return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// miss.rmiss
+// ---------------------------------------------------------------------------
+
+void CpuTracer::miss(const Ray& ray, Payload& payload) const
+{
+    glm::vec3 dir = glm::normalize(ray.dir);
+
+    // Sky gradient: horizon is light blue, zenith is deeper blue
+    float     t   = glm::clamp(dir.y * 0.5f + 0.5f, 0.0f, 1.0f);
+    glm::vec3 sky = glm::mix(glm::vec3(0.6f, 0.75f, 0.95f), glm::vec3(0.1f, 0.3f, 0.7f), t);
+
+    // Simple sun disc
+    float sunDot = std::max(glm::dot(dir, SUN_DIR), 0.0f);
+    sky += std::pow(sunDot, 128.0f) * glm::vec3(3.5f, 3.0f, 2.5f);   // bright core
+    sky += std::pow(sunDot,  16.0f) * glm::vec3(0.5f, 0.4f, 0.3f);   // warm corona
+
+    payload.radiance = sky;
+    payload.done     = true;
+}
+
+// ---------------------------------------------------------------------------
+// diffuse.rchit / metal.rchit / glass.rchit
+// ---------------------------------------------------------------------------
+
+void CpuTracer::closestHit(const Scene& scene, const Ray& ray, const Hit& hit,
+                           Payload& payload, uint64_t& rays,
+                           ShadowRequest* deferShadow) const
+{
+    uint32_t seed = payload.seed;
+
+    // -----------------------------------------------------------------------
+    // Vertex fetch and interpolation
+    // -----------------------------------------------------------------------
+    const InstanceAccel& inst = instanceAccels[hit.instance];
+    const MeshGeometry&  geo  = meshAccels[inst.meshIndex].geo;   // flattened copy, also for mapped meshes
+
+    const Vertex& v0 = geo.vertices[geo.indices[hit.prim * 3 + 0]];
+    const Vertex& v1 = geo.vertices[geo.indices[hit.prim * 3 + 1]];
+    const Vertex& v2 = geo.vertices[geo.indices[hit.prim * 3 + 2]];
+
+    glm::vec3 bary{1.0f - hit.u - hit.v, hit.u, hit.v};
+
+    glm::vec3 localPos  = v0.pos    * bary.x + v1.pos    * bary.y + v2.pos    * bary.z;
+    glm::vec3 localNorm = v0.normal * bary.x + v1.normal * bary.y + v2.normal * bary.z;
+
+    glm::vec3 worldPos  = glm::vec3(inst.objectToWorld * glm::vec4(localPos, 1.0f));
+    // localNorm * mat3(WorldToObject) == transpose(mat3(WorldToObject)) * localNorm
+    glm::vec3 worldNorm = glm::normalize(
+        glm::transpose(glm::mat3(inst.worldToObject)) * localNorm);
+
+    // -----------------------------------------------------------------------
+    // Material
+    // -----------------------------------------------------------------------
+    const Material& mat = scene.materials[inst.materialIndex];
+
+    glm::vec3 V = -glm::normalize(ray.dir);
+
+    // Ensure normal faces the incoming ray
+    if (glm::dot(worldNorm, V) < 0.0f) worldNorm = -worldNorm;
+
+    // -----------------------------------------------------------------------
+    // Emissive: terminate and contribute emissive radiance directly
+    // -----------------------------------------------------------------------
+    if (glm::dot(mat.emissive, mat.emissive) > 0.001f) {
+        payload.radiance = mat.emissive;
+        payload.done     = true;
+        payload.seed     = seed;
+        return;
+    }
+
+    glm::vec3 N      = worldNorm;
+    glm::vec3 hitPos = worldPos + N * 1e-3f;
+
+    // -----------------------------------------------------------------------
+    // Glass (dielectric refraction / reflection)
+    // -----------------------------------------------------------------------
+    if (mat.type == 2) {
+        float     cosI = glm::dot(V, N);
+        float     eta  = (cosI > 0.0f) ? (1.0f / mat.ior) : mat.ior;
+        glm::vec3 refN = (cosI > 0.0f) ? N : -N;
+
+        float r0      = (1.0f - mat.ior) / (1.0f + mat.ior);
+        r0           *= r0;
+        float fresnel = r0 + (1.0f - r0) * std::pow(1.0f - std::fabs(cosI), 5.0f);
+
+        glm::vec3 nextDir;
+        glm::vec3 nextOrig;
+        if (randFloat(seed) < fresnel) {
+            nextDir  = glm::reflect(-V, N);
+            nextOrig = hitPos;
+        } else {
+            glm::vec3 refracted = glm::refract(-V, refN, eta);
+            if (glm::length(refracted) < 0.001f) {      // Total internal reflection
+                refracted = glm::reflect(-V, N);
+                nextOrig  = hitPos;
+            } else {
+                nextOrig = worldPos - N * 2e-3f;        // offset to the transmitted side
+            }
+            nextDir = glm::normalize(refracted);
+        }
+        payload.radiance   = glm::vec3(0.0f);
+        payload.throughput = mat.baseColor;
+        payload.origin     = nextOrig;
+        payload.direction  = nextDir;
+        payload.done       = false;
+        payload.seed       = seed;
+        return;
+    }
+
+    // -----------------------------------------------------------------------
+    // Direct illumination — cast a shadow ray toward the sun
+    // -----------------------------------------------------------------------
+    float     NdotL       = std::max(glm::dot(N, SUN_DIR), 0.0f);
+    glm::vec3 directLight = glm::vec3(0.0f);
+
+    if (NdotL > 0.0f) {
+        // A deferred shadow ray is resolved by the caller: vis = 1 here and
+        // the light is dropped afterwards if the ray turns out occluded.
+        float vis = 1.0f;
+        if (!deferShadow) {
+            ++rays;
+            vis = occluded({hitPos, SUN_DIR, 1e-3f, 1e4f}) ? 0.0f : 1.0f;
+        }
+
+        if (mat.type == 0) {
+            directLight = vis * SUN_COLOR * NdotL * mat.baseColor / PI;
+
+        } else if (mat.type == 1) {
+            glm::vec3 H     = glm::normalize(V + SUN_DIR);
+            float     NdotV = std::max(glm::dot(N, V), 1e-4f);
+            float     NdotH = std::max(glm::dot(N, H), 0.0f);
+            float     a2    = mat.roughness * mat.roughness;
+            a2              = a2 * a2;
+
+            float     D = D_GGX(NdotH, a2);
+            float     G = G_Smith(NdotV, NdotL, mat.roughness);
+            glm::vec3 F = F_Schlick(std::max(glm::dot(V, H), 0.0f), mat.baseColor);
+
+            directLight = vis * SUN_COLOR * NdotL
+                        * (D * G * F) / std::max(4.0f * NdotV * NdotL, 1e-4f);
+        }
+
+        if (deferShadow) {
+            deferShadow->origin  = hitPos;
+            deferShadow->light   = directLight;
+            deferShadow->pending = true;
+            directLight          = glm::vec3(0.0f);
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // Indirect — importance-sample the BRDF to pick the next bounce direction
+    // -----------------------------------------------------------------------
+    glm::vec3 nextDir;
+    glm::vec3 brdfWeight;
+
+    if (mat.type == 0) {
+        nextDir    = sampleCosineHemi(rand2(seed), N);
+        brdfWeight = mat.baseColor;
+
+    } else {
+        float     rough = std::max(mat.roughness, 0.02f);
+        glm::vec3 H     = sampleGGX(rand2(seed), N, rough);
+        nextDir         = glm::reflect(-V, H);
+
+        if (glm::dot(nextDir, N) <= 0.0f) {
+            payload.radiance = directLight;
+            payload.done     = true;
+            payload.seed     = seed;
+            return;
+        }
+
+        float NdotL2 = std::max(glm::dot(N, nextDir), 1e-4f);
+        float NdotV  = std::max(glm::dot(N, V),       1e-4f);
+        float NdotH  = std::max(glm::dot(N, H),       0.0f);
+        float VdotH  = std::max(glm::dot(V, H),       0.0f);
+
+        glm::vec3 F = F_Schlick(VdotH, mat.baseColor);
+        float     G = G_Smith(NdotV, NdotL2, rough);
+
+        brdfWeight = F * G * VdotH / std::max(NdotH * NdotV, 1e-4f);
+    }
+
+    payload.radiance   = directLight;
+    payload.throughput = brdfWeight;
+    payload.origin     = hitPos;
+    payload.direction  = nextDir;
+    payload.done       = false;
+    payload.seed       = seed;
+}
+
+// ---------------------------------------------------------------------------
+// raygen.rgen — camera ray, bounce loop tail, one full path
+// ---------------------------------------------------------------------------
+
+CpuTracer::Ray CpuTracer::primaryRay(uint32_t px, uint32_t py, uint32_t sampleIndex,
+                                     const glm::mat4& invView, const glm::mat4& invProj,
+                                     uint32_t& seed) const
+{
+    seed = pcgHash((px + py * imageWidth) ^ (sampleIndex * 1664525u + 1013904223u));
+
+    // Sub-pixel jitter for anti-aliasing
+    glm::vec2 jitter = rand2(seed) - 0.5f;
+    glm::vec2 uv{(px + 0.5f + jitter.x) / imageWidth,
+                 (py + 0.5f + jitter.y) / imageHeight};
+    uv = uv * 2.0f - 1.0f;
+    uv.y = -uv.y;
+
+    glm::vec4 viewTarget = invProj * glm::vec4(uv.x, uv.y, 1.0f, 1.0f);
+    viewTarget /= viewTarget.w;
+
+    Ray ray;
+    ray.origin = glm::vec3(invView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    ray.dir    = glm::normalize(glm::vec3(
+        invView * glm::vec4(glm::normalize(glm::vec3(viewTarget)), 0.0f)));
+    ray.tMin   = 1e-3f;
+    ray.tMax   = 1e4f;
+    return ray;
+}
+
+bool CpuTracer::advancePath(uint32_t bounce, const Payload& payload, Ray& ray,
+                            glm::vec3& color, glm::vec3& throughput, uint32_t& seed) const
+{
+    seed   = payload.seed;
+    color += throughput * payload.radiance;
+
+    if (payload.done) return false;
+
+    throughput *= payload.throughput;
+    ray.origin  = payload.origin;
+    ray.dir     = payload.direction;
+
+    // Russian roulette after 3 bounces to terminate low-contribution paths
+    if (bounce >= 3u) {
+        float p = std::max(throughput.x, std::max(throughput.y, throughput.z));
+        if (randFloat(seed) > p) return false;
+        throughput /= p;
+    }
+    return bounce < maxBounces;
+}
+
+glm::vec3 CpuTracer::tracePath(const Scene& scene, uint32_t px, uint32_t py,
+                               uint32_t sampleIndex, const glm::mat4& invView,
+                               const glm::mat4& invProj, uint64_t& rays) const
+{
+    uint32_t seed;
+    Ray      ray = primaryRay(px, py, sampleIndex, invView, invProj, seed);
+
+    glm::vec3 finalColor(0.0f);
+    glm::vec3 throughput(1.0f);
+
+    for (uint32_t bounce = 0; ; ++bounce) {
+        Payload payload;
+        payload.done       = false;
+        payload.seed       = seed;
+        payload.radiance   = glm::vec3(0.0f);
+        payload.throughput = glm::vec3(1.0f);
+
+        ++rays;
+        Hit hit;
+        if (intersect(ray, hit))
+            closestHit(scene, ray, hit, payload, rays);
+        else
+            miss(ray, payload);
+
+        if (!advancePath(bounce, payload, ray, finalColor, throughput, seed))
+            break;
+    }
+    return finalColor;
+}
+
+// ---------------------------------------------------------------------------
+// Wavefront — one tile's paths advanced a bounce at a time
+// ---------------------------------------------------------------------------
+
+// Direction octant in the top 3 bits, then a 7-bit-per-axis Morton code of
+// the origin's cell in the scene bounds: rays that start close together and
+// head the same way end up adjacent and walk the same BVH nodes.
+uint32_t CpuTracer::coherenceKey(const glm::vec3& origin, const glm::vec3& dir) const
+{
+    constexpr float CELLS = 128.0f;
+
+    glm::vec3 extent = glm::max(sceneBounds.max - sceneBounds.min, glm::vec3(1e-6f));
+    glm::vec3 cell   = glm::clamp((origin - sceneBounds.min) / extent * CELLS,
+                                  0.0f, CELLS - 1.0f);
+
+    uint32_t octant = (dir.x < 0.0f ? 1u : 0u) | (dir.y < 0.0f ? 2u : 0u)
+                    | (dir.z < 0.0f ? 4u : 0u);
+    uint32_t morton = spreadBits(static_cast<uint32_t>(cell.x))
+                    | spreadBits(static_cast<uint32_t>(cell.y)) << 1
+                    | spreadBits(static_cast<uint32_t>(cell.z)) << 2;
+    return octant << 21 | morton;
+}
+
+void CpuTracer::traceTileWavefront(const Scene& scene, uint32_t x0, uint32_t y0,
+                                   uint32_t x1, uint32_t y1, uint32_t samples,
+                                   const glm::mat4& invView, const glm::mat4& invProj,
+                                   WavefrontScratch& ws, uint64_t& rays)
+{
+    using Clock = std::chrono::steady_clock;
+    auto seconds = [](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double>(b - a).count();
+    };
+
+    const uint32_t tileW      = x1 - x0;
+    const uint32_t tilePixels = tileW * (y1 - y0);
+    const uint32_t chunk      = std::max(1u, std::min(samples, streamSize / tilePixels));
+
+    ws.accum.assign(tilePixels, glm::vec3(0.0f));
+    if (ws.bounces.size() < maxBounces + 1)
+        ws.bounces.resize(maxBounces + 1);
+
+    for (uint32_t s0 = 0; s0 < samples; s0 += chunk) {
+        // Path index = pixel-in-tile * n + sample-in-chunk, so camera rays
+        // through the same pixel are traced back to back
+        const uint32_t n         = std::min(chunk, samples - s0);
+        const uint32_t pathCount = n * tilePixels;
+        ws.paths   .resize(pathCount);
+        ws.hits    .resize(pathCount);
+        ws.payloads.resize(pathCount);
+        ws.shadows .resize(pathCount);
+        ws.active  .resize(pathCount);
+
+        for (uint32_t i = 0; i < pathCount; ++i) {
+            uint32_t   p    = i / n;
+            PathState& path = ws.paths[i];
+            path.ray        = primaryRay(x0 + p % tileW, y0 + p / tileW, s0 + i % n,
+                                         invView, invProj, path.seed);
+            path.color      = glm::vec3(0.0f);
+            path.throughput = glm::vec3(1.0f);
+            ws.active[i]    = i;
+        }
+
+        for (uint32_t bounce = 0; !ws.active.empty(); ++bounce) {
+            CpuBounceStats& bs = ws.bounces[bounce];
+
+            // -----------------------------------------------------------------
+            // Sort by direction octant + origin cell. Camera rays leave the
+            // tile already coherent and are traced in scanline order.
+            // -----------------------------------------------------------------
+            auto t0 = Clock::now();
+            if (bounce > 0) {
+                ws.keys.resize(ws.active.size());
+                for (size_t k = 0; k < ws.active.size(); ++k) {
+                    const Ray& r = ws.paths[ws.active[k]].ray;
+                    ws.keys[k] = uint64_t(coherenceKey(r.origin, r.dir)) << 32 | ws.active[k];
+                }
+                radixSortKeys(ws.keys, ws.keysTmp, 24);
+                for (size_t k = 0; k < ws.active.size(); ++k)
+                    ws.active[k] = static_cast<uint32_t>(ws.keys[k]);
+            }
+
+            // -----------------------------------------------------------------
+            // Closest-hit traversal of the whole stream
+            // -----------------------------------------------------------------
+            auto t1 = Clock::now();
+            for (uint32_t i : ws.active) {
+                Hit& hit = ws.hits[i];
+                hit.instance = ~0u;
+                intersect(ws.paths[i].ray, hit);
+            }
+            auto t2 = Clock::now();
+            bs.rays += ws.active.size();
+
+            // -----------------------------------------------------------------
+            // Group by shader: misses first, then one group per Material::type
+            // -----------------------------------------------------------------
+            constexpr uint32_t GROUPS = 4;
+            auto group = [&](uint32_t i) -> uint32_t {
+                const Hit& hit = ws.hits[i];
+                if (hit.instance == ~0u) return 0;
+                const Material& mat = scene.materials[instanceAccels[hit.instance].materialIndex];
+                return 1 + std::min<uint32_t>(mat.type, GROUPS - 2);
+            };
+            uint32_t offsets[GROUPS + 1] = {};
+            for (uint32_t i : ws.active) ++offsets[group(i) + 1];
+            for (uint32_t g = 0; g < GROUPS; ++g) offsets[g + 1] += offsets[g];
+            ws.keys.resize(ws.active.size());
+            for (uint32_t i : ws.active) ws.keys[offsets[group(i)]++] = i;
+
+            // -----------------------------------------------------------------
+            // Shade; shadow rays are collected rather than traced
+            // -----------------------------------------------------------------
+            ws.shadowActive.clear();
+            uint64_t shadeRays = 0;   // stays 0: every shadow ray is deferred
+            for (uint64_t item : ws.keys) {
+                uint32_t   i       = static_cast<uint32_t>(item);
+                Payload&   payload = ws.payloads[i];
+                payload.done       = false;
+                payload.seed       = ws.paths[i].seed;
+                payload.radiance   = glm::vec3(0.0f);
+                payload.throughput = glm::vec3(1.0f);
+                ws.shadows[i].pending = false;
+
+                if (ws.hits[i].instance == ~0u) {
+                    miss(ws.paths[i].ray, payload);
+                } else {
+                    closestHit(scene, ws.paths[i].ray, ws.hits[i], payload, shadeRays, &ws.shadows[i]);
+                    if (ws.shadows[i].pending)
+                        ws.shadowActive.push_back(i);
+                }
+            }
+
+            // -----------------------------------------------------------------
+            // Shadow stream: every ray heads for the sun, so origin cell alone
+            // orders it
+            // -----------------------------------------------------------------
+            auto t3 = Clock::now();
+            ws.keys.resize(ws.shadowActive.size());
+            for (size_t k = 0; k < ws.shadowActive.size(); ++k)
+                ws.keys[k] = uint64_t(coherenceKey(ws.shadows[ws.shadowActive[k]].origin, SUN_DIR)) << 32
+                           | ws.shadowActive[k];
+            radixSortKeys(ws.keys, ws.keysTmp, 24);
+
+            auto t4 = Clock::now();
+            for (uint64_t item : ws.keys) {
+                uint32_t i = static_cast<uint32_t>(item);
+                if (!occluded({ws.shadows[i].origin, SUN_DIR, 1e-3f, 1e4f}))
+                    ws.payloads[i].radiance += ws.shadows[i].light;
+            }
+            auto t5 = Clock::now();
+            bs.rays         += ws.shadowActive.size();
+            rays            += ws.active.size() + ws.shadowActive.size();
+            bs.sortSeconds  += seconds(t0, t1) + seconds(t3, t4);
+            bs.traceSeconds += seconds(t1, t2) + seconds(t4, t5);
+
+            // -----------------------------------------------------------------
+            // Advance and compact the stream, keeping it in sorted order
+            // -----------------------------------------------------------------
+            size_t alive = 0;
+            for (uint32_t i : ws.active) {
+                PathState& path = ws.paths[i];
+                if (advancePath(bounce, ws.payloads[i], path.ray, path.color,
+                                path.throughput, path.seed))
+                    ws.active[alive++] = i;
+            }
+            ws.active.resize(alive);
+        }
+
+        // Same running average as raygen, in sample order
+        for (uint32_t i = 0; i < pathCount; ++i) {
+            uint32_t s = s0 + i % n;
+            glm::vec3& acc = ws.accum[i / n];
+            acc = s == 0 ? ws.paths[i].color
+                         : glm::mix(acc, ws.paths[i].color, 1.0f / static_cast<float>(s + 1));
+        }
+    }
+
+    for (uint32_t p = 0; p < tilePixels; ++p) {
+        float* px = &pixels[(size_t(y0 + p / tileW) * imageWidth + x0 + p % tileW) * 4];
+        px[0] = ws.accum[p].x;
+        px[1] = ws.accum[p].y;
+        px[2] = ws.accum[p].z;
+        px[3] = 1.0f;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// render — tile-scheduled across all worker threads
+// ---------------------------------------------------------------------------
+
+void CpuTracer::render(const Scene& scene, uint32_t width, uint32_t height,
+                       uint32_t samples)
+{
+    CPU_ZONE("CpuTracer::render");
+    imageWidth  = width;
+    imageHeight = height;
+    pixels.assign(size_t(width) * height * 4, 0.0f);
+
+    const float     aspect  = static_cast<float>(width) / static_cast<float>(height);
+    const glm::mat4 invView = glm::inverse(scene.camera.getView());
+    const glm::mat4 invProj = glm::inverse(scene.camera.getProj(aspect));
+
+    // Wavefront tiles grow until one tile's paths fill a whole stream
+    const uint32_t tile = wavefront
+        ? std::max(tileSize, static_cast<uint32_t>(std::sqrt(streamSize / std::max(samples, 1u))))
+        : tileSize;
+    const uint32_t tilesX = (width  + tile - 1) / tile;
+    const uint32_t tilesY = (height + tile - 1) / tile;
+    const uint32_t tileCount = tilesX * tilesY;
+
+    uint32_t threads = threadCount ? threadCount
+                                   : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, tileCount);
+
+    std::atomic<uint32_t> nextTile{0};
+    std::atomic<uint64_t> totalRays{0};
+    std::mutex            statsMutex;
+
+    lastStats.bounces.assign(wavefront ? maxBounces + 1 : 0, CpuBounceStats{});
+
+    auto worker = [&]() {
+        CPU_ZONE("CpuTracer::worker");
+        uint64_t         rays = 0;
+        WavefrontScratch scratch;
+        for (uint32_t t; (t = nextTile.fetch_add(1)) < tileCount; ) {
+            uint32_t x0 = (t % tilesX) * tile;
+            uint32_t y0 = (t / tilesX) * tile;
+            uint32_t x1 = std::min(x0 + tile, width);
+            uint32_t y1 = std::min(y0 + tile, height);
+
+            if (wavefront) {
+                traceTileWavefront(scene, x0, y0, x1, y1, samples, invView, invProj,
+                                   scratch, rays);
+                continue;
+            }
+
+            for (uint32_t y = y0; y < y1; ++y)
+            for (uint32_t x = x0; x < x1; ++x) {
+                // Same running average as raygen: mix(prev, c, 1 / (n + 1))
+                glm::vec3 accum(0.0f);
+                for (uint32_t s = 0; s < samples; ++s) {
+                    glm::vec3 c = tracePath(scene, x, y, s, invView, invProj, rays);
+                    accum = s == 0 ? c : glm::mix(accum, c, 1.0f / static_cast<float>(s + 1));
+                }
+                float* px = &pixels[(size_t(y) * width + x) * 4];
+                px[0] = accum.x;
+                px[1] = accum.y;
+                px[2] = accum.z;
+                px[3] = 1.0f;
+            }
+        }
+        totalRays += rays;
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        for (size_t b = 0; b < scratch.bounces.size(); ++b) {
+            lastStats.bounces[b].rays         += scratch.bounces[b].rays;
+            lastStats.bounces[b].sortSeconds  += scratch.bounces[b].sortSeconds;
+            lastStats.bounces[b].traceSeconds += scratch.bounces[b].traceSeconds;
+        }
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> pool;
+    for (uint32_t i = 1; i < threads; ++i)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool)
+        t.join();
+
+    lastStats.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - t0).count();
+    lastStats.rays    = totalRays.load();
+    lastStats.threads = threads;
+
+    std::cout << "[CpuTracer] " << samples << " spp at " << width << "x" << height
+              << (wavefront ? " (wavefront)" : "")
+              << " on " << threads << " threads in " << lastStats.seconds * 1000.0 << " ms — "
+              << lastStats.mraysPerSec() << " Mrays/s ("
+              << lastStats.mraysPerSecPerCore() << " per core)\n";
+
+    for (size_t b = 0; b < lastStats.bounces.size(); ++b) {
+        const CpuBounceStats& bs = lastStats.bounces[b];
+        if (bs.rays == 0) continue;
+        std::cout << "[CpuTracer]   bounce " << b << ": " << bs.rays << " rays, sort "
+                  << bs.sortSeconds * 1000.0 << " ms, trace " << bs.traceSeconds * 1000.0
+                  << " ms (" << bs.rays / std::max(bs.traceSeconds, 1e-9) * 1e-6
+                  << " Mrays/s per core)\n";
+    }
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include "Scene.h"
+#include "Bvh.h"
+#include "WideBvh.h"
+#include "types.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// CpuTracer — multithreaded reference path tracer
+//
+// Reproduces the GPU shading model exactly: the bounce loop
+// and Russian roulette of raygen.rgen, the diffuse / GGX metal / glass
+// branches and sun shadow ray of the *.rchit shaders, the sky of miss.rmiss and
+// the PCG RNG of common.glsl. Used where no RT hardware is available and as a
+// golden reference for GPU output.
+//
+// Two execution modes produce bit-identical images:
+//   per-path  — each sample is traced bounce by bounce to completion
+//   wavefront — a tile's paths advance one bounce at a time as a stream;
+//               rays are sorted by direction octant and origin cell before
+//               traversal and hits are grouped by Material::type before
+//               shading, with the sun shadow rays traced as a second stream
+// ---------------------------------------------------------------------------
+
+// Wavefront mode only. Seconds are summed over workers (CPU time).
+struct CpuBounceStats {
+    uint64_t rays         = 0;   // path segments + shadow rays issued at this bounce
+    double   sortSeconds  = 0.0;
+    double   traceSeconds = 0.0;
+};
+
+struct CpuRenderStats {
+    double   seconds    = 0.0;
+    uint64_t rays       = 0;   // path segments + shadow rays
+    uint32_t threads    = 0;
+    std::vector<CpuBounceStats> bounces;
+
+    double mraysPerSec()        const { return seconds > 0.0 ? rays / seconds * 1e-6 : 0.0; }
+    double mraysPerSecPerCore() const { return threads ? mraysPerSec() / threads : 0.0; }
+};
+
+class CpuTracer {
+public:
+    uint32_t maxBounces  = 4;
+    uint32_t threadCount = 0;   // 0 = all hardware threads
+    uint32_t tileSize    = 16;
+    bool     wavefront   = false;
+    uint32_t streamSize  = 65536;  // wavefront: max paths in flight per worker
+
+    // Build per-mesh BVHs and the instance-level BVH for the scene.
+    void build (const Scene& scene);
+
+    // Accumulate `samples` spp into the rgba32f image with the same running
+    // average the raygen shader applies to the storage image.
+    void render(const Scene& scene, uint32_t width, uint32_t height, uint32_t samples);
+
+    const std::vector<float>& image() const { return pixels; }
+    const BvhStats& meshBvhStats(size_t mesh) const { return meshAccels[mesh].stats; }
+    const BvhStats& instanceBvhStats()        const { return topLevel.stats; }
+    const CpuRenderStats&     stats() const { return lastStats; }
+
+private:
+    // Per-mesh 8-wide BVH over the flattened GPU geometry arrays
+    struct MeshAccel {
+        WideBvh      bvh;
+        MeshGeometry geo;
+        Aabb         bounds;
+        BvhStats     stats;        // of the binary BVH it was collapsed from
+    };
+
+    struct InstanceAccel {
+        glm::mat4 objectToWorld;
+        glm::mat4 worldToObject;
+        uint32_t  meshIndex;
+        uint32_t  materialIndex;
+    };
+
+    struct Ray {
+        glm::vec3 origin;
+        glm::vec3 dir;
+        float     tMin;
+        float     tMax;
+    };
+
+    struct Hit : TriangleHit {
+        uint32_t instance = ~0u;
+    };
+
+    // Mirrors RayPayload in common.glsl
+    struct Payload {
+        glm::vec3 radiance;
+        glm::vec3 throughput;
+        glm::vec3 origin;
+        glm::vec3 direction;
+        bool      done;
+        uint32_t  seed;
+    };
+
+    // Sun shadow ray handed back by closestHit() instead of being traced
+    // inline; `light` is added to the payload radiance if it is unoccluded.
+    struct ShadowRequest {
+        glm::vec3 origin;
+        glm::vec3 light;
+        bool      pending = false;
+    };
+
+    // Wavefront path state; the pixel and sample are implied by the index
+    struct PathState {
+        Ray       ray;
+        glm::vec3 color;
+        glm::vec3 throughput;
+        uint32_t  seed;
+    };
+
+    // Per-worker stream buffers, reused across tiles
+    struct WavefrontScratch {
+        std::vector<PathState>     paths;
+        std::vector<Hit>           hits;
+        std::vector<Payload>       payloads;
+        std::vector<ShadowRequest> shadows;
+        std::vector<uint32_t>      active;
+        std::vector<uint32_t>      shadowActive;
+        std::vector<uint64_t>      keys;
+        std::vector<uint64_t>      keysTmp;
+        std::vector<glm::vec3>     accum;
+        std::vector<CpuBounceStats> bounces;
+    };
+
+    // Same layout Scene::uploadToGPU sends to the GPU
+    std::vector<Vertex>        allVerts;
+    std::vector<uint32_t>      allIndices;
+    std::vector<MeshRange>     meshRanges;
+
+    std::vector<MeshAccel>     meshAccels;
+    std::vector<InstanceAccel> instanceAccels;
+    Bvh                        topLevel;
+    Aabb                       sceneBounds;   // world space, for origin cells
+
+    std::vector<float> pixels;
+    uint32_t           imageWidth  = 0;
+    uint32_t           imageHeight = 0;
+    CpuRenderStats     lastStats;
+
+    bool intersect   (const Ray& ray, Hit& hit) const;   // closest hit
+    bool occluded    (const Ray& ray) const;             // any hit
+    bool intersectMesh(const MeshAccel& mesh, const Ray& ray, bool anyHit, Hit& hit) const;
+
+    // With `deferShadow` set the sun shadow ray is returned there rather
+    // than traced, and its contribution is left out of payload.radiance.
+    void closestHit(const Scene& scene, const Ray& ray, const Hit& hit,
+                    Payload& payload, uint64_t& rays,
+                    ShadowRequest* deferShadow = nullptr) const;
+    void miss      (const Ray& ray, Payload& payload) const;
+
+    // raygen.rgen: jittered camera ray; consumes the pixel's first two draws
+    Ray  primaryRay(uint32_t px, uint32_t py, uint32_t sampleIndex,
+                    const glm::mat4& invView, const glm::mat4& invProj,
+                    uint32_t& seed) const;
+
+    // raygen.rgen loop tail: accumulate the payload, step the ray and apply
+    // Russian roulette. Returns false once the path has terminated.
+    bool advancePath(uint32_t bounce, const Payload& payload, Ray& ray,
+                     glm::vec3& color, glm::vec3& throughput, uint32_t& seed) const;
+
+    glm::vec3 tracePath(const Scene& scene, uint32_t px, uint32_t py,
+                        uint32_t sampleIndex, const glm::mat4& invView,
+                        const glm::mat4& invProj, uint64_t& rays) const;
+
+    // Wavefront counterpart of the per-pixel tracePath() loop for one tile;
+    // writes the accumulated tile into `pixels`.
+    void traceTileWavefront(const Scene& scene, uint32_t x0, uint32_t y0,
+                            uint32_t x1, uint32_t y1, uint32_t samples,
+                            const glm::mat4& invView, const glm::mat4& invProj,
+                            WavefrontScratch& scratch, uint64_t& rays);
+    uint32_t coherenceKey(const glm::vec3& origin, const glm::vec3& dir) const;
+};
@@ -0,0 +1,202 @@
+#include "Denoiser.h"
+#include "CpuProfiler.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr uint32_t kDemodulate = 1;
+constexpr uint32_t kRemodulate = 2;
+constexpr uint32_t kGroupSize  = 8;   // atrous.comp local size, both axes
+
+// GPU profiler scope per pass
+constexpr const char* kPassNames[Denoiser::kMaxIterations] = {
+    "atrous 0", "atrous 1", "atrous 2", "atrous 3",
+    "atrous 4", "atrous 5", "atrous 6", "atrous 7",
+};
+
+// Shader writes of one stage become visible to compute shader reads
+void computeBarrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStage)
+{
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, srcStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// init
+// ---------------------------------------------------------------------------
+
+void Denoiser::init(VulkanContext& ctx, VkPipelineCache cache,
+                    const AllocatedImage& color, const AllocatedImage& moments,
+                    const AllocatedImage& normalDepth, const AllocatedImage& albedo)
+{
+    CPU_ZONE("Denoiser::init");
+    if (iterations > kMaxIterations)
+        throw std::runtime_error("Denoiser: at most " + std::to_string(kMaxIterations) + " iterations");
+
+    // ---- Ping-pong images --------------------------------------------------
+    for (AllocatedImage* img : {&ping, &pong})
+        *img = ctx.createImage(ctx.renderExtent.width, ctx.renderExtent.height,
+                               VK_FORMAT_R32G32B32A32_SFLOAT,
+                               VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+    VkCommandBuffer cmd = ctx.beginSingleTimeCommands();
+    for (VkImage image : {ping.image, pong.image}) {
+        VkImageMemoryBarrier b{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        b.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+        b.newLayout           = VK_IMAGE_LAYOUT_GENERAL;
+        b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        b.image               = image;
+        b.subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        b.dstAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &b);
+    }
+    ctx.endSingleTimeCommands(cmd);
+
+    // ---- Layouts and pipeline ---------------------------------------------
+    //  Binding 0  source (colour or the previous pass)
+    //  Binding 1  destination
+    //  Binding 2  luminance moments
+    //  Binding 3  normal + depth
+    //  Binding 4  albedo
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); ++i)
+        bindings[i] = {i, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr};
+
+    VkDescriptorSetLayoutCreateInfo dslCI{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    dslCI.bindingCount = static_cast<uint32_t>(bindings.size());
+    dslCI.pBindings    = bindings.data();
+    vkCreateDescriptorSetLayout(ctx.device, &dslCI, nullptr, &setLayout);
+
+    VkPushConstantRange pushRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(AtrousPushConstants)};
+    VkPipelineLayoutCreateInfo plCI{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    plCI.setLayoutCount         = 1;
+    plCI.pSetLayouts            = &setLayout;
+    plCI.pushConstantRangeCount = 1;
+    plCI.pPushConstantRanges    = &pushRange;
+    vkCreatePipelineLayout(ctx.device, &plCI, nullptr, &pipelineLayout);
+
+    VkShaderModule module = ctx.createShaderModule(spirvAtrous);
+
+    VkComputePipelineCreateInfo cpCI{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    cpCI.stage        = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    cpCI.stage.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+    cpCI.stage.module = module;
+    cpCI.stage.pName  = "main";
+    cpCI.layout       = pipelineLayout;
+    VkResult res = vkCreateComputePipelines(ctx.device, cache, 1, &cpCI, nullptr, &pipeline);
+    vkDestroyShaderModule(ctx.device, module, nullptr);
+    if (res != VK_SUCCESS)
+        throw std::runtime_error("Failed to create denoiser pipeline");
+
+    // ---- Descriptor sets ---------------------------------------------------
+    VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                  static_cast<uint32_t>(sets.size() * bindings.size())};
+    VkDescriptorPoolCreateInfo pi{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    pi.poolSizeCount = 1;
+    pi.pPoolSizes    = &poolSize;
+    pi.maxSets       = static_cast<uint32_t>(sets.size());
+    vkCreateDescriptorPool(ctx.device, &pi, nullptr, &descriptorPool);
+
+    std::array<VkDescriptorSetLayout, 3> layouts;
+    layouts.fill(setLayout);
+    VkDescriptorSetAllocateInfo ai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    ai.descriptorPool     = descriptorPool;
+    ai.descriptorSetCount = static_cast<uint32_t>(sets.size());
+    ai.pSetLayouts        = layouts.data();
+    vkAllocateDescriptorSets(ctx.device, &ai, sets.data());
+
+    const AllocatedImage* sources[3]      = {&color, &ping, &pong};
+    const AllocatedImage* destinations[3] = {&ping, &pong, &ping};
+    for (size_t s = 0; s < sets.size(); ++s) {
+        const AllocatedImage* images[5] = {sources[s], destinations[s], &moments, &normalDepth, &albedo};
+
+        std::array<VkDescriptorImageInfo, 5> infos{};
+        std::array<VkWriteDescriptorSet, 5>  writes{};
+        for (uint32_t b = 0; b < writes.size(); ++b) {
+            infos[b].imageView   = images[b]->view;
+            infos[b].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+            writes[b] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            writes[b].dstSet          = sets[s];
+            writes[b].dstBinding      = b;
+            writes[b].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[b].descriptorCount = 1;
+            writes[b].pImageInfo      = &infos[b];
+        }
+        vkUpdateDescriptorSets(ctx.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// record
+// ---------------------------------------------------------------------------
+
+void Denoiser::record(VkCommandBuffer cmd, VulkanContext& ctx, VkExtent2D extent)
+{
+    GpuScope scope(ctx.profiler, cmd, "denoise");
+
+    // The trace's colour, moments and guides
+    computeBarrier(cmd, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+    AtrousPushConstants pc{};
+    pc.size        = {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height)};
+    pc.sigmaColor  = sigmaColor;
+    pc.sigmaNormal = sigmaNormal;
+    pc.sigmaDepth  = sigmaDepth;
+
+    for (uint32_t i = 0; i < iterations; ++i) {
+        if (i > 0)
+            computeBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+        uint32_t pass = ctx.profiler.begin(cmd, kPassNames[i]);
+
+        VkDescriptorSet set = i == 0 ? sets[0] : sets[i % 2 ? 1 : 2];
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout,
+                                0, 1, &set, 0, nullptr);
+
+        pc.stepWidth = 1 << i;
+        pc.flags     = (i == 0 ? kDemodulate : 0) | (i + 1 == iterations ? kRemodulate : 0);
+        vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+                           0, sizeof(pc), &pc);
+
+        vkCmdDispatch(cmd, (extent.width  + kGroupSize - 1) / kGroupSize,
+                           (extent.height + kGroupSize - 1) / kGroupSize, 1);
+
+        ctx.profiler.end(cmd, pass);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// destroy
+// ---------------------------------------------------------------------------
+
+void Denoiser::destroy(VulkanContext& ctx)
+{
+    if (pipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(ctx.device, pipeline, nullptr);
+    if (pipelineLayout != VK_NULL_HANDLE)
+        vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
+    if (setLayout != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(ctx.device, setLayout, nullptr);
+    if (descriptorPool != VK_NULL_HANDLE)
+        vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
+    pipeline       = VK_NULL_HANDLE;
+    pipelineLayout = VK_NULL_HANDLE;
+    setLayout      = VK_NULL_HANDLE;
+    descriptorPool = VK_NULL_HANDLE;
+
+    ctx.destroyImage(ping);
+    ctx.destroyImage(pong);
+}
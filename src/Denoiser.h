@@ -0,0 +1,53 @@
+#pragma once
+#include "VulkanContext.h"
+#include "types.h"
+
+#include <array>
+
+// ---------------------------------------------------------------------------
+// Denoiser — edge-avoiding à-trous wavelet filter as compute passes
+//
+// Runs after the trace on the accumulated colour, guided by the first-hit
+// normal, depth and albedo AOVs raygen accumulates next to it (RTPipeline::
+// writeAovs) and by the luminance moments, which give each pixel's noise
+// level. Passes ping-pong between two images of its own, so the
+// accumulation image is only ever read and stays unbiased; output() is
+// what gets displayed or saved. Each pass is a GPU profiler scope
+// ("atrous 0", "atrous 1", ...).
+// ---------------------------------------------------------------------------
+
+class Denoiser {
+public:
+    static constexpr uint32_t kMaxIterations = 8;
+
+    uint32_t iterations  = 0;       // filter passes, 0 = off; pass i spans 2^i pixels
+    float    sigmaColor  = 4.0f;    // illumination edge stop, in standard errors
+    float    sigmaNormal = 128.0f;  // normal edge stop exponent
+    float    sigmaDepth  = 0.01f;   // relative depth change per pixel of tap distance
+
+    bool enabled() const { return iterations > 0; }
+
+    // All images are renderExtent rgba32f storage images in GENERAL layout
+    void init(VulkanContext& ctx, VkPipelineCache cache,
+              const AllocatedImage& color, const AllocatedImage& moments,
+              const AllocatedImage& normalDepth, const AllocatedImage& albedo);
+
+    // Filter the top-left `extent` of the colour image into output(). Waits
+    // for the trace's writes; the caller syncs its reads of output()
+    // (compute shader writes, GENERAL layout).
+    void record(VkCommandBuffer cmd, VulkanContext& ctx, VkExtent2D extent);
+
+    const AllocatedImage& output() const { return iterations % 2 ? ping : pong; }
+
+    void destroy(VulkanContext& ctx);
+
+private:
+    AllocatedImage ping, pong;
+
+    VkDescriptorSetLayout setLayout      = VK_NULL_HANDLE;
+    VkPipelineLayout      pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline            pipeline       = VK_NULL_HANDLE;
+    VkDescriptorPool      descriptorPool = VK_NULL_HANDLE;
+    // colour → ping, ping → pong, pong → ping
+    std::array<VkDescriptorSet, 3> sets{};
+};
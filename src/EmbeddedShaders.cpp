@@ -0,0 +1,63 @@
+#include "EmbeddedShaders.h"
+
+// The .inc files are generated into <build>/generated/shaders by the
+// Shaders target (see CMakeLists.txt)
+
+namespace {
+
+const uint32_t raygenCode[] = {
+#include "shaders/raygen.rgen.inc"
+};
+const uint32_t missCode[] = {
+#include "shaders/miss.rmiss.inc"
+};
+const uint32_t shadowMissCode[] = {
+#include "shaders/shadow.rmiss.inc"
+};
+const uint32_t diffuseHitCode[] = {
+#include "shaders/diffuse.rchit.inc"
+};
+const uint32_t metalHitCode[] = {
+#include "shaders/metal.rchit.inc"
+};
+const uint32_t glassHitCode[] = {
+#include "shaders/glass.rchit.inc"
+};
+const uint32_t atrousCode[] = {
+#include "shaders/atrous.comp.inc"
+};
+
+const uint32_t raygenAovCode[] = {
+#include "shaders/raygen.rgen.aov.inc"
+};
+const uint32_t missAovCode[] = {
+#include "shaders/miss.rmiss.aov.inc"
+};
+const uint32_t diffuseHitAovCode[] = {
+#include "shaders/diffuse.rchit.aov.inc"
+};
+const uint32_t metalHitAovCode[] = {
+#include "shaders/metal.rchit.aov.inc"
+};
+const uint32_t glassHitAovCode[] = {
+#include "shaders/glass.rchit.aov.inc"
+};
+
+template <size_t N>
+constexpr size_t wordCount(const uint32_t (&)[N]) { return N; }
+
+} // namespace
+
+const SpirvModule spirvRaygen     {"raygen.rgen",   raygenCode,     wordCount(raygenCode)};
+const SpirvModule spirvMiss       {"miss.rmiss",    missCode,       wordCount(missCode)};
+const SpirvModule spirvShadowMiss {"shadow.rmiss",  shadowMissCode, wordCount(shadowMissCode)};
+const SpirvModule spirvDiffuseHit {"diffuse.rchit", diffuseHitCode, wordCount(diffuseHitCode)};
+const SpirvModule spirvMetalHit   {"metal.rchit",   metalHitCode,   wordCount(metalHitCode)};
+const SpirvModule spirvGlassHit   {"glass.rchit",   glassHitCode,   wordCount(glassHitCode)};
+const SpirvModule spirvAtrous     {"atrous.comp",   atrousCode,     wordCount(atrousCode)};
+
+const SpirvModule spirvRaygenAov     {"raygen.rgen (AOVs)",   raygenAovCode,     wordCount(raygenAovCode)};
+const SpirvModule spirvMissAov       {"miss.rmiss (AOVs)",    missAovCode,       wordCount(missAovCode)};
+const SpirvModule spirvDiffuseHitAov {"diffuse.rchit (AOVs)", diffuseHitAovCode, wordCount(diffuseHitAovCode)};
+const SpirvModule spirvMetalHitAov   {"metal.rchit (AOVs)",   metalHitAovCode,   wordCount(metalHitAovCode)};
+const SpirvModule spirvGlassHitAov   {"glass.rchit (AOVs)",   glassHitAovCode,   wordCount(glassHitAovCode)};
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// ---------------------------------------------------------------------------
+// EmbeddedShaders — SPIR-V compiled into the executable
+//
+// CMake runs glslc on every shader in shaders/ with -mfmt=num and includes
+// the resulting word lists here, so nothing is read from disk at run time
+// and the program works from any working directory. The shaders that carry
+// the path payload are also built with -DWRITE_AOVS=1 (the *Aov modules).
+// ---------------------------------------------------------------------------
+
+struct SpirvModule {
+    const char*     name;    // source file, for messages
+    const uint32_t* code;
+    size_t          words;
+
+    size_t bytes() const { return words * sizeof(uint32_t); }
+};
+
+extern const SpirvModule spirvRaygen;
+extern const SpirvModule spirvMiss;
+extern const SpirvModule spirvShadowMiss;
+// Closest hit, one per material type
+extern const SpirvModule spirvDiffuseHit;
+extern const SpirvModule spirvMetalHit;
+extern const SpirvModule spirvGlassHit;
+// The same with the AOV payload fields
+extern const SpirvModule spirvRaygenAov;
+extern const SpirvModule spirvMissAov;
+extern const SpirvModule spirvDiffuseHitAov;
+extern const SpirvModule spirvMetalHitAov;
+extern const SpirvModule spirvGlassHitAov;
+// Compute
+extern const SpirvModule spirvAtrous;
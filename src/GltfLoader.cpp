@@ -0,0 +1,350 @@
+#include "GltfLoader.h"
+#include "CpuProfiler.h"
+#include "MappedFile.h"
+#include "MeshLoader.h"
+
+#define CGLTF_IMPLEMENTATION
+#include <cgltf.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+const char* resultString(cgltf_result r)
+{
+    switch (r) {
+    case cgltf_result_data_too_short:   return "data too short";
+    case cgltf_result_unknown_format:   return "unknown format";
+    case cgltf_result_invalid_json:     return "invalid JSON";
+    case cgltf_result_invalid_gltf:     return "invalid glTF";
+    case cgltf_result_invalid_options:  return "invalid options";
+    case cgltf_result_file_not_found:   return "file not found";
+    case cgltf_result_io_error:         return "I/O error";
+    case cgltf_result_out_of_memory:    return "out of memory";
+    case cgltf_result_legacy_gltf:      return "glTF 1.0 is not supported";
+    default:                            return "error";
+    }
+}
+
+void check(cgltf_result r, const std::string& path, const char* what)
+{
+    if (r != cgltf_result_success)
+        throw std::runtime_error(std::string("[GltfLoader] ") + what + " " + path + ": " + resultString(r));
+}
+
+const cgltf_accessor* findAttribute(const cgltf_primitive& prim, cgltf_attribute_type type)
+{
+    for (cgltf_size i = 0; i < prim.attributes_count; ++i)
+        if (prim.attributes[i].type == type && prim.attributes[i].index == 0)
+            return prim.attributes[i].data;
+    return nullptr;
+}
+
+// Pointer to the first element of an accessor if it can be read in place,
+// i.e. it is backed by a loaded buffer view and not sparse.
+const uint8_t* viewData(const cgltf_accessor* a)
+{
+    if (!a || a->is_sparse || !a->buffer_view)
+        return nullptr;
+    if (a->buffer_view->has_meshopt_compression && !a->buffer_view->data)
+        throw std::runtime_error("[GltfLoader] EXT_meshopt_compression is not supported");
+    const uint8_t* base = cgltf_buffer_view_data(a->buffer_view);
+    return base ? base + a->offset : nullptr;
+}
+
+bool isFloat3(const cgltf_accessor* a)
+{
+    return a && a->type == cgltf_type_vec3 && a->component_type == cgltf_component_type_r_32f;
+}
+
+// Try to describe `prim` as a MeshSource over the loaded buffers. Fails
+// (returns false) for anything that needs decoding or re-indexing.
+bool mapPrimitive(const cgltf_primitive& prim, MeshSource& src)
+{
+    if (prim.type != cgltf_primitive_type_triangles)
+        return false;
+
+    const cgltf_accessor* pos = findAttribute(prim, cgltf_attribute_type_position);
+    const cgltf_accessor* nrm = findAttribute(prim, cgltf_attribute_type_normal);
+    const cgltf_accessor* uv  = findAttribute(prim, cgltf_attribute_type_texcoord);
+
+    if (!isFloat3(pos) || !isFloat3(nrm) || nrm->count != pos->count)
+        return false;
+    if (pos->count > std::numeric_limits<uint32_t>::max())
+        return false;
+
+    MeshSource s;
+    s.positions      = viewData(pos);
+    s.positionStride = pos->stride;
+    s.normals        = viewData(nrm);
+    s.normalStride   = nrm->stride;
+    s.vertexCount    = static_cast<uint32_t>(pos->count);
+    if (!s.positions || !s.normals)
+        return false;
+
+    if (uv) {
+        if (uv->type != cgltf_type_vec2 || uv->count != pos->count)
+            return false;
+        if (uv->component_type == cgltf_component_type_r_32f)
+            s.uvComponentSize = 4;
+        else if (uv->normalized && uv->component_type == cgltf_component_type_r_16u)
+            s.uvComponentSize = 2;
+        else if (uv->normalized && uv->component_type == cgltf_component_type_r_8u)
+            s.uvComponentSize = 1;
+        else
+            return false;
+        s.uvs      = viewData(uv);
+        s.uvStride = uv->stride;
+        if (!s.uvs)
+            return false;
+    }
+
+    if (const cgltf_accessor* idx = prim.indices) {
+        switch (idx->component_type) {
+        case cgltf_component_type_r_8u:  s.indexSize = 1; break;
+        case cgltf_component_type_r_16u: s.indexSize = 2; break;
+        case cgltf_component_type_r_32u: s.indexSize = 4; break;
+        default: return false;
+        }
+        // Index data must be tightly packed to be copied as a block
+        if (idx->stride != s.indexSize || idx->count > std::numeric_limits<uint32_t>::max())
+            return false;
+        s.indices    = viewData(idx);
+        s.indexCount = static_cast<uint32_t>(idx->count / 3 * 3);
+        if (!s.indices)
+            return false;
+    } else {
+        s.indexCount = s.vertexCount / 3 * 3;
+    }
+
+    if (s.indexCount == 0)
+        return false;
+    src = s;
+    return true;
+}
+
+// Decode `prim` into the MeshData arrays, triangulating strips and fans and
+// rebuilding missing normals. Returns false for primitives without triangles.
+bool decodePrimitive(const cgltf_primitive& prim, MeshData& mesh)
+{
+    if (prim.type != cgltf_primitive_type_triangles &&
+        prim.type != cgltf_primitive_type_triangle_strip &&
+        prim.type != cgltf_primitive_type_triangle_fan)
+        return false;
+
+    const cgltf_accessor* pos = findAttribute(prim, cgltf_attribute_type_position);
+    const cgltf_accessor* nrm = findAttribute(prim, cgltf_attribute_type_normal);
+    const cgltf_accessor* uv  = findAttribute(prim, cgltf_attribute_type_texcoord);
+    if (!pos || pos->type != cgltf_type_vec3 || pos->count == 0)
+        return false;
+
+    const size_t n = pos->count;
+    std::vector<float> floats(n * 3);
+    cgltf_accessor_unpack_floats(pos, floats.data(), n * 3);
+    mesh.vertices.assign(n, Vertex{});
+    for (size_t i = 0; i < n; ++i)
+        mesh.vertices[i].pos = {floats[i * 3 + 0], floats[i * 3 + 1], floats[i * 3 + 2]};
+
+    const bool haveNormals = nrm && nrm->type == cgltf_type_vec3 && nrm->count == n;
+    if (haveNormals) {
+        cgltf_accessor_unpack_floats(nrm, floats.data(), n * 3);
+        for (size_t i = 0; i < n; ++i)
+            mesh.vertices[i].normal = {floats[i * 3 + 0], floats[i * 3 + 1], floats[i * 3 + 2]};
+    }
+    if (uv && uv->type == cgltf_type_vec2 && uv->count == n) {
+        cgltf_accessor_unpack_floats(uv, floats.data(), n * 2);
+        for (size_t i = 0; i < n; ++i)
+            mesh.vertices[i].uv = {floats[i * 2 + 0], floats[i * 2 + 1]};
+    }
+
+    std::vector<uint32_t> order(prim.indices ? prim.indices->count : n);
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = prim.indices ? static_cast<uint32_t>(cgltf_accessor_read_index(prim.indices, i))
+                                : static_cast<uint32_t>(i);
+
+    mesh.indices.clear();
+    if (prim.type == cgltf_primitive_type_triangles) {
+        mesh.indices.assign(order.begin(), order.begin() + order.size() / 3 * 3);
+    } else {
+        for (size_t i = 0; i + 2 < order.size(); ++i) {
+            if (prim.type == cgltf_primitive_type_triangle_fan)
+                mesh.indices.insert(mesh.indices.end(), {order[0], order[i + 1], order[i + 2]});
+            else if (i % 2 == 0)
+                mesh.indices.insert(mesh.indices.end(), {order[i], order[i + 1], order[i + 2]});
+            else
+                mesh.indices.insert(mesh.indices.end(), {order[i + 1], order[i], order[i + 2]});
+        }
+    }
+    if (mesh.indices.empty())
+        return false;
+
+    if (!haveNormals)
+        computeVertexNormals(mesh);
+    return true;
+}
+
+Material convertMaterial(const cgltf_material& src)
+{
+    Material m{};
+    m.baseColor = {1.0f, 1.0f, 1.0f};
+    m.metallic  = 1.0f;
+    m.roughness = 1.0f;
+    m.ior       = src.has_ior ? src.ior.ior : 1.5f;
+    m.type      = 0;
+
+    if (src.has_pbr_metallic_roughness) {
+        const cgltf_pbr_metallic_roughness& pbr = src.pbr_metallic_roughness;
+        m.baseColor = {pbr.base_color_factor[0], pbr.base_color_factor[1], pbr.base_color_factor[2]};
+        m.metallic  = pbr.metallic_factor;
+        m.roughness = pbr.roughness_factor;
+    }
+
+    float strength = src.has_emissive_strength ? src.emissive_strength.emissive_strength : 1.0f;
+    m.emissive = glm::vec3(src.emissive_factor[0], src.emissive_factor[1], src.emissive_factor[2]) * strength;
+
+    if (src.has_transmission && src.transmission.transmission_factor > 0.5f) {
+        m.type     = 2;   // glass
+        m.metallic = 0.0f;
+    } else if (m.metallic > 0.5f) {
+        m.type = 1;       // metal
+    }
+    return m;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// loadGltf
+// ---------------------------------------------------------------------------
+
+GltfLoadStats loadGltf(const std::string& path, Scene& scene)
+{
+    CPU_ZONE("loadGltf");
+    auto t0 = std::chrono::steady_clock::now();
+
+    auto file = std::make_shared<MappedFile>();
+    file->open(path);
+
+    cgltf_options options{};
+    cgltf_data*   raw = nullptr;
+    check(cgltf_parse(&options, file->data(), file->size(), &raw), path, "Failed to parse");
+    std::shared_ptr<cgltf_data> data(raw, cgltf_free);
+
+    // For .glb the binary chunk stays where it is in the mapping; external or
+    // data-URI buffers are read into memory owned by `data`.
+    check(cgltf_load_buffers(&options, data.get(), path.c_str()), path, "Failed to load buffers of");
+    check(cgltf_validate(data.get()), path, "Failed to validate");
+
+    // Zero-copy meshes point into these; keep them for the scene's lifetime
+    scene.assetStorage.push_back(file);
+    scene.assetStorage.push_back(data);
+
+    GltfLoadStats stats;
+    stats.bytes = file->size();
+
+    // Materials
+    const uint32_t firstMaterial = static_cast<uint32_t>(scene.materials.size());
+    for (cgltf_size i = 0; i < data->materials_count; ++i)
+        scene.materials.push_back(convertMaterial(data->materials[i]));
+    stats.materials = static_cast<uint32_t>(data->materials_count);
+
+    uint32_t defaultMaterial = std::numeric_limits<uint32_t>::max();
+    auto materialOf = [&](const cgltf_primitive& prim) {
+        if (prim.material)
+            return firstMaterial + static_cast<uint32_t>(cgltf_material_index(data.get(), prim.material));
+        if (defaultMaterial == std::numeric_limits<uint32_t>::max()) {
+            defaultMaterial = static_cast<uint32_t>(scene.materials.size());
+            scene.materials.push_back({{0.8f, 0.8f, 0.8f}, 0.0f, {0,0,0}, 0.9f, 1.5f, 0, {0,0}});
+            ++stats.materials;
+        }
+        return defaultMaterial;
+    };
+
+    // Meshes are converted the first time a node references them; instanced
+    // nodes share the MeshData entries.
+    constexpr uint32_t kUnloaded = std::numeric_limits<uint32_t>::max();
+    constexpr uint32_t kSkipped  = kUnloaded - 1;
+    std::vector<std::vector<uint32_t>> meshMap(data->meshes_count);
+
+    auto primitivesOf = [&](const cgltf_mesh* gm) -> const std::vector<uint32_t>& {
+        std::vector<uint32_t>& map = meshMap[cgltf_mesh_index(data.get(), gm)];
+        if (!map.empty())
+            return map;
+
+        map.assign(gm->primitives_count, kUnloaded);
+        for (cgltf_size p = 0; p < gm->primitives_count; ++p) {
+            const cgltf_primitive& prim = gm->primitives[p];
+            if (prim.has_draco_mesh_compression)
+                throw std::runtime_error("[GltfLoader] KHR_draco_mesh_compression is not supported: " + path);
+
+            MeshData mesh;
+            if (mapPrimitive(prim, mesh.source))
+                ++stats.zeroCopyMeshes;
+            else if (!decodePrimitive(prim, mesh)) {
+                map[p] = kSkipped;
+                continue;
+            }
+            stats.triangles += mesh.indexCount() / 3;
+
+            map[p] = static_cast<uint32_t>(scene.meshes.size());
+            scene.meshes.push_back(std::move(mesh));
+            ++stats.meshes;
+        }
+        return map;
+    };
+
+    // Walk the default scene (or every root node if there is none)
+    std::vector<const cgltf_node*> stack;
+    const cgltf_scene* gs = data->scene ? data->scene : (data->scenes_count ? &data->scenes[0] : nullptr);
+    if (gs) {
+        for (cgltf_size i = 0; i < gs->nodes_count; ++i)
+            stack.push_back(gs->nodes[i]);
+    } else {
+        for (cgltf_size i = 0; i < data->nodes_count; ++i)
+            if (!data->nodes[i].parent)
+                stack.push_back(&data->nodes[i]);
+    }
+
+    while (!stack.empty()) {
+        const cgltf_node* node = stack.back();
+        stack.pop_back();
+        for (cgltf_size i = 0; i < node->children_count; ++i)
+            stack.push_back(node->children[i]);
+        if (!node->mesh)
+            continue;
+
+        glm::mat4 world;
+        float     m[16];
+        cgltf_node_transform_world(node, m);
+        std::memcpy(&world, m, sizeof(m));   // both column-major
+
+        const std::vector<uint32_t>& prims = primitivesOf(node->mesh);
+        for (size_t p = 0; p < prims.size(); ++p) {
+            if (prims[p] == kSkipped)
+                continue;
+            SceneInstance inst;
+            inst.meshIndex     = prims[p];
+            inst.transform     = world;
+            inst.materialIndex = materialOf(node->mesh->primitives[p]);
+            scene.instances.push_back(inst);
+            ++stats.instances;
+        }
+    }
+
+    if (stats.instances == 0)
+        throw std::runtime_error(path + " contains no triangle meshes");
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::cout << "[GltfLoader] " << std::filesystem::path(path).filename().string() << ": "
+              << stats.meshes << " meshes (" << stats.zeroCopyMeshes << " zero-copy), "
+              << stats.instances << " instances, " << stats.materials << " materials, "
+              << stats.triangles << " triangles, " << stats.bytes / (1024.0 * 1024.0)
+              << " MB in " << stats.seconds * 1000.0 << " ms\n";
+    return stats;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "Scene.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ---------------------------------------------------------------------------
+// GltfLoader — glTF 2.0 (.glb / .gltf) import
+//
+// The file is memory-mapped and parsed with cgltf. Primitives whose vertex
+// attributes are already in a GPU-friendly format (float3 positions/normals,
+// float or normalized uvs, 8/16/32-bit indices) are not copied at all: their
+// MeshData points straight into the mapped buffer views and the data is
+// gathered into staging memory during upload. Everything else is decoded
+// into the regular MeshData arrays.
+// ---------------------------------------------------------------------------
+
+struct GltfLoadStats {
+    size_t   bytes            = 0;
+    double   seconds          = 0.0;
+    uint32_t meshes           = 0;   // MeshData entries added (one per primitive)
+    uint32_t zeroCopyMeshes   = 0;   // ... of which read in place from the file
+    uint32_t instances        = 0;
+    uint32_t materials        = 0;
+    size_t   triangles        = 0;
+};
+
+// Append the default scene of `path` to `scene`: its materials, one MeshData
+// per referenced primitive and one SceneInstance per (node, primitive) with
+// the node's world transform. The mapped file is kept alive in
+// scene.assetStorage. Textures are ignored; only material factors are used.
+// Throws std::runtime_error on I/O or format errors.
+GltfLoadStats loadGltf(const std::string& path, Scene& scene);
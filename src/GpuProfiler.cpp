@@ -0,0 +1,331 @@
+#include "GpuProfiler.h"
+#include "VulkanContext.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+// First query of a scope: blocks are contiguous runs of begin/end pairs
+uint32_t firstQuery(uint32_t block, uint32_t scope, uint32_t scopesPerBlock)
+{
+    return (block * scopesPerBlock + scope) * 2;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// init / destroy
+// ---------------------------------------------------------------------------
+
+void GpuProfiler::init(VulkanContext& ctx)
+{
+    if (!enabled)
+        return;
+
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(ctx.physicalDevice, &props);
+    nsPerTick = props.limits.timestampPeriod;
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(ctx.physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(ctx.physicalDevice, &familyCount, families.data());
+
+    validMask.resize(familyCount);
+    for (uint32_t i = 0; i < familyCount; ++i) {
+        uint32_t bits = families[i].timestampValidBits;
+        validMask[i]  = bits >= 64 ? ~0ull : (1ull << bits) - 1;
+    }
+    if (validMask[ctx.graphicsQueueFamily] == 0) {
+        std::cout << "[GpuProfiler] Graphics queue has no timestamps; profiling disabled\n";
+        enabled = false;
+        return;
+    }
+
+    device = ctx.device;
+    VkQueryPoolCreateInfo qi{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    qi.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    qi.queryCount = kBlocks * kScopesPerBlock * 2;
+    if (vkCreateQueryPool(ctx.device, &qi, nullptr, &pool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create timestamp query pool");
+    vkResetQueryPool(ctx.device, pool, 0, qi.queryCount);
+
+    blocks.assign(kBlocks, Block{});
+    for (Block& b : blocks) {
+        b.names.reserve(kScopesPerBlock);
+        b.tags.reserve(kScopesPerBlock);
+    }
+}
+
+void GpuProfiler::destroy(VulkanContext& ctx)
+{
+    if (pool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(ctx.device, pool, nullptr);
+    pool = VK_NULL_HANDLE;
+    blocks.clear();
+    recording.clear();
+}
+
+// ---------------------------------------------------------------------------
+// Command buffer tracking
+// ---------------------------------------------------------------------------
+
+GpuProfiler::Open* GpuProfiler::findOpen(VkCommandBuffer cmd)
+{
+    for (Open& o : recording)
+        if (o.cmd == cmd)
+            return &o;
+    return nullptr;
+}
+
+// Queries are reset on the host, so a block is reusable as soon as its
+// results are read (or its command buffer was never submitted)
+void GpuProfiler::release(Block& block)
+{
+    uint32_t index = static_cast<uint32_t>(&block - blocks.data());
+    vkResetQueryPool(device, pool, firstQuery(index, 0, kScopesPerBlock), kScopesPerBlock * 2);
+    block.state = BlockState::Free;
+    block.cmd   = VK_NULL_HANDLE;
+    block.names.clear();
+    block.tags.clear();
+}
+
+void GpuProfiler::open(VkCommandBuffer cmd, uint32_t queueFamily)
+{
+    if (pool == VK_NULL_HANDLE)
+        return;
+
+    if (Open* o = findOpen(cmd)) {
+        // Re-recorded without having been submitted
+        if (o->block != kNoScope)
+            release(blocks[o->block]);
+        *o = {cmd, queueFamily, kNoScope};
+        return;
+    }
+    recording.push_back({cmd, queueFamily, kNoScope});
+}
+
+void GpuProfiler::submitted(VkCommandBuffer cmd, VkSemaphore timeline, uint64_t value)
+{
+    Open* o = findOpen(cmd);
+    if (!o)
+        return;
+
+    if (o->block != kNoScope) {
+        Block& b   = blocks[o->block];
+        b.state    = BlockState::Submitted;
+        b.timeline = timeline;
+        b.value    = value;
+    }
+    *o = recording.back();
+    recording.pop_back();
+}
+
+// ---------------------------------------------------------------------------
+// Scopes
+// ---------------------------------------------------------------------------
+
+uint32_t GpuProfiler::begin(VkCommandBuffer cmd, const char* name, uint64_t tag)
+{
+    Open* o = pool != VK_NULL_HANDLE ? findOpen(cmd) : nullptr;
+    if (!o || validMask[o->family] == 0)
+        return kNoScope;
+
+    if (o->block == kNoScope) {
+        auto it = std::find_if(blocks.begin(), blocks.end(),
+                               [](const Block& b) { return b.state == BlockState::Free; });
+        if (it == blocks.end()) {
+            ++droppedScopes;
+            return kNoScope;
+        }
+        it->state  = BlockState::Recording;
+        it->cmd    = cmd;
+        it->family = o->family;
+        o->block   = static_cast<uint32_t>(it - blocks.begin());
+    }
+
+    Block& b = blocks[o->block];
+    if (b.names.size() == kScopesPerBlock) {
+        ++droppedScopes;
+        return kNoScope;
+    }
+
+    uint32_t scope = static_cast<uint32_t>(b.names.size());
+    b.names.push_back(name);
+    b.tags.push_back(tag);
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool,
+                        firstQuery(o->block, scope, kScopesPerBlock));
+    return o->block * kScopesPerBlock + scope;
+}
+
+void GpuProfiler::end(VkCommandBuffer cmd, uint32_t scope)
+{
+    if (scope == kNoScope)
+        return;
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool, scope * 2 + 1);
+}
+
+// ---------------------------------------------------------------------------
+// collect
+// ---------------------------------------------------------------------------
+
+void GpuProfiler::collect(VulkanContext& ctx)
+{
+    if (pool == VK_NULL_HANDLE)
+        return;
+
+    // Per query: value, availability
+    uint64_t results[kScopesPerBlock * 2 * 2];
+
+    for (uint32_t i = 0; i < kBlocks; ++i) {
+        Block& b = blocks[i];
+        if (b.state != BlockState::Submitted)
+            continue;
+
+        uint64_t reached = 0;
+        vkGetSemaphoreCounterValue(ctx.device, b.timeline, &reached);
+        if (reached < b.value)
+            continue;
+
+        uint32_t queries = static_cast<uint32_t>(b.names.size()) * 2;
+        vkGetQueryPoolResults(ctx.device, pool, firstQuery(i, 0, kScopesPerBlock), queries,
+                              sizeof(results), results, 2 * sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+        const uint64_t mask = validMask[b.family];
+        for (uint32_t s = 0; s < b.names.size(); ++s) {
+            const uint64_t* q = results + s * 4;
+            if (!q[1] || !q[3])
+                continue;   // scope never ended
+
+            uint64_t start = q[0] & mask;
+            uint64_t ns    = static_cast<uint64_t>(((q[2] - q[0]) & mask) * nsPerTick);
+
+            // Blocks are scanned in pool order, not submission order
+            Series& ser = series[b.names[s]];
+            float   ms  = static_cast<float>(ns * 1e-6);
+            if (ser.count == 0 || b.value >= ser.lastValue) {
+                ser.last      = ms;
+                ser.lastTag   = b.tags[s];
+                ser.lastValue = b.value;
+            }
+            if (ser.window.size() < kWindow)
+                ser.window.push_back(ms);
+            else
+                ser.window[ser.next] = ms;
+            ser.next = (ser.next + 1) % kWindow;
+            ++ser.count;
+
+            if (trace && events.size() < kMaxTraceEvents)
+                events.push_back({b.names[s], b.family,
+                                  static_cast<uint64_t>(start * nsPerTick), ns});
+        }
+        release(b);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Statistics / export
+// ---------------------------------------------------------------------------
+
+bool GpuProfiler::latest(const char* name, Sample& out) const
+{
+    auto it = series.find(name);
+    if (it == series.end() || it->second.count == 0)
+        return false;
+    out = {it->second.count, it->second.last, it->second.lastTag};
+    return true;
+}
+
+std::vector<GpuProfiler::ScopeStats> GpuProfiler::stats() const
+{
+    std::vector<ScopeStats> out;
+    std::vector<float>      sorted;
+    for (const auto& [name, ser] : series) {
+        if (ser.window.empty())
+            continue;
+        sorted = ser.window;
+        size_t p99 = (sorted.size() * 99 + 99) / 100 - 1;
+        std::nth_element(sorted.begin(), sorted.begin() + p99, sorted.end());
+
+        double sum = 0.0;
+        for (float v : ser.window)
+            sum += v;
+
+        ScopeStats s;
+        s.name   = name;
+        s.count  = ser.count;
+        s.lastMs = ser.last;
+        s.minMs  = *std::min_element(ser.window.begin(), ser.window.end());
+        s.avgMs  = sum / ser.window.size();
+        s.p99Ms  = sorted[p99];
+        out.push_back(s);
+    }
+    return out;
+}
+
+void GpuProfiler::report() const
+{
+    if (pool == VK_NULL_HANDLE)
+        return;
+
+    std::cout << "[GpuProfiler] GPU time per scope (ms, last " << kWindow << " samples)\n"
+              << std::left  << std::setw(16) << "scope"
+              << std::right << std::setw(10) << "count" << std::setw(10) << "min"
+              << std::setw(10) << "avg" << std::setw(10) << "p99" << '\n';
+    for (const ScopeStats& s : stats())
+        std::cout << std::left  << std::setw(16) << s.name
+                  << std::right << std::setw(10) << s.count
+                  << std::fixed << std::setprecision(3)
+                  << std::setw(10) << s.minMs << std::setw(10) << s.avgMs
+                  << std::setw(10) << s.p99Ms << '\n';
+    std::cout.unsetf(std::ios::floatfield);
+    if (droppedScopes)
+        std::cout << "[GpuProfiler] " << droppedScopes << " scopes dropped (no free queries)\n";
+}
+
+bool GpuProfiler::writeChromeTrace(const std::string& path) const
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cerr << "[GpuProfiler] Cannot write " << path << "\n";
+        return false;
+    }
+
+    uint64_t origin = UINT64_MAX;
+    std::vector<uint32_t> families;
+    for (const TraceEvent& e : events) {
+        origin = std::min(origin, e.startNs);
+        if (std::find(families.begin(), families.end(), e.family) == families.end())
+            families.push_back(e.family);
+    }
+
+    // Complete ("X") events in microseconds, one thread per queue family
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (uint32_t f : families) {
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << f
+            << ",\"args\":{\"name\":\"GPU queue family " << f << "\"}}";
+        first = false;
+    }
+    out << std::fixed << std::setprecision(3);
+    for (const TraceEvent& e : events) {
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.family
+            << ",\"ts\":" << (e.startNs - origin) * 1e-3 << ",\"dur\":" << e.durationNs * 1e-3 << '}';
+        first = false;
+    }
+    out << "\n]}\n";
+
+    if (!out.flush()) {
+        std::cerr << "[GpuProfiler] Write to " << path << " failed\n";
+        return false;
+    }
+    std::cout << "[GpuProfiler] Wrote " << events.size() << " events to " << path << '\n';
+    return true;
+}
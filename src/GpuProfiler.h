@@ -0,0 +1,140 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+class VulkanContext;
+
+// ---------------------------------------------------------------------------
+// GpuProfiler — timestamp queries around GPU passes
+//
+// A command buffer announced with open() takes a block of queries from one
+// pool on its first scope. Once submitted() knows which timeline value
+// completes it, collect() reads the block back. collect() never waits:
+// frame slots are only reused after their timeline value has passed, so
+// the results are ready by the time anyone asks. Durations feed rolling
+// per-scope statistics (min / avg / p99 over the last kWindow samples) and,
+// with `trace`, an event list for writeChromeTrace(). A scope may carry a
+// caller-defined tag, returned with the scope's latest sample so the caller
+// can tell which piece of work was measured.
+//
+// Scope names must outlive the profiler (string literals).
+// Used from the thread that owns the VulkanContext only.
+// ---------------------------------------------------------------------------
+
+class GpuProfiler {
+public:
+    static constexpr uint32_t kNoScope = UINT32_MAX;
+
+    bool enabled = false;   // set before init(); off makes every call a no-op
+    bool trace   = false;   // keep individual events for writeChromeTrace()
+
+    void init   (VulkanContext& ctx);
+    void destroy(VulkanContext& ctx);
+
+    // `cmd` starts recording for a queue of `queueFamily` (re-opening a reused
+    // command buffer drops whatever it recorded before)
+    void open     (VkCommandBuffer cmd, uint32_t queueFamily);
+    // `cmd` went out in a submission that signals `timeline` to `value`
+    void submitted(VkCommandBuffer cmd, VkSemaphore timeline, uint64_t value);
+    // Read back every block whose submission has completed
+    void collect  (VulkanContext& ctx);
+
+    uint32_t begin(VkCommandBuffer cmd, const char* name, uint64_t tag = 0);
+    void     end  (VkCommandBuffer cmd, uint32_t scope);
+
+    // Most recently submitted of the collected samples of `name`; false if
+    // there are none. `count` grows with every sample, so a caller can tell
+    // a new one from the one it saw last time.
+    struct Sample {
+        uint64_t count;
+        float    ms;
+        uint64_t tag;
+    };
+    bool latest(const char* name, Sample& out) const;
+
+    struct ScopeStats {
+        std::string name;
+        uint64_t    count;      // samples since init
+        double      lastMs, minMs, avgMs, p99Ms;   // min / avg / p99 over the window
+    };
+    std::vector<ScopeStats> stats() const;
+    void                    report() const;
+
+    // Chrome trace event JSON (chrome://tracing, Perfetto); one track per
+    // queue family. Returns false if the file cannot be written.
+    bool writeChromeTrace(const std::string& path) const;
+
+private:
+    static constexpr uint32_t kScopesPerBlock = 32;
+    static constexpr uint32_t kBlocks         = 64;
+    static constexpr size_t   kWindow         = 1024;
+    static constexpr size_t   kMaxTraceEvents = 1u << 20;
+
+    enum class BlockState { Free, Recording, Submitted };
+
+    struct Block {
+        BlockState               state = BlockState::Free;
+        VkCommandBuffer          cmd   = VK_NULL_HANDLE;
+        uint32_t                 family = 0;
+        std::vector<const char*> names;          // one per scope, in query order
+        std::vector<uint64_t>    tags;           // and its begin() tag
+        VkSemaphore              timeline = VK_NULL_HANDLE;
+        uint64_t                 value    = 0;
+    };
+
+    // Command buffer that has been opened but has no block yet
+    struct Open {
+        VkCommandBuffer cmd;
+        uint32_t        family;
+        uint32_t        block;                   // kNoScope until the first begin()
+    };
+
+    struct Series {
+        std::vector<float> window;               // ring of the last kWindow durations
+        size_t             next  = 0;
+        uint64_t           count = 0;
+        float              last  = 0.0f;
+        uint64_t           lastTag   = 0;
+        uint64_t           lastValue = 0;        // timeline value of `last`'s submission
+    };
+
+    struct TraceEvent {
+        const char* name;
+        uint32_t    family;
+        uint64_t    startNs;
+        uint64_t    durationNs;
+    };
+
+    VkDevice                      device = VK_NULL_HANDLE;
+    VkQueryPool                   pool   = VK_NULL_HANDLE;
+    double                        nsPerTick = 1.0;
+    std::vector<uint64_t>         validMask;     // per queue family; 0 = no timestamps
+    std::vector<Block>            blocks;
+    std::vector<Open>             recording;
+    std::map<std::string, Series> series;
+    std::vector<TraceEvent>       events;
+    uint64_t                      droppedScopes = 0;
+
+    Open* findOpen(VkCommandBuffer cmd);
+    void  release(Block& block);
+};
+
+// Brackets the commands recorded during its lifetime
+class GpuScope {
+public:
+    GpuScope(GpuProfiler& profiler, VkCommandBuffer cmd, const char* name)
+        : profiler(profiler), cmd(cmd), scope(profiler.begin(cmd, name)) {}
+    ~GpuScope() { profiler.end(cmd, scope); }
+
+    GpuScope(const GpuScope&)            = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+
+private:
+    GpuProfiler&    profiler;
+    VkCommandBuffer cmd;
+    uint32_t        scope;
+};
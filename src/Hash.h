@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// ---------------------------------------------------------------------------
+// Hash — 64-bit non-cryptographic content hash (xxHash64 construction)
+//
+// Used for scene cache keys and geometry deduplication. Runs at memory speed;
+// equal hashes still have to be confirmed by comparing the data.
+// ---------------------------------------------------------------------------
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
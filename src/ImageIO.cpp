@@ -0,0 +1,85 @@
+// stb_image_write implementation — compiled exactly once here
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "ImageIO.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Portable FloatMap: text header, then float32 RGB rows bottom to top in
+// host byte order, which the sign of the scale line records
+bool writePfm(const std::string& path, uint32_t width, uint32_t height, const float* rgba)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+
+    const uint16_t probe = 1;
+    uint8_t        firstByte;
+    std::memcpy(&firstByte, &probe, 1);
+    out << "PF\n" << width << ' ' << height << '\n' << (firstByte ? "-1.0" : "1.0") << '\n';
+
+    std::vector<float> row(size_t(width) * 3);
+    for (uint32_t y = height; y-- > 0;) {
+        const float* src = rgba + size_t(y) * width * 4;
+        for (uint32_t x = 0; x < width; ++x) {
+            row[x * 3 + 0] = src[x * 4 + 0];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 2];
+        }
+        out.write(reinterpret_cast<const char*>(row.data()),
+                  static_cast<std::streamsize>(row.size() * sizeof(float)));
+    }
+    return static_cast<bool>(out.flush());
+}
+
+} // namespace
+
+void writeImage(const std::string& path, uint32_t width, uint32_t height,
+                const float* rgba)
+{
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    const int w = static_cast<int>(width);
+    const int h = static_cast<int>(height);
+    int ok = 0;
+
+    if (ext == ".hdr") {
+        std::vector<float> rgb(size_t(width) * height * 3);
+        for (size_t i = 0; i < size_t(width) * height; ++i) {
+            rgb[i * 3 + 0] = rgba[i * 4 + 0];
+            rgb[i * 3 + 1] = rgba[i * 4 + 1];
+            rgb[i * 3 + 2] = rgba[i * 4 + 2];
+        }
+        ok = stbi_write_hdr(path.c_str(), w, h, 3, rgb.data());
+
+    } else if (ext == ".pfm") {
+        ok = writePfm(path, width, height, rgba);
+
+    } else if (ext == ".png") {
+        // Same conversion as the float → UNORM swapchain blit: clamp, no tonemap
+        std::vector<uint8_t> ldr(size_t(width) * height * 4);
+        for (size_t i = 0; i < ldr.size(); ++i) {
+            float v = std::clamp(rgba[i], 0.0f, 1.0f);
+            ldr[i]  = static_cast<uint8_t>(v * 255.0f + 0.5f);
+        }
+        ok = stbi_write_png(path.c_str(), w, h, 4, ldr.data(), w * 4);
+
+    } else {
+        throw std::runtime_error("Unsupported image format '" + ext +
+                                 "' (use .png, .hdr or .pfm): " + path);
+    }
+
+    if (!ok)
+        throw std::runtime_error("Failed to write image: " + path);
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Write an RGBA32F image to disk. The format is chosen from the extension:
+//   .hdr  — Radiance HDR, linear float radiance (alpha dropped)
+//   .pfm  — Portable FloatMap, exact float32 RGB incl. negatives (alpha dropped)
+//   .png  — 8-bit, clamped to [0,1] exactly like the swapchain blit
+// Throws std::runtime_error on an unknown extension or a failed write.
+void writeImage(const std::string& path, uint32_t width, uint32_t height,
+                const float* rgba);
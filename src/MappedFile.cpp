@@ -0,0 +1,100 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+void MappedFile::open(const std::string& path)
+{
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Failed to open " + path);
+    fileHandle = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        close();
+        throw std::runtime_error("Failed to stat " + path);
+    }
+    length = static_cast<size_t>(size.QuadPart);
+    if (length == 0)
+        return;
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        close();
+        throw std::runtime_error("Failed to map " + path);
+    }
+    mappingHandle = mapping;
+
+    bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!bytes) {
+        close();
+        throw std::runtime_error("Failed to map " + path);
+    }
+}
+
+void MappedFile::close()
+{
+    if (bytes)         UnmapViewOfFile(bytes);
+    if (mappingHandle) CloseHandle(static_cast<HANDLE>(mappingHandle));
+    if (fileHandle)    CloseHandle(static_cast<HANDLE>(fileHandle));
+    bytes         = nullptr;
+    mappingHandle = nullptr;
+    fileHandle    = nullptr;
+    length        = 0;
+}
+
+#else
+
+void MappedFile::open(const std::string& path)
+{
+    close();
+
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open " + path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close();
+        throw std::runtime_error("Failed to stat " + path);
+    }
+    length = static_cast<size_t>(st.st_size);
+    if (length == 0)
+        return;
+
+    void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        close();
+        throw std::runtime_error("Failed to map " + path);
+    }
+    // Chunks are parsed concurrently front to back; ask for aggressive readahead
+    madvise(p, length, MADV_WILLNEED);
+    bytes = static_cast<const char*>(p);
+}
+
+void MappedFile::close()
+{
+    if (bytes)  munmap(const_cast<char*>(bytes), length);
+    if (fd >= 0) ::close(fd);
+    bytes  = nullptr;
+    length = 0;
+    fd     = -1;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// ---------------------------------------------------------------------------
+// MappedFile — read-only memory map of a whole file
+//
+// The OS pages the file in on demand, so loaders can hand disjoint byte
+// ranges to worker threads without reading it up front.
+// ---------------------------------------------------------------------------
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Throws std::runtime_error if the file cannot be opened or mapped.
+    void open(const std::string& path);
+    void close();
+
+    const char* data() const { return bytes; }
+    size_t      size() const { return length; }
+
+private:
+    const char* bytes  = nullptr;
+    size_t      length = 0;
+#ifdef _WIN32
+    void*       fileHandle    = nullptr;
+    void*       mappingHandle = nullptr;
+#else
+    int         fd = -1;
+#endif
+};
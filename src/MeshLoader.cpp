@@ -0,0 +1,790 @@
+#include "MeshLoader.h"
+#include "CpuProfiler.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Worker pool helper — fn(i) for every i in [0, count), first error rethrown
+// ---------------------------------------------------------------------------
+
+template <typename Fn>
+void parallelFor(uint32_t count, uint32_t threads, Fn&& fn)
+{
+    std::atomic<uint32_t> next{0};
+    std::exception_ptr    error;
+    std::mutex            errorMutex;
+
+    auto worker = [&]() {
+        CPU_ZONE("loader worker");
+        try {
+            for (uint32_t i; (i = next.fetch_add(1)) < count; )
+                fn(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+            next = count;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (uint32_t t = 1; t < std::min(threads, count); ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool)
+        t.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// [begin, end) of part `i` when `count` items are split into `parts`
+inline size_t rangeBegin(size_t count, uint32_t parts, uint32_t i)
+{
+    return count * i / parts;
+}
+
+// Area-weighted smooth normals for meshes that ship without them. With
+// `supplied`, vertices whose entry is non-zero keep the normal they have and
+// only the rest are rebuilt.
+void computeNormals(MeshData& mesh, uint32_t threads,
+                    const std::vector<uint8_t>* supplied = nullptr)
+{
+    auto rebuild = [&](size_t v) { return !supplied || !(*supplied)[v]; };
+
+    for (size_t v = 0; v < mesh.vertices.size(); ++v)
+        if (rebuild(v))
+            mesh.vertices[v].normal = glm::vec3(0.0f);
+
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        const uint32_t i0 = mesh.indices[i + 0];
+        const uint32_t i1 = mesh.indices[i + 1];
+        const uint32_t i2 = mesh.indices[i + 2];
+        Vertex& v0 = mesh.vertices[i0];
+        Vertex& v1 = mesh.vertices[i1];
+        Vertex& v2 = mesh.vertices[i2];
+        glm::vec3 n = glm::cross(v1.pos - v0.pos, v2.pos - v0.pos);
+        if (rebuild(i0)) v0.normal += n;
+        if (rebuild(i1)) v1.normal += n;
+        if (rebuild(i2)) v2.normal += n;
+    }
+
+    const uint32_t parts = threads * 4;
+    parallelFor(parts, threads, [&](uint32_t part) {
+        size_t end = rangeBegin(mesh.vertices.size(), parts, part + 1);
+        for (size_t i = rangeBegin(mesh.vertices.size(), parts, part); i < end; ++i) {
+            if (!rebuild(i))
+                continue;
+            glm::vec3& n   = mesh.vertices[i].normal;
+            float      len = glm::length(n);
+            n = len > 0.0f ? n / len : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Text scanning
+// ---------------------------------------------------------------------------
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline const char* skipBlanks(const char* p, const char* end)
+{
+    while (p < end && isBlank(*p)) ++p;
+    return p;
+}
+
+inline const char* nextLine(const char* p, const char* end)
+{
+    const void* nl = std::memchr(p, '\n', static_cast<size_t>(end - p));
+    return nl ? static_cast<const char*>(nl) + 1 : end;
+}
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Decimal float without locale or allocation: [+-]digits[.digits][(e|E)[+-]digits]
+float parseFloat(const char*& p, const char* end)
+{
+    static constexpr double POW10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    p = skipBlanks(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    double mantissa = 0.0;
+    int    exponent = 0;
+    while (p < end && isDigit(*p))
+        mantissa = mantissa * 10.0 + (*p++ - '0');
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && isDigit(*p)) {
+            mantissa = mantissa * 10.0 + (*p++ - '0');
+            --exponent;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negExp = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negExp = *p++ == '-';
+        int e = 0;
+        while (p < end && isDigit(*p))
+            e = std::min(e * 10 + (*p++ - '0'), 1000);
+        exponent += negExp ? -e : e;
+    }
+
+    double value;
+    if (exponent >= 0 && exponent <= 22)       value = mantissa * POW10[exponent];
+    else if (exponent < 0 && exponent >= -22)  value = mantissa / POW10[-exponent];
+    else                                       value = mantissa * std::pow(10.0, exponent);
+    return static_cast<float>(negative ? -value : value);
+}
+
+inline long parseInt(const char*& p, const char* end)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    long v = 0;
+    while (p < end && isDigit(*p))
+        v = v * 10 + (*p++ - '0');
+    return negative ? -v : v;
+}
+
+// ---------------------------------------------------------------------------
+// OBJ
+//
+// Pass 1 counts v / vn / vt records and triangles per chunk, a prefix sum
+// turns the counts into output offsets, and pass 2 parses every chunk
+// straight into its slice of the shared arrays. OBJ indexes positions,
+// normals and uvs separately; a corner whose v/vt/vn combination differs
+// from the first one seen for that position becomes a new seam vertex.
+// ---------------------------------------------------------------------------
+
+constexpr uint32_t NO_INDEX = ~0u;
+
+struct ObjCorner {
+    uint32_t v, vt, vn;
+};
+
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+    size_t positions = 0, normals = 0, uvs = 0, triangles = 0;
+    size_t posOffset = 0, nrmOffset = 0, uvOffset = 0, triOffset = 0;
+};
+
+// Number of whitespace-separated tokens between p and the end of the line
+uint32_t countTokens(const char* p, const char* end)
+{
+    uint32_t n = 0;
+    for (;;) {
+        p = skipBlanks(p, end);
+        if (p >= end || *p == '\n' || *p == '#') return n;
+        ++n;
+        while (p < end && !isBlank(*p) && *p != '\n') ++p;
+    }
+}
+
+void countObjChunk(ObjChunk& c)
+{
+    for (const char* p = c.begin; p < c.end; p = nextLine(p, c.end)) {
+        p = skipBlanks(p, c.end);
+        if (c.end - p < 2) continue;
+
+        if (p[0] == 'v') {
+            if      (isBlank(p[1])) ++c.positions;
+            else if (p[1] == 'n')   ++c.normals;
+            else if (p[1] == 't')   ++c.uvs;
+        } else if (p[0] == 'f' && isBlank(p[1])) {
+            uint32_t n = countTokens(p + 1, c.end);
+            if (n >= 3) c.triangles += n - 2;
+        }
+    }
+}
+
+// One "v[/vt][/vn]" face token. `count` is how many of that attribute the
+// file has defined so far, for resolving negative (relative) indices.
+uint32_t resolveIndex(long idx, size_t count)
+{
+    if (idx > 0)  return static_cast<uint32_t>(idx - 1);
+    if (idx < 0 && static_cast<size_t>(-idx) <= count)
+        return static_cast<uint32_t>(count + idx);
+    throw std::runtime_error("OBJ: invalid face index " + std::to_string(idx));
+}
+
+void parseObjChunk(const ObjChunk& c, glm::vec3* positions, glm::vec3* normals,
+                   glm::vec2* uvs, ObjCorner* corners)
+{
+    size_t pos = c.posOffset, nrm = c.nrmOffset, uv = c.uvOffset;
+    ObjCorner* out = corners + c.triOffset * 3;
+
+    for (const char* p = c.begin; p < c.end; p = nextLine(p, c.end)) {
+        p = skipBlanks(p, c.end);
+        if (c.end - p < 2) continue;
+
+        if (p[0] == 'v') {
+            if (isBlank(p[1])) {
+                ++p;
+                glm::vec3& v = positions[pos++];
+                v.x = parseFloat(p, c.end);
+                v.y = parseFloat(p, c.end);
+                v.z = parseFloat(p, c.end);
+            } else if (p[1] == 'n') {
+                p += 2;
+                glm::vec3& n = normals[nrm++];
+                n.x = parseFloat(p, c.end);
+                n.y = parseFloat(p, c.end);
+                n.z = parseFloat(p, c.end);
+            } else if (p[1] == 't') {
+                p += 2;
+                glm::vec2& t = uvs[uv++];
+                t.x = parseFloat(p, c.end);
+                t.y = parseFloat(p, c.end);
+            }
+        } else if (p[0] == 'f' && isBlank(p[1])) {
+            if (countTokens(p + 1, c.end) < 3) continue;
+            ++p;
+
+            ObjCorner first{}, prev{};
+            for (uint32_t k = 0; ; ++k) {
+                p = skipBlanks(p, c.end);
+                if (p >= c.end || *p == '\n' || *p == '#') break;
+
+                ObjCorner corner{NO_INDEX, NO_INDEX, NO_INDEX};
+                corner.v = resolveIndex(parseInt(p, c.end), pos);
+                if (p < c.end && *p == '/') {
+                    ++p;
+                    if (p < c.end && *p != '/')
+                        corner.vt = resolveIndex(parseInt(p, c.end), uv);
+                    if (p < c.end && *p == '/') {
+                        ++p;
+                        corner.vn = resolveIndex(parseInt(p, c.end), nrm);
+                    }
+                }
+                while (p < c.end && !isBlank(*p) && *p != '\n') ++p;
+
+                if (k == 0) {
+                    first = corner;
+                } else if (k >= 2) {
+                    *out++ = first;
+                    *out++ = prev;
+                    *out++ = corner;
+                }
+                prev = corner;
+            }
+        }
+    }
+}
+
+void loadObj(const MappedFile& file, MeshData& mesh, uint32_t threads)
+{
+    const char*  data = file.data();
+    const size_t size = file.size();
+
+    // Chunks of at least 64 KiB, cut on line boundaries
+    const uint32_t chunkCount = static_cast<uint32_t>(
+        std::max<size_t>(1, std::min<size_t>(threads * 4, size / 65536)));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* begin = data;
+    for (uint32_t i = 0; i < chunkCount; ++i) {
+        const char* end = data + rangeBegin(size, chunkCount, i + 1);
+        if (i + 1 < chunkCount)
+            end = std::max(begin, nextLine(end, data + size));
+        chunks[i].begin = begin;
+        chunks[i].end   = end;
+        begin = end;
+    }
+
+    parallelFor(chunkCount, threads, [&](uint32_t i) { countObjChunk(chunks[i]); });
+
+    size_t positions = 0, normals = 0, uvs = 0, triangles = 0;
+    for (ObjChunk& c : chunks) {
+        c.posOffset = positions;  positions += c.positions;
+        c.nrmOffset = normals;    normals   += c.normals;
+        c.uvOffset  = uvs;        uvs       += c.uvs;
+        c.triOffset = triangles;  triangles += c.triangles;
+    }
+    if (positions >= NO_INDEX || triangles * 3 >= NO_INDEX)
+        throw std::runtime_error("OBJ: mesh exceeds 32-bit index range");
+
+    std::vector<glm::vec3> P(positions), N(normals);
+    std::vector<glm::vec2> T(uvs);
+    std::vector<ObjCorner> corners(triangles * 3);
+
+    parallelFor(chunkCount, threads, [&](uint32_t i) {
+        parseObjChunk(chunks[i], P.data(), N.data(), T.data(), corners.data());
+    });
+
+    // -----------------------------------------------------------------------
+    // Unify v/vt/vn into one index per corner. Attribute key 0 = none.
+    // -----------------------------------------------------------------------
+    constexpr uint64_t UNSET = ~0ull;
+    auto attrKey = [](const ObjCorner& c) {
+        return uint64_t(uint32_t(c.vt + 1)) << 32 | uint32_t(c.vn + 1);
+    };
+
+    std::vector<uint64_t>                        attr(positions, UNSET);
+    std::map<std::pair<uint32_t, uint64_t>, uint32_t> seams;
+    std::vector<ObjCorner>                       seamCorners;
+    bool missingNormals = false;
+
+    mesh.indices.resize(corners.size());
+    for (size_t i = 0; i < corners.size(); ++i) {
+        const ObjCorner& c = corners[i];
+        if (c.v >= positions || (c.vt != NO_INDEX && c.vt >= uvs)
+                             || (c.vn != NO_INDEX && c.vn >= normals))
+            throw std::runtime_error("OBJ: face index out of range");
+        missingNormals |= c.vn == NO_INDEX;
+
+        uint64_t  key = attrKey(c);
+        uint64_t& a   = attr[c.v];
+        if (a == UNSET || a == key) {
+            a               = key;
+            mesh.indices[i] = c.v;
+            continue;
+        }
+        auto found = seams.try_emplace({c.v, key},
+                                       static_cast<uint32_t>(positions + seamCorners.size()));
+        if (found.second)
+            seamCorners.push_back(c);
+        mesh.indices[i] = found.first->second;
+    }
+
+    // Vertices are split by (vt, vn), so each either has a file normal or none
+    mesh.vertices.resize(positions + seamCorners.size());
+    std::vector<uint8_t> hasNormal(missingNormals ? mesh.vertices.size() : 0);
+    auto fill = [&](size_t i, uint32_t v, uint32_t vt, uint32_t vn) {
+        Vertex& out = mesh.vertices[i];
+        out.pos    = P[v];
+        out.normal = vn != NO_INDEX ? N[vn] : glm::vec3(0.0f);
+        out.uv     = vt != NO_INDEX ? T[vt] : glm::vec2(0.0f);
+        if (missingNormals)
+            hasNormal[i] = vn != NO_INDEX;
+    };
+
+    const uint32_t parts = threads * 4;
+    parallelFor(parts, threads, [&](uint32_t part) {
+        size_t end = rangeBegin(mesh.vertices.size(), parts, part + 1);
+        for (size_t i = rangeBegin(mesh.vertices.size(), parts, part); i < end; ++i) {
+            if (i < positions) {
+                uint64_t key = attr[i] == UNSET ? 0 : attr[i];
+                fill(i, static_cast<uint32_t>(i),
+                     uint32_t(key >> 32) - 1, uint32_t(key) - 1);
+            } else {
+                const ObjCorner& c = seamCorners[i - positions];
+                fill(i, c.v, c.vt, c.vn);
+            }
+        }
+    });
+
+    // Only the corners without a vn get computed normals
+    if (missingNormals)
+        computeNormals(mesh, threads, &hasNormal);
+}
+
+// ---------------------------------------------------------------------------
+// Binary PLY
+//
+// The ASCII header is parsed serially. Vertex records have a fixed stride and
+// are decoded in parallel ranges. Face records are first assumed to be
+// triangles (fixed stride): a parallel pass checks every record's vertex
+// count, and only if all are 3 are the indices decoded in parallel. Otherwise
+// a serial scan locates every record and the general path decodes them.
+// ---------------------------------------------------------------------------
+
+enum class PlyType : uint8_t { I8, U8, I16, U16, I32, U32, F32, F64 };
+
+struct PlyProperty {
+    std::string name;
+    PlyType     type      = PlyType::F32;
+    bool        list      = false;
+    PlyType     countType = PlyType::U8;
+    size_t      offset    = 0;        // within the record, fixed-size elements only
+};
+
+struct PlyElement {
+    std::string              name;
+    size_t                   count = 0;
+    std::vector<PlyProperty> props;
+    size_t                   stride = 0;   // valid if !hasList
+    bool                     hasList = false;
+};
+
+size_t plySize(PlyType t)
+{
+    switch (t) {
+        case PlyType::I8:  case PlyType::U8:  return 1;
+        case PlyType::I16: case PlyType::U16: return 2;
+        case PlyType::I32: case PlyType::U32: case PlyType::F32: return 4;
+        case PlyType::F64: return 8;
+    }
+    return 0;
+}
+
+PlyType plyType(const std::string& s)
+{
+    if (s == "char"   || s == "int8")    return PlyType::I8;
+    if (s == "uchar"  || s == "uint8")   return PlyType::U8;
+    if (s == "short"  || s == "int16")   return PlyType::I16;
+    if (s == "ushort" || s == "uint16")  return PlyType::U16;
+    if (s == "int"    || s == "int32")   return PlyType::I32;
+    if (s == "uint"   || s == "uint32")  return PlyType::U32;
+    if (s == "float"  || s == "float32") return PlyType::F32;
+    if (s == "double" || s == "float64") return PlyType::F64;
+    throw std::runtime_error("PLY: unknown property type '" + s + "'");
+}
+
+template <typename T>
+inline T loadScalar(const char* p, bool swap)
+{
+    char b[sizeof(T)];
+    std::memcpy(b, p, sizeof(T));
+    if (swap) std::reverse(b, b + sizeof(T));
+    T v;
+    std::memcpy(&v, b, sizeof(T));
+    return v;
+}
+
+inline double plyRead(const char* p, PlyType t, bool swap)
+{
+    switch (t) {
+        case PlyType::I8:  return static_cast<int8_t>(*p);
+        case PlyType::U8:  return static_cast<uint8_t>(*p);
+        case PlyType::I16: return loadScalar<int16_t>(p, swap);
+        case PlyType::U16: return loadScalar<uint16_t>(p, swap);
+        case PlyType::I32: return loadScalar<int32_t>(p, swap);
+        case PlyType::U32: return loadScalar<uint32_t>(p, swap);
+        case PlyType::F32: return loadScalar<float>(p, swap);
+        case PlyType::F64: return loadScalar<double>(p, swap);
+    }
+    return 0.0;
+}
+
+// Size of one record of a list-bearing element, or 0 if it runs past `end`
+size_t plyRecordSize(const PlyElement& e, const char* rec, const char* end, bool swap)
+{
+    const char* p = rec;
+    for (const PlyProperty& prop : e.props) {
+        if (!prop.list) {
+            p += plySize(prop.type);
+        } else {
+            if (p + plySize(prop.countType) > end) return 0;
+            double n = plyRead(p, prop.countType, swap);
+            p += plySize(prop.countType) + static_cast<size_t>(n) * plySize(prop.type);
+        }
+        if (p > end) return 0;
+    }
+    return static_cast<size_t>(p - rec);
+}
+
+void loadPly(const MappedFile& file, MeshData& mesh, uint32_t threads)
+{
+    const char* data = file.data();
+    const char* end  = data + file.size();
+
+    // -----------------------------------------------------------------------
+    // Header
+    // -----------------------------------------------------------------------
+    const char* headerEnd = nullptr;
+    for (const char* p = data; p < end; p = nextLine(p, end)) {
+        if (end - p >= 10 && std::memcmp(p, "end_header", 10) == 0) {
+            headerEnd = nextLine(p, end);
+            break;
+        }
+    }
+    if (file.size() < 4 || std::memcmp(data, "ply", 3) != 0 || !headerEnd)
+        throw std::runtime_error("PLY: missing header");
+
+    bool swap = false;
+    std::vector<PlyElement> elements;
+    std::istringstream header(std::string(data, headerEnd));
+    for (std::string line; std::getline(header, line); ) {
+        std::istringstream ls(line);
+        std::string keyword;
+        ls >> keyword;
+        if (keyword == "format") {
+            std::string fmt;
+            ls >> fmt;
+            if (fmt == "ascii")
+                throw std::runtime_error("PLY: ASCII PLY is not supported, convert to binary");
+            const uint16_t one = 1;
+            const bool hostLittle = *reinterpret_cast<const uint8_t*>(&one) == 1;
+            swap = (fmt == "binary_big_endian") == hostLittle;
+        } else if (keyword == "element") {
+            PlyElement e;
+            ls >> e.name >> e.count;
+            elements.push_back(e);
+        } else if (keyword == "property") {
+            if (elements.empty())
+                throw std::runtime_error("PLY: property outside an element");
+            PlyElement& e = elements.back();
+            PlyProperty prop;
+            std::string type;
+            ls >> type;
+            if (type == "list") {
+                std::string countType, itemType;
+                ls >> countType >> itemType;
+                prop.list      = true;
+                prop.countType = plyType(countType);
+                prop.type      = plyType(itemType);
+                e.hasList      = true;
+            } else {
+                prop.type   = plyType(type);
+                prop.offset = e.stride;
+                e.stride   += plySize(prop.type);
+            }
+            ls >> prop.name;
+            e.props.push_back(prop);
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // Elements, in file order
+    // -----------------------------------------------------------------------
+    const char* p          = headerEnd;
+    bool        haveNormal = false;
+    size_t      vertexCount = 0;
+    bool        haveFaces  = false;
+
+    for (const PlyElement& e : elements) {
+        if (e.name == "vertex") {
+            if (e.hasList)
+                throw std::runtime_error("PLY: list properties on vertices are not supported");
+            if (p + e.count * e.stride > end)
+                throw std::runtime_error("PLY: vertex data truncated");
+
+            auto find = [&](std::initializer_list<const char*> names) -> const PlyProperty* {
+                for (const PlyProperty& prop : e.props)
+                    for (const char* n : names)
+                        if (prop.name == n) return &prop;
+                return nullptr;
+            };
+            const PlyProperty* px = find({"x"});
+            const PlyProperty* py = find({"y"});
+            const PlyProperty* pz = find({"z"});
+            const PlyProperty* nx = find({"nx"});
+            const PlyProperty* ny = find({"ny"});
+            const PlyProperty* nz = find({"nz"});
+            const PlyProperty* tu = find({"u", "s", "texture_u", "texture_s"});
+            const PlyProperty* tv = find({"v", "t", "texture_v", "texture_t"});
+            if (!px || !py || !pz)
+                throw std::runtime_error("PLY: vertex element has no x/y/z");
+            haveNormal = nx && ny && nz;
+
+            vertexCount = e.count;
+            mesh.vertices.resize(vertexCount);
+            const char*    base  = p;
+            const uint32_t parts = threads * 4;
+            parallelFor(parts, threads, [&](uint32_t part) {
+                size_t last = rangeBegin(vertexCount, parts, part + 1);
+                for (size_t i = rangeBegin(vertexCount, parts, part); i < last; ++i) {
+                    const char* rec = base + i * e.stride;
+                    auto get = [&](const PlyProperty* prop) {
+                        return static_cast<float>(plyRead(rec + prop->offset, prop->type, swap));
+                    };
+                    Vertex& v = mesh.vertices[i];
+                    v.pos    = {get(px), get(py), get(pz)};
+                    v.normal = haveNormal ? glm::vec3(get(nx), get(ny), get(nz)) : glm::vec3(0.0f);
+                    v.uv     = tu && tv ? glm::vec2(get(tu), get(tv)) : glm::vec2(0.0f);
+                }
+            });
+            p += e.count * e.stride;
+
+        } else if (e.name == "face") {
+            const PlyProperty* list = nullptr;
+            size_t listIndex = 0;
+            for (size_t k = 0; k < e.props.size(); ++k)
+                if (e.props[k].list && (e.props[k].name == "vertex_indices" ||
+                                        e.props[k].name == "vertex_index")) {
+                    list      = &e.props[k];
+                    listIndex = k;
+                }
+            if (!list)
+                throw std::runtime_error("PLY: face element has no vertex_indices list");
+
+            // Offset of the index list within a record whose earlier lists are skipped
+            auto listAt = [&](const char* rec) {
+                const char* q = rec;
+                for (size_t k = 0; k < listIndex; ++k) {
+                    const PlyProperty& prop = e.props[k];
+                    if (!prop.list) { q += plySize(prop.type); continue; }
+                    double n = plyRead(q, prop.countType, swap);
+                    q += plySize(prop.countType) + static_cast<size_t>(n) * plySize(prop.type);
+                }
+                return q;
+            };
+            const size_t countSize = plySize(list->countType);
+            const size_t itemSize  = plySize(list->type);
+
+            auto readIndex = [&](const char* q) {
+                double idx = plyRead(q, list->type, swap);
+                if (idx < 0.0 || idx >= static_cast<double>(vertexCount))
+                    throw std::runtime_error("PLY: face index out of range");
+                return static_cast<uint32_t>(idx);
+            };
+
+            // Fast path: every face a triangle, so every record has the same size
+            size_t triStride = countSize + 3 * itemSize;
+            bool   oneList   = true;
+            for (const PlyProperty& prop : e.props)
+                if (&prop != list) {
+                    if (prop.list) oneList = false;
+                    else triStride += plySize(prop.type);
+                }
+
+            // Past the first non-triangle, fixed-stride records are misaligned
+            // garbage, so nothing is decoded (and nothing can throw) until every
+            // vertex count has been confirmed; a mismatch just ends the pass
+            const char*       base  = p;
+            const uint32_t    parts = threads * 4;
+            std::atomic<bool> allTriangles{oneList && p + e.count * triStride <= end};
+            if (allTriangles) {
+                parallelFor(parts, threads, [&](uint32_t part) {
+                    size_t last = rangeBegin(e.count, parts, part + 1);
+                    for (size_t f = rangeBegin(e.count, parts, part); f < last && allTriangles; ++f)
+                        if (plyRead(listAt(base + f * triStride), list->countType, swap) != 3.0)
+                            allTriangles = false;
+                });
+            }
+            if (allTriangles) {
+                mesh.indices.resize(e.count * 3);
+                parallelFor(parts, threads, [&](uint32_t part) {
+                    size_t last = rangeBegin(e.count, parts, part + 1);
+                    for (size_t f = rangeBegin(e.count, parts, part); f < last; ++f) {
+                        const char* q = listAt(base + f * triStride) + countSize;
+                        for (int k = 0; k < 3; ++k)
+                            mesh.indices[f * 3 + k] = readIndex(q + k * itemSize);
+                    }
+                });
+            }
+
+            if (allTriangles) {
+                p += e.count * triStride;
+            } else {
+                // General path: serial scan for record offsets and triangle counts
+                std::vector<size_t> recOffset(e.count + 1), triOffset(e.count + 1);
+                const char* q = p;
+                size_t tris = 0;
+                for (size_t f = 0; f < e.count; ++f) {
+                    size_t bytes = plyRecordSize(e, q, end, swap);
+                    if (!bytes)
+                        throw std::runtime_error("PLY: face data truncated");
+                    size_t n = static_cast<size_t>(plyRead(listAt(q), list->countType, swap));
+                    recOffset[f] = static_cast<size_t>(q - p);
+                    triOffset[f] = tris;
+                    tris += n >= 3 ? n - 2 : 0;
+                    q    += bytes;
+                }
+                triOffset[e.count] = tris;
+
+                mesh.indices.resize(tris * 3);
+                parallelFor(parts, threads, [&](uint32_t part) {
+                    size_t last = rangeBegin(e.count, parts, part + 1);
+                    for (size_t f = rangeBegin(e.count, parts, part); f < last; ++f) {
+                        const char* r = listAt(base + recOffset[f]);
+                        size_t n = static_cast<size_t>(plyRead(r, list->countType, swap));
+                        r += countSize;
+                        uint32_t* out = &mesh.indices[triOffset[f] * 3];
+                        for (size_t k = 2; k < n; ++k) {
+                            *out++ = readIndex(r);
+                            *out++ = readIndex(r + (k - 1) * itemSize);
+                            *out++ = readIndex(r + k * itemSize);
+                        }
+                    }
+                });
+                p = q;
+            }
+            haveFaces = true;
+
+        } else if (!e.hasList) {
+            p += e.count * e.stride;
+        } else {
+            for (size_t i = 0; i < e.count; ++i) {
+                size_t bytes = plyRecordSize(e, p, end, swap);
+                if (!bytes)
+                    throw std::runtime_error("PLY: element '" + e.name + "' truncated");
+                p += bytes;
+            }
+        }
+        if (p > end)
+            throw std::runtime_error("PLY: element '" + e.name + "' truncated");
+        if (haveFaces && vertexCount)
+            break;
+    }
+
+    if (!haveFaces)
+        throw std::runtime_error("PLY: no face element (point clouds are not supported)");
+    if (!haveNormal)
+        computeNormals(mesh, threads);
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// loadMesh
+// ---------------------------------------------------------------------------
+
+MeshLoadStats loadMesh(const std::string& path, MeshData& mesh, uint32_t threadCount)
+{
+    CPU_ZONE("loadMesh");
+    auto t0 = std::chrono::steady_clock::now();
+
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (ext != ".obj" && ext != ".ply")
+        throw std::runtime_error("Unsupported mesh format '" + ext + "' (expected .obj or .ply)");
+
+    const uint32_t threads = threadCount ? threadCount
+                                         : std::max(1u, std::thread::hardware_concurrency());
+
+    MappedFile file;
+    file.open(path);
+
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    if (ext == ".obj")
+        loadObj(file, mesh, threads);
+    else
+        loadPly(file, mesh, threads);
+
+    if (mesh.indices.empty())
+        throw std::runtime_error(path + " contains no triangles");
+
+    MeshLoadStats stats;
+    stats.bytes     = file.size();
+    stats.threads   = threads;
+    stats.triangles = mesh.indices.size() / 3;
+    stats.seconds   = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - t0).count();
+
+    std::cout << "[MeshLoader] " << std::filesystem::path(path).filename().string() << ": "
+              << stats.triangles << " triangles, " << mesh.vertices.size() << " vertices, "
+              << stats.bytes / (1024.0 * 1024.0) << " MB in " << stats.seconds * 1000.0
+              << " ms (" << stats.mbPerSec() << " MB/s, " << threads << " threads)\n";
+    return stats;
+}
+
+void computeVertexNormals(MeshData& mesh, uint32_t threadCount)
+{
+    computeNormals(mesh, threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency()));
+}
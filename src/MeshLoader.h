@@ -0,0 +1,30 @@
+#pragma once
+#include "Scene.h"
+
+#include <cstdint>
+#include <string>
+
+// ---------------------------------------------------------------------------
+// MeshLoader — memory-mapped, multithreaded OBJ / binary PLY import
+//
+// The file is mapped rather than read, split into chunks that worker threads
+// parse concurrently, and decoded straight into pre-sized MeshData arrays.
+// Vertices the file gives no normal get area-weighted vertex normals.
+// ---------------------------------------------------------------------------
+
+struct MeshLoadStats {
+    size_t   bytes     = 0;
+    double   seconds   = 0.0;
+    uint32_t threads   = 0;
+    size_t   triangles = 0;
+
+    double mbPerSec() const { return seconds > 0.0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0; }
+};
+
+// Load a .obj or binary .ply file into `mesh` (vertices and indices). All
+// polygons are fan-triangulated.
+// Throws std::runtime_error on I/O or format errors.
+MeshLoadStats loadMesh(const std::string& path, MeshData& mesh, uint32_t threadCount = 0);
+
+// Replace the normals of an in-memory mesh with area-weighted vertex normals.
+void computeVertexNormals(MeshData& mesh, uint32_t threadCount = 0);
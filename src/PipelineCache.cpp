@@ -0,0 +1,193 @@
+#include "PipelineCache.h"
+#include "CpuProfiler.h"
+#include "Hash.h"
+#include "VulkanContext.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kCacheVersion  = 1;
+constexpr char     kCacheMagic[8] = {'R', 'T', 'P', 'C', 'A', 'C', 'H', 'E'};
+
+struct CacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t shaderKey;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint32_t _pad;
+    uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+    uint64_t dataHash;
+};
+
+// Why `hdr` + `data` cannot seed a cache on this device, or nullptr
+const char* rejectReason(const CacheHeader& hdr, const std::vector<char>& data,
+                         const VkPhysicalDeviceProperties& props, uint64_t shaderKey)
+{
+    if (std::memcmp(hdr.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 ||
+        hdr.headerSize != sizeof(CacheHeader))
+        return "not a pipeline cache";
+    if (hdr.version != kCacheVersion)
+        return "format version changed";
+    if (hdr.vendorID != props.vendorID || hdr.deviceID != props.deviceID ||
+        std::memcmp(hdr.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        return "different device";
+    if (hdr.driverVersion != props.driverVersion)
+        return "driver changed";
+    if (hdr.shaderKey != shaderKey)
+        return "shaders changed";
+    if (hdr.dataSize != data.size() || hashBytes(data.data(), data.size()) != hdr.dataHash)
+        return "corrupt";
+
+    // The driver's own header (VkPipelineCacheHeaderVersionOne) must agree too
+    VkPipelineCacheHeaderVersionOne vk{};
+    if (data.size() < sizeof(vk))
+        return "corrupt";
+    std::memcpy(&vk, data.data(), sizeof(vk));
+    if (vk.headerSize < sizeof(vk) || vk.headerSize > data.size() ||
+        vk.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        vk.vendorID != props.vendorID || vk.deviceID != props.deviceID ||
+        std::memcmp(vk.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        return "driver header mismatch";
+    return nullptr;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Load
+// ---------------------------------------------------------------------------
+
+void PipelineCache::load(VulkanContext& ctx, const std::string& cachePath, uint64_t key)
+{
+    CPU_ZONE("PipelineCache::load");
+    path       = cachePath;
+    shaderKey  = key;
+    warm       = false;
+    loadedHash = 0;
+
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(ctx.physicalDevice, &props);
+
+    std::vector<char> data;
+    std::ifstream     in(path, std::ios::binary | std::ios::ate);
+    if (!path.empty() && in) {
+        const uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+        CacheHeader    hdr{};
+        in.seekg(0);
+        if (fileSize >= sizeof(hdr) && in.read(reinterpret_cast<char*>(&hdr), sizeof(hdr))) {
+            data.resize(fileSize - sizeof(hdr));
+            in.read(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+
+        const char* reason = in ? rejectReason(hdr, data, props, shaderKey) : "truncated";
+        if (reason) {
+            std::cout << "[PipelineCache] Ignoring " << path << " (" << reason << ")\n";
+            data.clear();
+        } else {
+            loadedHash = hdr.dataHash;
+        }
+    }
+
+    VkPipelineCacheCreateInfo ci{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    ci.initialDataSize = data.size();
+    ci.pInitialData    = data.empty() ? nullptr : data.data();
+    if (vkCreatePipelineCache(ctx.device, &ci, nullptr, &cache) == VK_SUCCESS) {
+        warm = !data.empty();
+        return;
+    }
+
+    // Validated data the driver still refused: start over with an empty cache
+    std::cout << "[PipelineCache] Driver rejected " << path << "\n";
+    loadedHash         = 0;
+    ci.initialDataSize = 0;
+    ci.pInitialData    = nullptr;
+    if (vkCreatePipelineCache(ctx.device, &ci, nullptr, &cache) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create pipeline cache");
+}
+
+// ---------------------------------------------------------------------------
+// Save
+// ---------------------------------------------------------------------------
+
+bool PipelineCache::save(VulkanContext& ctx)
+{
+    CPU_ZONE("PipelineCache::save");
+    if (cache == VK_NULL_HANDLE || path.empty())
+        return true;
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(ctx.device, cache, &size, nullptr) != VK_SUCCESS || size == 0)
+        return true;
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(ctx.device, cache, &size, data.data()) != VK_SUCCESS)
+        return false;
+    data.resize(size);
+
+    const uint64_t dataHash = hashBytes(data.data(), data.size());
+    if (dataHash == loadedHash)
+        return true;   // what is on disk already
+
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(ctx.physicalDevice, &props);
+
+    CacheHeader hdr{};
+    std::memcpy(hdr.magic, kCacheMagic, sizeof(kCacheMagic));
+    hdr.version       = kCacheVersion;
+    hdr.headerSize    = sizeof(CacheHeader);
+    hdr.shaderKey     = shaderKey;
+    hdr.vendorID      = props.vendorID;
+    hdr.deviceID      = props.deviceID;
+    hdr.driverVersion = props.driverVersion;
+    std::memcpy(hdr.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+    hdr.dataSize      = data.size();
+    hdr.dataHash      = dataHash;
+
+    // Written next to the final file and renamed into place, so a reader never
+    // sees a partial cache
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[PipelineCache] Cannot write " << tmpPath << "\n";
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!out.flush()) {
+            out.close();
+            std::remove(tmpPath.c_str());
+            std::cerr << "[PipelineCache] Write to " << tmpPath << " failed\n";
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::remove(tmpPath.c_str());
+        std::cerr << "[PipelineCache] Cannot replace " << path << ": " << ec.message() << "\n";
+        return false;
+    }
+
+    loadedHash = dataHash;
+    std::cout << "[PipelineCache] Wrote " << data.size() / 1024.0 << " KB to " << path << "\n";
+    return true;
+}
+
+void PipelineCache::destroy(VulkanContext& ctx)
+{
+    if (cache != VK_NULL_HANDLE)
+        vkDestroyPipelineCache(ctx.device, cache, nullptr);
+    cache = VK_NULL_HANDLE;
+}
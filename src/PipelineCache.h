@@ -0,0 +1,39 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+class VulkanContext;
+
+// ---------------------------------------------------------------------------
+// PipelineCache — VkPipelineCache persisted to disk between runs
+//
+// The file is a small header followed by the driver's cache blob. The header
+// records what the blob is only valid for: the device (vendor / device ID,
+// pipelineCacheUUID), the driver version and a key over the SPIR-V the
+// pipelines were built from. load() checks all of them, the blob's own
+// Vulkan header and a hash of the blob before handing it to the driver, and
+// falls back to an empty cache on any mismatch. save() writes through a
+// temporary file and a rename, so a crash never leaves a torn cache behind.
+// ---------------------------------------------------------------------------
+
+class PipelineCache {
+public:
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    bool            warm  = false;   // load() accepted data from disk
+
+    // Create the cache, seeded from `path` if that holds a valid cache for
+    // this device, driver and `shaderKey`. An empty `path` gives an in-memory
+    // cache that is never saved.
+    void load(VulkanContext& ctx, const std::string& path, uint64_t shaderKey);
+    // Write the cache back to the path given to load() if it changed.
+    // Returns false on I/O errors.
+    bool save(VulkanContext& ctx);
+    void destroy(VulkanContext& ctx);
+
+private:
+    std::string path;
+    uint64_t    shaderKey  = 0;
+    uint64_t    loadedHash = 0;   // hash of the blob on disk, 0 = none; unchanged caches are not rewritten
+};
@@ -1,6 +1,10 @@
 #include "RTPipeline.h"
+#include "CpuProfiler.h"
+#include "Hash.h"
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstring>
 #include <stdexcept>
 #include <iostream>
@@ -9,8 +13,9 @@
 // build
 // ---------------------------------------------------------------------------
 
-void RTPipeline::build(VulkanContext& ctx, const std::string& shaderDir)
+void RTPipeline::build(VulkanContext& ctx, const Scene& scene)
 {
+    CPU_ZONE("RTPipeline::build");
     // -----------------------------------------------------------------------
     // Descriptor set layout
     //  Binding 0  ACCELERATION_STRUCTURE  — TLAS
@@ -18,8 +23,12 @@ void RTPipeline::build(VulkanContext& ctx, const std::string& shaderDir)
     //  Binding 2  UNIFORM_BUFFER          — CameraUBO
     //  Binding 3  STORAGE_BUFFER          — vertex buffer
     //  Binding 4  STORAGE_BUFFER          — index buffer
-    //  Binding 5  STORAGE_BUFFER          — material buffer
-    //  Binding 6  STORAGE_BUFFER          — per-instance data
+    //  Binding 5  STORAGE_BUFFER          — per-instance data
+    //  Binding 6  STORAGE_IMAGE           — rgba32f luminance moments (adaptive sampling)
+    //  Binding 7  STORAGE_IMAGE           — rgba32f first-hit normal + linear depth (AOV)
+    //  Binding 8  STORAGE_IMAGE           — rgba32f first-hit albedo (AOV)
+    //  Binding 9  STORAGE_IMAGE           — rgba32f first-hit instance / material ID (AOV)
+    // Materials travel in the hit records of the SBT instead (see buildSBT)
     // -----------------------------------------------------------------------
     const VkShaderStageFlags rtAll = VK_SHADER_STAGE_RAYGEN_BIT_KHR |
                                      VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR |
@@ -27,57 +36,96 @@ void RTPipeline::build(VulkanContext& ctx, const std::string& shaderDir)
     const VkShaderStageFlags hitOnly = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
     const VkShaderStageFlags rgenOnly = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
 
-    std::array<VkDescriptorSetLayoutBinding, 7> bindings{{
+    std::array<VkDescriptorSetLayoutBinding, 10> bindings{{
         {0, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1, rtAll,    nullptr},
         {1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,              1, rgenOnly, nullptr},
         {2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,             1, rgenOnly, nullptr},
         {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,             1, hitOnly,  nullptr},
         {4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,             1, hitOnly,  nullptr},
         {5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,             1, hitOnly,  nullptr},
-        {6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,             1, hitOnly,  nullptr},
+        {6, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,              1, rgenOnly, nullptr},
+        {7, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,              1, rgenOnly, nullptr},
+        {8, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,              1, rgenOnly, nullptr},
+        {9, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,              1, rgenOnly, nullptr},
     }};
 
+    // The AOV images are only created (and written into the set) when the
+    // shaders store to them; PARTIALLY_BOUND lets them stay empty otherwise
+    std::array<VkDescriptorBindingFlags, 10> bindingFlags{};
+    bindingFlags[7] = bindingFlags[8] = bindingFlags[9] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsCI{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+    flagsCI.bindingCount  = static_cast<uint32_t>(bindingFlags.size());
+    flagsCI.pBindingFlags = bindingFlags.data();
+
     VkDescriptorSetLayoutCreateInfo dslCI{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    dslCI.pNext        = &flagsCI;
     dslCI.bindingCount = static_cast<uint32_t>(bindings.size());
     dslCI.pBindings    = bindings.data();
     vkCreateDescriptorSetLayout(ctx.device, &dslCI, nullptr, &descriptorSetLayout);
 
     // -----------------------------------------------------------------------
-    // Pipeline layout — push constants available in raygen + closesthit
+    // Pipeline layout
     // -----------------------------------------------------------------------
-    VkPushConstantRange pcRange{};
-    pcRange.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
-    pcRange.size       = sizeof(PushConstants);
-
     VkPipelineLayoutCreateInfo layoutCI{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-    layoutCI.setLayoutCount         = 1;
-    layoutCI.pSetLayouts            = &descriptorSetLayout;
-    layoutCI.pushConstantRangeCount = 1;
-    layoutCI.pPushConstantRanges    = &pcRange;
+    layoutCI.setLayoutCount = 1;
+    layoutCI.pSetLayouts    = &descriptorSetLayout;
     vkCreatePipelineLayout(ctx.device, &layoutCI, nullptr, &pipelineLayout);
 
     // -----------------------------------------------------------------------
     // Shader stages
-    //  Stage index: 0=rgen  1=miss(sky)  2=miss(shadow)  3=chit
+    //  Stage index: 0=rgen  1=miss(sky)  2=miss(shadow)  3..5=chit per material type
     // -----------------------------------------------------------------------
-    VkShaderModule rgenMod   = ctx.loadShaderModule(shaderDir + "raygen.rgen.spv");
-    VkShaderModule missMod   = ctx.loadShaderModule(shaderDir + "miss.rmiss.spv");
-    VkShaderModule shadowMod = ctx.loadShaderModule(shaderDir + "shadow.rmiss.spv");
-    VkShaderModule chitMod   = ctx.loadShaderModule(shaderDir + "closesthit.rchit.spv");
+    // The AOV set carries the larger payload (WRITE_AOVS in common.glsl)
+    const std::array<const SpirvModule*, 6> spirv = writeAovs
+        ? std::array<const SpirvModule*, 6>{{
+              &spirvRaygenAov, &spirvMissAov, &spirvShadowMiss,
+              &spirvDiffuseHitAov, &spirvMetalHitAov, &spirvGlassHitAov}}
+        : std::array<const SpirvModule*, 6>{{
+              &spirvRaygen, &spirvMiss, &spirvShadowMiss,
+              &spirvDiffuseHit, &spirvMetalHit, &spirvGlassHit}};
+
+    // Cached pipelines are only reused for exactly this SPIR-V; the denoiser
+    // builds its compute pipeline into the same cache
+    uint64_t shaderKey = 0;
+    for (const SpirvModule* m : spirv)
+        shaderKey = hashBytes(m->code, m->bytes(), shaderKey);
+    shaderKey = hashBytes(spirvAtrous.code, spirvAtrous.bytes(), shaderKey);
+    cache.load(ctx, cacheFile, shaderKey);
+
+    std::array<VkShaderModule, 6> modules;
+    for (size_t i = 0; i < modules.size(); ++i)
+        modules[i] = ctx.createShaderModule(*spirv[i]);
+
+    // constant_id 0 = MAX_BOUNCES, 1 = WRITE_MOMENTS (both raygen; constants
+    // a stage does not declare are ignored)
+    const uint32_t specData[2] = {maxBounces, writeMoments ? VK_TRUE : VK_FALSE};
+    const std::array<VkSpecializationMapEntry, 2> specEntries{{
+        {0, 0,                sizeof(uint32_t)},
+        {1, sizeof(uint32_t), sizeof(VkBool32)},
+    }};
+    VkSpecializationInfo spec{};
+    spec.mapEntryCount = static_cast<uint32_t>(specEntries.size());
+    spec.pMapEntries   = specEntries.data();
+    spec.dataSize      = sizeof(specData);
+    spec.pData         = specData;
 
-    auto stageCI = [](VkShaderStageFlagBits stage, VkShaderModule mod) {
+    auto stageCI = [&spec](VkShaderStageFlagBits stage, VkShaderModule mod) {
         VkPipelineShaderStageCreateInfo s{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
-        s.stage  = stage;
-        s.module = mod;
-        s.pName  = "main";
+        s.stage               = stage;
+        s.module              = mod;
+        s.pName               = "main";
+        s.pSpecializationInfo = &spec;
         return s;
     };
 
-    std::array<VkPipelineShaderStageCreateInfo, 4> stages{{
-        stageCI(VK_SHADER_STAGE_RAYGEN_BIT_KHR,      rgenMod),
-        stageCI(VK_SHADER_STAGE_MISS_BIT_KHR,         missMod),
-        stageCI(VK_SHADER_STAGE_MISS_BIT_KHR,         shadowMod),
-        stageCI(VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,  chitMod),
+    std::array<VkPipelineShaderStageCreateInfo, 6> stages{{
+        stageCI(VK_SHADER_STAGE_RAYGEN_BIT_KHR,      modules[0]),
+        stageCI(VK_SHADER_STAGE_MISS_BIT_KHR,        modules[1]),
+        stageCI(VK_SHADER_STAGE_MISS_BIT_KHR,        modules[2]),
+        stageCI(VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, modules[3]),
+        stageCI(VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, modules[4]),
+        stageCI(VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, modules[5]),
     }};
 
     // -----------------------------------------------------------------------
@@ -85,7 +133,8 @@ void RTPipeline::build(VulkanContext& ctx, const std::string& shaderDir)
     //  Group 0: rgen  (general, uses stage 0)
     //  Group 1: miss  (general, uses stage 1)
     //  Group 2: shadow miss (general, uses stage 2)
-    //  Group 3: hit group (triangles, uses stage 3 as closestHit)
+    //  Group 3-5: hit groups (triangles, stages 3-5 as closestHit):
+    //             diffuse, metal, glass
     // -----------------------------------------------------------------------
     auto generalGroup = [](uint32_t stageIdx) {
         VkRayTracingShaderGroupCreateInfoKHR g{
@@ -98,19 +147,24 @@ void RTPipeline::build(VulkanContext& ctx, const std::string& shaderDir)
         return g;
     };
 
-    VkRayTracingShaderGroupCreateInfoKHR hitGroup{
-        VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR};
-    hitGroup.type               = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
-    hitGroup.generalShader      = VK_SHADER_UNUSED_KHR;
-    hitGroup.closestHitShader   = 3;
-    hitGroup.anyHitShader       = VK_SHADER_UNUSED_KHR;
-    hitGroup.intersectionShader = VK_SHADER_UNUSED_KHR;
+    auto hitGroup = [](uint32_t stageIdx) {
+        VkRayTracingShaderGroupCreateInfoKHR g{
+            VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR};
+        g.type               = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
+        g.generalShader      = VK_SHADER_UNUSED_KHR;
+        g.closestHitShader   = stageIdx;
+        g.anyHitShader       = VK_SHADER_UNUSED_KHR;
+        g.intersectionShader = VK_SHADER_UNUSED_KHR;
+        return g;
+    };
 
-    std::array<VkRayTracingShaderGroupCreateInfoKHR, 4> groups{{
+    std::array<VkRayTracingShaderGroupCreateInfoKHR, GROUP_COUNT> groups{{
         generalGroup(0),   // rgen
         generalGroup(1),   // miss sky
         generalGroup(2),   // miss shadow
-        hitGroup,
+        hitGroup(3),       // diffuse
+        hitGroup(4),       // metal
+        hitGroup(5),       // glass
     }};
 
     // -----------------------------------------------------------------------
@@ -125,18 +179,21 @@ void RTPipeline::build(VulkanContext& ctx, const std::string& shaderDir)
     pipeCI.maxPipelineRayRecursionDepth = 2; // primary + shadow
     pipeCI.layout                       = pipelineLayout;
 
+    auto t0 = std::chrono::steady_clock::now();
     if (ctx.rt.createRayTracingPipelines(
-            ctx.device, VK_NULL_HANDLE, VK_NULL_HANDLE,
+            ctx.device, VK_NULL_HANDLE, cache.cache,
             1, &pipeCI, nullptr, &pipeline) != VK_SUCCESS)
         throw std::runtime_error("Failed to create ray tracing pipeline");
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "[RTPipeline] Pipeline (" << maxBounces << " bounces) compiled in "
+              << ms << " ms ("
+              << (cache.warm ? "warm" : "cold") << " cache)\n";
 
     // Destroy shader modules — they're baked into the pipeline now
-    vkDestroyShaderModule(ctx.device, rgenMod,   nullptr);
-    vkDestroyShaderModule(ctx.device, missMod,   nullptr);
-    vkDestroyShaderModule(ctx.device, shadowMod, nullptr);
-    vkDestroyShaderModule(ctx.device, chitMod,   nullptr);
+    for (VkShaderModule mod : modules)
+        vkDestroyShaderModule(ctx.device, mod, nullptr);
 
-    buildSBT(ctx);
+    buildSBT(ctx, scene);
     std::cout << "[RTPipeline] Pipeline + SBT created\n";
 }
 
@@ -144,20 +201,29 @@ void RTPipeline::build(VulkanContext& ctx, const std::string& shaderDir)
 // buildSBT
 // ---------------------------------------------------------------------------
 
-void RTPipeline::buildSBT(VulkanContext& ctx)
+void RTPipeline::buildSBT(VulkanContext& ctx, const Scene& scene)
 {
+    CPU_ZONE("RTPipeline::buildSBT");
     const uint32_t handleSize      = ctx.rtPipelineProperties.shaderGroupHandleSize;
     const uint32_t handleAlign     = ctx.rtPipelineProperties.shaderGroupHandleAlignment;
     const uint32_t baseAlign       = ctx.rtPipelineProperties.shaderGroupBaseAlignment;
     const uint32_t handleSizeAlgn  = alignUp(handleSize, handleAlign);
 
+    // Hit records carry the material after the group handle; every TLAS
+    // instance points at its material's record through
+    // instanceShaderBindingTableRecordOffset (see AccelStructure)
+    const uint32_t hitStride   = alignUp(handleSize + sizeof(Material), handleAlign);
+    const uint32_t recordCount = static_cast<uint32_t>(scene.materials.size());
+    if (hitStride > ctx.rtPipelineProperties.maxShaderGroupStride)
+        throw std::runtime_error("Hit record exceeds maxShaderGroupStride");
+
     // Layout (each region starts at a multiple of baseAlign):
     //   [rgen region: 1 record, size = baseAlign]
     //   [miss region: 2 records (sky + shadow)]
-    //   [hit  region: 1 record]
+    //   [hit  region: 1 record per material, hit group by material type]
     const uint32_t rgenSize = baseAlign;
     const uint32_t missSize = alignUp(2 * handleSizeAlgn, baseAlign);
-    const uint32_t hitSize  = alignUp(1 * handleSizeAlgn, baseAlign);
+    const uint32_t hitSize  = alignUp(std::max(recordCount, 1u) * hitStride, baseAlign);
     const uint32_t totalSize = rgenSize + missSize + hitSize;
 
     // Retrieve all group handles from the driver
@@ -177,31 +243,29 @@ void RTPipeline::buildSBT(VulkanContext& ctx)
     copyHandle(sbt.data(),                                     GROUP_RGEN);
     copyHandle(sbt.data() + rgenSize + 0 * handleSizeAlgn,    GROUP_MISS_SKY);
     copyHandle(sbt.data() + rgenSize + 1 * handleSizeAlgn,    GROUP_MISS_SHADOW);
-    copyHandle(sbt.data() + rgenSize + missSize,               GROUP_HIT);
-
-    // Upload SBT to GPU
-    AllocatedBuffer staging = ctx.createBuffer(
-        totalSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VMA_MEMORY_USAGE_AUTO,
-        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-
-    void* mapped;
-    vmaMapMemory(ctx.allocator, staging.allocation, &mapped);
-    std::memcpy(mapped, sbt.data(), totalSize);
-    vmaUnmapMemory(ctx.allocator, staging.allocation);
 
+    uint32_t perGroup[GROUP_COUNT] = {};
+    for (uint32_t m = 0; m < recordCount; ++m) {
+        const Material& mat    = scene.materials[m];
+        uint8_t*        record = sbt.data() + rgenSize + missSize + m * hitStride;
+        uint32_t        group  = hitGroupFor(mat.type);
+        copyHandle(record, group);
+        std::memcpy(record + handleSize, &mat, sizeof(Material));
+        ++perGroup[group];
+    }
+    std::cout << "[RTPipeline] " << recordCount << " hit records: "
+              << perGroup[GROUP_HIT_DIFFUSE] << " diffuse, " << perGroup[GROUP_HIT_METAL]
+              << " metal, " << perGroup[GROUP_HIT_GLASS] << " glass\n";
+
+    // Upload SBT to GPU (queued on the staging arena, submitted with the
+    // next flush)
     sbtBuffer = ctx.createBuffer(
         totalSize,
         VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR |
         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT   |
         VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-
-    VkCommandBuffer cmd = ctx.beginSingleTimeCommands();
-    VkBufferCopy region{0, 0, totalSize};
-    vkCmdCopyBuffer(cmd, staging.buffer, sbtBuffer.buffer, 1, &region);
-    ctx.endSingleTimeCommands(cmd);
-    ctx.destroyBuffer(staging);
+    ctx.staging.upload(ctx, sbtBuffer.buffer, 0, sbt.data(), totalSize);
+    ctx.staging.flush(ctx);
 
     VkDeviceAddress base = sbtBuffer.address;
 
@@ -214,7 +278,7 @@ void RTPipeline::buildSBT(VulkanContext& ctx)
     missRegion.size          = missSize;
 
     hitRegion.deviceAddress  = base + rgenSize + missSize;
-    hitRegion.stride         = handleSizeAlgn;
+    hitRegion.stride         = hitStride;
     hitRegion.size           = hitSize;
 
     callRegion = {}; // no callable shaders
@@ -226,6 +290,8 @@ void RTPipeline::buildSBT(VulkanContext& ctx)
 
 void RTPipeline::destroy(VulkanContext& ctx)
 {
+    cache.save(ctx);
+    cache.destroy(ctx);
     ctx.destroyBuffer(sbtBuffer);
     if (pipeline       != VK_NULL_HANDLE) vkDestroyPipeline(ctx.device, pipeline, nullptr);
     if (pipelineLayout != VK_NULL_HANDLE) vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
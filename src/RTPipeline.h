@@ -1,5 +1,7 @@
 #pragma once
 #include "VulkanContext.h"
+#include "Scene.h"
+#include "PipelineCache.h"
 #include "types.h"
 #include <string>
 
@@ -16,19 +18,46 @@ public:
     VkStridedDeviceAddressRegionKHR hitRegion{};
     VkStridedDeviceAddressRegionKHR callRegion{};
 
-    // shaderDir must end with a path separator ('/')
-    void build  (VulkanContext& ctx, const std::string& shaderDir);
+    // Baked in by build(): path length and whether raygen keeps the
+    // per-pixel luminance moments (adaptive sampling and the denoiser need
+    // them) as specialization constants, and whether the shaders produce
+    // first-hit AOVs (Renderer's normal/depth, albedo and ID images; the
+    // denoiser needs them) by picking the SPIR-V built with the larger
+    // payload. Paths per dispatch are not: Renderer changes them frame to frame.
+    uint32_t maxBounces   = 4;
+    bool     writeAovs    = false;
+    bool     writeMoments = false;
+
+    // Pipeline cache file, loaded by build() and written back by destroy();
+    // empty = compile from scratch every run
+    std::string   cacheFile;
+    PipelineCache cache;
+
+    // One hit record per scene material: build after the scene and rebuild
+    // when its materials change
+    void build  (VulkanContext& ctx, const Scene& scene);
     void destroy(VulkanContext& ctx);
 
 private:
-    // Shader groups index: 0=rgen  1=miss(sky)  2=miss(shadow)  3=hitGroup
+    // Shader groups index: 0=rgen  1=miss(sky)  2=miss(shadow)
+    // 3..5 = hit group per material type (diffuse, metal, glass)
     static constexpr uint32_t GROUP_RGEN        = 0;
     static constexpr uint32_t GROUP_MISS_SKY    = 1;
     static constexpr uint32_t GROUP_MISS_SHADOW = 2;
-    static constexpr uint32_t GROUP_HIT         = 3;
-    static constexpr uint32_t GROUP_COUNT       = 4;
+    static constexpr uint32_t GROUP_HIT_DIFFUSE = 3;
+    static constexpr uint32_t GROUP_HIT_METAL   = 4;
+    static constexpr uint32_t GROUP_HIT_GLASS   = 5;
+    static constexpr uint32_t GROUP_COUNT       = 6;
+
+    // Material::type 0 = diffuse, 2 = glass, anything else shades as metal
+    static uint32_t hitGroupFor(int materialType)
+    {
+        return materialType == 0 ? GROUP_HIT_DIFFUSE
+             : materialType == 2 ? GROUP_HIT_GLASS
+                                 : GROUP_HIT_METAL;
+    }
 
-    void buildSBT(VulkanContext& ctx);
+    void buildSBT(VulkanContext& ctx, const Scene& scene);
 
     static uint32_t alignUp(uint32_t v, uint32_t a) { return (v + a - 1) & ~(a - 1); }
 };
@@ -1,11 +1,36 @@
 #include "Renderer.h"
+#include "CpuProfiler.h"
+#include "ImageIO.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
 #include <stdexcept>
 #include <cstring>
 
+namespace {
+
+// Same test as converged() in raygen.rgen, on a moments texel
+bool pixelConverged(const float* m, float threshold, uint32_t minSamples)
+{
+    if (threshold <= 0.0f || m[2] < float(minSamples))
+        return false;
+    float variance = std::max(m[1] - m[0] * m[0], 0.0f);
+    float stdError = std::sqrt(variance / m[2]);
+    return stdError <= threshold * std::max(m[0], 1e-2f);
+}
+
+// Weight of a new per-path GPU time in the controller's running estimate
+constexpr double kCostSmoothing = 0.25;
+// Render scale granularity, and how far a still view steps up per frame
+constexpr float  kRenderScaleStep = 1.0f / 16.0f;
+
+} // namespace
+
 // ---------------------------------------------------------------------------
 // init
 // ---------------------------------------------------------------------------
@@ -13,33 +38,78 @@
 void Renderer::init(VulkanContext& ctx, Scene& scene,
                     AccelStructure& accel, RTPipeline& pipe)
 {
-    createStorageImage(ctx);
+    CPU_ZONE("Renderer::init");
+    aovs = pipe.writeAovs;
+    createStorageImages(ctx);
     createDescriptorPool(ctx);
     createDescriptorSets(ctx, scene, accel, pipe);
     createCommandBuffers(ctx);
     createSyncObjects(ctx);
-
-    // Transition storage image to GENERAL layout for shader read/write
+    initFrameBudget(ctx);
+    frameSpp    = samplesPerFrame;
+    traceExtent = ctx.renderExtent;
+
+    // Transition storage images to GENERAL layout for shader read/write
+    std::vector<VkImage> images{storageImage.image, momentsImage.image};
+    if (aovs)
+        images.insert(images.end(), {normalDepthImage.image, albedoImage.image, idImage.image});
     VkCommandBuffer cmd = ctx.beginSingleTimeCommands();
-    imageBarrier(cmd, storageImage.image,
-        VK_IMAGE_LAYOUT_UNDEFINED,       VK_IMAGE_LAYOUT_GENERAL,
-        0,                               VK_ACCESS_SHADER_WRITE_BIT,
-        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
+    for (VkImage image : images)
+        imageBarrier(cmd, image,
+            VK_IMAGE_LAYOUT_UNDEFINED,       VK_IMAGE_LAYOUT_GENERAL,
+            0,                               VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
     ctx.endSingleTimeCommands(cmd);
+
+    if ((adaptiveThreshold > 0.0f || denoiser.enabled()) && !pipe.writeMoments)
+        throw std::runtime_error("Adaptive sampling and the denoiser need an RT pipeline "
+                                 "built with writeMoments");
+    if (denoiser.enabled()) {
+        if (!aovs)
+            throw std::runtime_error("Denoiser needs an RT pipeline built with writeAovs");
+        denoiser.init(ctx, pipe.cache.cache, storageImage, momentsImage,
+                      normalDepthImage, albedoImage);
+        std::cout << "[Renderer] Denoising with " << denoiser.iterations << " a-trous passes\n";
+    }
 }
 
 // ---------------------------------------------------------------------------
-// createStorageImage
+// createStorageImages
 // ---------------------------------------------------------------------------
 
-void Renderer::createStorageImage(VulkanContext& ctx)
+void Renderer::createStorageImages(VulkanContext& ctx)
 {
     storageImage = ctx.createImage(
-        ctx.swapchainExtent.width,
-        ctx.swapchainExtent.height,
+        ctx.renderExtent.width,
+        ctx.renderExtent.height,
         VK_FORMAT_R32G32B32A32_SFLOAT,
         VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+    // rgba32f rather than rg/rgb: it is the one float storage format every
+    // device supports without shaderStorageImageExtendedFormats
+    momentsImage = ctx.createImage(
+        ctx.renderExtent.width,
+        ctx.renderExtent.height,
+        VK_FORMAT_R32G32B32A32_SFLOAT,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+    // The AOVs exist only when the shaders write them; otherwise bindings 7-9
+    // stay unwritten (PARTIALLY_BOUND, see RTPipeline). IDs are stored as
+    // floats too (exact up to 2^24) so one readback path serves all.
+    if (aovs) {
+        for (AllocatedImage* img : {&normalDepthImage, &albedoImage, &idImage})
+            *img = ctx.createImage(ctx.renderExtent.width, ctx.renderExtent.height,
+                                   VK_FORMAT_R32G32B32A32_SFLOAT,
+                                   VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    }
+
+    // Blits from a reduced-resolution trace filter linearly where the
+    // device can; float32 formats do not guarantee it
+    VkFormatProperties fp{};
+    vkGetPhysicalDeviceFormatProperties(ctx.physicalDevice, VK_FORMAT_R32G32B32A32_SFLOAT, &fp);
+    upscaleFilter = (fp.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)
+                  ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
 }
 
 // ---------------------------------------------------------------------------
@@ -48,17 +118,18 @@ void Renderer::createStorageImage(VulkanContext& ctx)
 
 void Renderer::createDescriptorPool(VulkanContext& ctx)
 {
+    const uint32_t frames = ctx.framesInFlight;
     std::array<VkDescriptorPoolSize, 4> poolSizes{{
-        {VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, MAX_FRAMES_IN_FLIGHT},
-        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,              MAX_FRAMES_IN_FLIGHT},
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,             MAX_FRAMES_IN_FLIGHT},
-        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  4 * MAX_FRAMES_IN_FLIGHT},
+        {VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, frames},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, (aovs ? 5 : 2) * frames},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,             frames},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  3 * frames},
     }};
 
     VkDescriptorPoolCreateInfo pi{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
     pi.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     pi.pPoolSizes    = poolSizes.data();
-    pi.maxSets       = MAX_FRAMES_IN_FLIGHT;
+    pi.maxSets       = frames;
     vkCreateDescriptorPool(ctx.device, &pi, nullptr, &descriptorPool);
 }
 
@@ -69,8 +140,12 @@ void Renderer::createDescriptorPool(VulkanContext& ctx)
 void Renderer::createDescriptorSets(VulkanContext& ctx, Scene& scene,
                                      AccelStructure& accel, RTPipeline& pipe)
 {
+    const uint32_t frames = ctx.framesInFlight;
+
     // Camera UBOs (persistently mapped, updated each frame)
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    cameraUBOs.resize(frames);
+    cameraUBOMapped.resize(frames);
+    for (uint32_t i = 0; i < frames; ++i) {
         cameraUBOs[i] = ctx.createBuffer(
             sizeof(CameraUBO),
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
@@ -84,17 +159,17 @@ void Renderer::createDescriptorSets(VulkanContext& ctx, Scene& scene,
     }
 
     // Allocate descriptor sets
-    std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
-    layouts.fill(pipe.descriptorSetLayout);
+    std::vector<VkDescriptorSetLayout> layouts(frames, pipe.descriptorSetLayout);
+    descriptorSets.resize(frames);
 
     VkDescriptorSetAllocateInfo ai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
     ai.descriptorPool     = descriptorPool;
-    ai.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+    ai.descriptorSetCount = frames;
     ai.pSetLayouts        = layouts.data();
     vkAllocateDescriptorSets(ctx.device, &ai, descriptorSets.data());
 
     // Write descriptors for each in-flight frame
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    for (uint32_t i = 0; i < frames; ++i) {
         // Binding 0: TLAS
         VkWriteDescriptorSetAccelerationStructureKHR tlasInfo{
             VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR};
@@ -106,16 +181,31 @@ void Renderer::createDescriptorSets(VulkanContext& ctx, Scene& scene,
         imgInfo.imageView   = storageImage.view;
         imgInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 
+        // Binding 6: luminance moments
+        VkDescriptorImageInfo momentsInfo{};
+        momentsInfo.imageView   = momentsImage.view;
+        momentsInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        // Bindings 7-9: first-hit AOVs
+        VkDescriptorImageInfo normalDepthInfo{};
+        normalDepthInfo.imageView   = normalDepthImage.view;
+        normalDepthInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        VkDescriptorImageInfo albedoInfo{};
+        albedoInfo.imageView   = albedoImage.view;
+        albedoInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        VkDescriptorImageInfo idInfo{};
+        idInfo.imageView   = idImage.view;
+        idInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
         // Binding 2: camera UBO
         VkDescriptorBufferInfo camInfo{cameraUBOs[i].buffer, 0, sizeof(CameraUBO)};
 
-        // Bindings 3-6: geometry / material buffers
+        // Bindings 3-5: geometry / instance buffers
         VkDescriptorBufferInfo vtxInfo {scene.vertexBuffer.buffer,       0, VK_WHOLE_SIZE};
         VkDescriptorBufferInfo idxInfo {scene.indexBuffer.buffer,        0, VK_WHOLE_SIZE};
-        VkDescriptorBufferInfo matInfo {scene.materialBuffer.buffer,     0, VK_WHOLE_SIZE};
         VkDescriptorBufferInfo instInfo{scene.instanceDataBuffer.buffer, 0, VK_WHOLE_SIZE};
 
-        std::array<VkWriteDescriptorSet, 7> writes{};
+        std::array<VkWriteDescriptorSet, 10> writes{};
 
         writes[0] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
         writes[0].pNext           = &tlasInfo;
@@ -149,11 +239,27 @@ void Renderer::createDescriptorSets(VulkanContext& ctx, Scene& scene,
         };
         writes[3] = makeSsbo(3, &vtxInfo);
         writes[4] = makeSsbo(4, &idxInfo);
-        writes[5] = makeSsbo(5, &matInfo);
-        writes[6] = makeSsbo(6, &instInfo);
+        writes[5] = makeSsbo(5, &instInfo);
+
+        writes[6] = writes[1];
+        writes[6].dstBinding      = 6;
+        writes[6].pImageInfo      = &momentsInfo;
 
-        vkUpdateDescriptorSets(ctx.device,
-            static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        writes[7] = writes[1];
+        writes[7].dstBinding      = 7;
+        writes[7].pImageInfo      = &normalDepthInfo;
+
+        writes[8] = writes[1];
+        writes[8].dstBinding      = 8;
+        writes[8].pImageInfo      = &albedoInfo;
+
+        writes[9] = writes[1];
+        writes[9].dstBinding      = 9;
+        writes[9].pImageInfo      = &idInfo;
+
+        // Without AOVs the last three writes (bindings 7-9) are left out
+        const uint32_t writeCount = aovs ? static_cast<uint32_t>(writes.size()) : 7;
+        vkUpdateDescriptorSets(ctx.device, writeCount, writes.data(), 0, nullptr);
     }
 }
 
@@ -163,34 +269,62 @@ void Renderer::createDescriptorSets(VulkanContext& ctx, Scene& scene,
 
 void Renderer::createCommandBuffers(VulkanContext& ctx)
 {
+    commandBuffers.resize(ctx.framesInFlight);
+
     VkCommandBufferAllocateInfo ai{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
     ai.commandPool        = ctx.commandPool;
     ai.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    ai.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+    ai.commandBufferCount = ctx.framesInFlight;
     vkAllocateCommandBuffers(ctx.device, &ai, commandBuffers.data());
 }
 
 void Renderer::createSyncObjects(VulkanContext& ctx)
 {
+    // CPU/GPU pacing runs on ctx.graphicsTimeline; only the swapchain needs
+    // binary semaphores
     VkSemaphoreCreateInfo si{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
-    VkFenceCreateInfo     fi{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-    fi.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        vkCreateSemaphore(ctx.device, &si, nullptr, &imageAvailableSems[i]);
-        vkCreateFence    (ctx.device, &fi, nullptr, &inFlightFences[i]);
-    }
+    frameTimeline.assign(ctx.framesInFlight, 0);
+    imageAvailableSems.resize(ctx.framesInFlight);
+    for (VkSemaphore& sem : imageAvailableSems)
+        vkCreateSemaphore(ctx.device, &si, nullptr, &sem);
 
     // One render-finished semaphore per swapchain image so the presentation
     // engine's consume of the semaphore cannot race with a re-signal from a
     // subsequent frame that happens to land on the same frame-in-flight slot.
     uint32_t imgCount = static_cast<uint32_t>(ctx.swapchainImages.size());
     renderFinishedSems.resize(imgCount);
-    imagesInFlight.assign(imgCount, VK_NULL_HANDLE);
+    imageTimeline.assign(imgCount, 0);
     for (uint32_t i = 0; i < imgCount; ++i)
         vkCreateSemaphore(ctx.device, &si, nullptr, &renderFinishedSems[i]);
 }
 
+// ---------------------------------------------------------------------------
+// initFrameBudget — the samples-per-frame controller reads GpuProfiler
+// ---------------------------------------------------------------------------
+
+void Renderer::initFrameBudget(VulkanContext& ctx)
+{
+    slotSpp.assign(ctx.framesInFlight, 0);
+    slotScale.assign(ctx.framesInFlight, 1.0f);
+    if (frameBudgetMs <= 0.0f)
+        return;
+
+    // The profiler turns itself off when the graphics queue has no timestamps
+    if (!ctx.profiler.enabled) {
+        std::cout << "[Renderer] No GPU timings; samples per frame stay at "
+                  << samplesPerFrame << "\n";
+        return;
+    }
+    budgetActive = true;
+
+    std::cout << "[Renderer] Samples per frame follow a " << frameBudgetMs << " ms frame budget ("
+              << (stillBudgetMs > 0.0f ? stillBudgetMs : frameBudgetMs) << " ms while still)\n";
+    if (minRenderScale < 1.0f)
+        std::cout << "[Renderer] Render scale down to " << minRenderScale << " while moving ("
+                  << (upscaleFilter == VK_FILTER_LINEAR ? "linear" : "nearest") << " upscale)\n";
+}
+
 // ---------------------------------------------------------------------------
 // imageBarrier helper
 // ---------------------------------------------------------------------------
@@ -214,45 +348,157 @@ void Renderer::imageBarrier(VkCommandBuffer cmd, VkImage image,
                          0, nullptr, 0, nullptr, 1, &b);
 }
 
+// ---------------------------------------------------------------------------
+// updateCamera / recordTrace — shared by the windowed and headless paths
+// ---------------------------------------------------------------------------
+
+void Renderer::updateCamera(int f, Scene& scene, float aspect)
+{
+    CameraUBO cam{};
+    cam.invView           = glm::inverse(scene.camera.getView());
+    cam.invProj           = glm::inverse(scene.camera.getProj(aspect));
+    cam.sampleCount       = sampleCount;
+    cam.frameIndex        = currentFrame;
+    cam.varianceThreshold = adaptiveThreshold;
+    cam.minSamples        = adaptiveMinSamples;
+    cam.samplesPerFrame   = frameSpp;
+    cam.pathCount         = pathCount;
+    std::memcpy(cameraUBOMapped[f], &cam, sizeof(CameraUBO));
+}
+
+// Timings come from the profiler's "frame" scope, collected without waiting
+// once a frame's timeline value has passed. Frame time is close to linear in the
+// paths traced and so in the pixels traced: the cost is kept per path per
+// native-resolution pixel, and a frame at scale s costs s^2 of that.
+//
+// A moving view picks the largest scale (in kRenderScaleStep steps, at
+// least minRenderScale) at which one path per pixel fits the budget; a still
+// view steps back up to native. The path count is then the budget over the
+// cost of one path at that scale. Counts drop at once when over budget (the
+// camera just started moving) but at most double per frame on the way up,
+// so one fast outlier cannot push a frame far past the budget.
+bool Renderer::updateFrameBudget(VulkanContext& ctx, bool still)
+{
+    if (!budgetActive) {
+        frameSpp = samplesPerFrame;
+        return false;
+    }
+
+    // Only the newest frame is folded in; a slot's entries are not
+    // overwritten until its frame has been collected
+    GpuProfiler::Sample sample;
+    if (ctx.profiler.latest("frame", sample) && sample.count != framesTimed) {
+        framesTimed = sample.count;
+        const uint32_t slot = static_cast<uint32_t>(sample.tag);
+        if (slotSpp[slot] != 0) {
+            double scale = slotScale[slot];
+            double cost  = sample.ms / (slotSpp[slot] * scale * scale);
+            msPerPath    = msPerPath > 0.0 ? msPerPath + kCostSmoothing * (cost - msPerPath) : cost;
+        }
+    }
+    if (msPerPath <= 0.0)
+        return false;   // nothing measured yet
+
+    const float budget   = still && stillBudgetMs > 0.0f ? stillBudgetMs : frameBudgetMs;
+    const float oldScale = renderScale;
+    if (still || minRenderScale >= 1.0f) {
+        renderScale = std::min(renderScale + kRenderScaleStep, 1.0f);
+    } else {
+        float fit   = std::floor(float(std::sqrt(budget / msPerPath)) / kRenderScaleStep) * kRenderScaleStep;
+        renderScale = std::clamp(fit, minRenderScale, 1.0f);
+    }
+
+    const double pathMs = msPerPath * renderScale * renderScale;
+    const double target = std::floor(budget / pathMs);
+    const double upper  = std::min<double>(maxSamplesPerFrame, 2.0 * frameSpp);
+    frameSpp = static_cast<uint32_t>(std::clamp(target, 1.0, std::max(upper, 1.0)));
+    return renderScale != oldScale;
+}
+
+void Renderer::recordTrace(VkCommandBuffer cmd, int f,
+                           VulkanContext& ctx, RTPipeline& pipe)
+{
+    GpuScope scope(ctx.profiler, cmd, "trace");
+
+    // The previous dispatch's accumulation and moments writes must land
+    // before this one reads them back for the running averages, and the
+    // previous denoise must be done reading them before they change
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd,
+        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipe.pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+        pipe.pipelineLayout, 0, 1, &descriptorSets[f], 0, nullptr);
+
+    // Trace rays into the storage image
+    ctx.rt.cmdTraceRays(cmd,
+        &pipe.rgenRegion, &pipe.missRegion,
+        &pipe.hitRegion,  &pipe.callRegion,
+        traceExtent.width,
+        traceExtent.height,
+        1);
+}
+
 // ---------------------------------------------------------------------------
 // drawFrame
 // ---------------------------------------------------------------------------
 
 void Renderer::drawFrame(VulkanContext& ctx, Scene& scene,
-                          AccelStructure& /*accel*/, RTPipeline& pipe,
+                          AccelStructure& accel, RTPipeline& pipe,
                           float aspect)
 {
+    CPU_ZONE("Renderer::drawFrame");
     int f = static_cast<int>(currentFrame);
 
-    vkWaitForFences(ctx.device, 1, &inFlightFences[f], VK_TRUE, UINT64_MAX);
+    // This slot's previous frame must be done with its command buffer, UBO
+    // and acquire semaphore
+    {
+        CPU_ZONE("wait frame slot");
+        ctx.waitGraphics(frameTimeline[f]);
+    }
 
     uint32_t imageIndex;
-    VkResult res = vkAcquireNextImageKHR(ctx.device, ctx.swapchain,
-                                          UINT64_MAX, imageAvailableSems[f],
-                                          VK_NULL_HANDLE, &imageIndex);
+    VkResult res;
+    {
+        CPU_ZONE("acquire image");
+        res = vkAcquireNextImageKHR(ctx.device, ctx.swapchain,
+                                    UINT64_MAX, imageAvailableSems[f],
+                                    VK_NULL_HANDLE, &imageIndex);
+    }
     if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR) return;
 
     // If a previous frame is still using this swapchain image, wait for it.
     // This prevents re-signalling renderFinishedSems[imageIndex] while the
     // presentation engine may still be consuming it from the previous present.
-    if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
-        vkWaitForFences(ctx.device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
-    imagesInFlight[imageIndex] = inFlightFences[f];
-
-    vkResetFences(ctx.device, 1, &inFlightFences[f]);
-
-    // ---- Update camera UBO ------------------------------------------------
-    CameraUBO cam{};
-    cam.invView     = glm::inverse(scene.camera.getView());
-    cam.invProj     = glm::inverse(scene.camera.getProj(aspect));
-    cam.sampleCount = sampleCount;
-    cam.frameIndex  = currentFrame;
-    std::memcpy(cameraUBOMapped[f], &cam, sizeof(CameraUBO));
+    {
+        CPU_ZONE("wait swapchain image");
+        ctx.waitGraphics(imageTimeline[imageIndex]);
+    }
 
-    if (scene.camera.moved)
+    // ---- Frame budget, accumulation reset, camera UBO ----------------------
+    // Timings of frames that have completed since (at least this slot's)
+    ctx.profiler.collect(ctx);
+
+    // Motion or a new render scale restarts accumulation in this very frame
+    const bool still    = !scene.camera.moved && !scene.instancesMoved;
+    const bool rescaled = updateFrameBudget(ctx, still);
+    traceExtent = {
+        std::max(1u, static_cast<uint32_t>(std::lround(ctx.renderExtent.width  * renderScale))),
+        std::max(1u, static_cast<uint32_t>(std::lround(ctx.renderExtent.height * renderScale))),
+    };
+    if (!still || rescaled) {
         sampleCount = 0;
-    else
-        ++sampleCount;
+        pathCount   = 0;
+    }
+
+    updateCamera(f, scene, aspect);
+    ++sampleCount;
+    pathCount += frameSpp;
 
     // ---- Record command buffer --------------------------------------------
     VkCommandBuffer cmd = commandBuffers[f];
@@ -261,75 +507,84 @@ void Renderer::drawFrame(VulkanContext& ctx, Scene& scene,
     VkCommandBufferBeginInfo bi{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
     vkBeginCommandBuffer(cmd, &bi);
 
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipe.pipeline);
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
-        pipe.pipelineLayout, 0, 1, &descriptorSets[f], 0, nullptr);
+    ctx.profiler.open(cmd, ctx.graphicsQueueFamily);
+    uint32_t frameScope = ctx.profiler.begin(cmd, "frame", static_cast<uint64_t>(f));
+    slotSpp[f]   = frameSpp;
+    slotScale[f] = renderScale;
 
-    PushConstants pc{4, 1}; // 4 max bounces, 1 sample per frame
-    vkCmdPushConstants(cmd, pipe.pipelineLayout,
-        VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
-        0, sizeof(PushConstants), &pc);
+    // Streamed uploads: the trace waits only for the transfers it consumes
+    uint64_t uploadValue = ctx.staging.acquire(ctx, cmd);
 
-    // Trace rays into the storage image
-    ctx.rt.cmdTraceRays(cmd,
-        &pipe.rgenRegion, &pipe.missRegion,
-        &pipe.hitRegion,  &pipe.callRegion,
-        ctx.swapchainExtent.width,
-        ctx.swapchainExtent.height,
-        1);
+    // ---- Animated instances: refit the TLAS ahead of the trace -------------
+    if (scene.instancesMoved) {
+        accel.updateTLAS(cmd, currentFrame, ctx, scene);
+        scene.instancesMoved = false;
+    }
+
+    recordTrace(cmd, f, ctx, pipe);
 
-    // ---- Copy storage image → swapchain image ----------------------------
-    VkImage swapImg = ctx.swapchainImages[imageIndex];
+    // ---- Denoise into the display image -----------------------------------
+    if (denoiser.enabled())
+        denoiser.record(cmd, ctx, traceExtent);
 
-    imageBarrier(cmd, storageImage.image,
+    // ---- Copy display image → swapchain image ----------------------------
+    const VkImage shown = displayImage().image;
+    const VkPipelineStageFlags shownStage = denoiser.enabled()
+        ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+    VkImage  swapImg   = ctx.swapchainImages[imageIndex];
+    uint32_t blitScope = ctx.profiler.begin(cmd, "blit");
+
+    imageBarrier(cmd, shown,
         VK_IMAGE_LAYOUT_GENERAL,              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
         VK_ACCESS_SHADER_WRITE_BIT,           VK_ACCESS_TRANSFER_READ_BIT,
-        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        shownStage,                           VK_PIPELINE_STAGE_TRANSFER_BIT);
 
     imageBarrier(cmd, swapImg,
         VK_IMAGE_LAYOUT_UNDEFINED,            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         0,                                    VK_ACCESS_TRANSFER_WRITE_BIT,
         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,    VK_PIPELINE_STAGE_TRANSFER_BIT);
 
-    // Blit with NEAREST (storage image and swapchain are the same resolution)
+    // The traced region fills the swapchain: 1:1 with NEAREST at native
+    // resolution, upscaled (LINEAR where supported) at a reduced render scale
+    const bool native = traceExtent.width  == ctx.swapchainExtent.width &&
+                        traceExtent.height == ctx.swapchainExtent.height;
     VkImageBlit blit{};
     blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
-    blit.srcOffsets[1]  = {(int32_t)ctx.swapchainExtent.width,
-                           (int32_t)ctx.swapchainExtent.height, 1};
+    blit.srcOffsets[1]  = {(int32_t)traceExtent.width,
+                           (int32_t)traceExtent.height, 1};
     blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
     blit.dstOffsets[1]  = {(int32_t)ctx.swapchainExtent.width,
                            (int32_t)ctx.swapchainExtent.height, 1};
 
     vkCmdBlitImage(cmd,
-        storageImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        swapImg,            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1, &blit, VK_FILTER_NEAREST);
+        shown,   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        swapImg, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1, &blit, native ? VK_FILTER_NEAREST : upscaleFilter);
 
-    // Restore storage image to GENERAL for the next frame
-    imageBarrier(cmd, storageImage.image,
+    // Restore the display image to GENERAL for the next frame
+    imageBarrier(cmd, shown,
         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
         VK_ACCESS_TRANSFER_READ_BIT,          VK_ACCESS_SHADER_WRITE_BIT,
-        VK_PIPELINE_STAGE_TRANSFER_BIT,
-        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
+        VK_PIPELINE_STAGE_TRANSFER_BIT,       shownStage);
 
     imageBarrier(cmd, swapImg,
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
         VK_ACCESS_TRANSFER_WRITE_BIT,         0,
         VK_PIPELINE_STAGE_TRANSFER_BIT,       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
 
+    ctx.profiler.end(cmd, blitScope);
+    ctx.profiler.end(cmd, frameScope);
     vkEndCommandBuffer(cmd);
 
     // ---- Submit -----------------------------------------------------------
-    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
-    VkSubmitInfo si{VK_STRUCTURE_TYPE_SUBMIT_INFO};
-    si.waitSemaphoreCount   = 1;
-    si.pWaitSemaphores      = &imageAvailableSems[f];
-    si.pWaitDstStageMask    = &waitStage;
-    si.commandBufferCount   = 1;
-    si.pCommandBuffers      = &cmd;
-    si.signalSemaphoreCount = 1;
-    si.pSignalSemaphores    = &renderFinishedSems[imageIndex];
-    vkQueueSubmit(ctx.graphicsQueue, 1, &si, inFlightFences[f]);
+    // The upload wait is only added when acquire() returned something
+    VulkanContext::SemaphoreWait waits[2] = {
+        {imageAvailableSems[f],    0,           VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR},
+        {ctx.staging.semaphore(),  uploadValue, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT},
+    };
+    uint64_t value = ctx.submitGraphics(&cmd, 1, waits, uploadValue != 0 ? 2 : 1,
+                                        renderFinishedSems[imageIndex]);
+    frameTimeline[f] = imageTimeline[imageIndex] = value;
 
     // ---- Present ----------------------------------------------------------
     VkPresentInfoKHR pi{VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
@@ -340,7 +595,204 @@ void Renderer::drawFrame(VulkanContext& ctx, Scene& scene,
     pi.pImageIndices      = &imageIndex;
     vkQueuePresentKHR(ctx.graphicsQueue, &pi);
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % ctx.framesInFlight;
+}
+
+// ---------------------------------------------------------------------------
+// renderOffscreen — headless fixed-sample accumulation
+// ---------------------------------------------------------------------------
+
+void Renderer::renderOffscreen(VulkanContext& ctx, Scene& scene, RTPipeline& pipe,
+                               float aspect, uint32_t samples)
+{
+    CPU_ZONE("Renderer::renderOffscreen");
+    auto t0 = std::chrono::steady_clock::now();
+
+    // One submission per dispatch so every dispatch sees its own sampleCount
+    // in the camera UBO; the frame slots keep the queue fed without any
+    // swapchain acquire/present in between. Each dispatch traces
+    // samplesPerFrame paths per pixel, the last one whatever is left.
+    // With adaptive sampling `samples` is a cap: every kConvergenceCheck
+    // dispatches past the minimum the moments are read back, and the render
+    // ends early once no pixel is left to sample.
+    constexpr uint32_t kConvergenceCheck = 32;
+    uint32_t traced = 0;
+    for (sampleCount = 0; traced < samples; ++sampleCount) {
+        if (adaptiveThreshold > 0.0f && traced >= adaptiveMinSamples &&
+            sampleCount % kConvergenceCheck == 0 &&
+            adaptiveStats(ctx).convergedFraction >= 1.0)
+            break;
+
+        int f = static_cast<int>(currentFrame);
+
+        ctx.waitGraphics(frameTimeline[f]);
+
+        frameSpp  = std::min(samplesPerFrame, samples - traced);
+        pathCount = traced;
+        traced   += frameSpp;
+        updateCamera(f, scene, aspect);
+
+        VkCommandBuffer cmd = commandBuffers[f];
+        vkResetCommandBuffer(cmd, 0);
+
+        VkCommandBufferBeginInfo bi{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(cmd, &bi);
+        ctx.profiler.collect(ctx);
+        ctx.profiler.open(cmd, ctx.graphicsQueueFamily);
+
+        recordTrace(cmd, f, ctx, pipe);
+
+        vkEndCommandBuffer(cmd);
+
+        frameTimeline[f] = ctx.submitGraphics(&cmd, 1);
+
+        currentFrame = (currentFrame + 1) % ctx.framesInFlight;
+    }
+
+    if (denoiser.enabled()) {
+        VkCommandBuffer cmd = ctx.beginSingleTimeCommands();
+        denoiser.record(cmd, ctx, ctx.renderExtent);
+        ctx.endSingleTimeCommands(cmd);
+    }
+
+    ctx.waitGraphics(ctx.graphicsSubmitted);
+    samples = traced;
+
+    double secs = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - t0).count();
+    std::cout << "[Renderer] " << samples << " spp at "
+              << ctx.renderExtent.width << "x" << ctx.renderExtent.height
+              << " in " << secs * 1000.0 << " ms ("
+              << (secs > 0.0 ? samples / secs : 0.0) << " spp/s)\n";
+
+    if (adaptiveThreshold > 0.0f) {
+        AdaptiveStats s = adaptiveStats(ctx);
+        std::cout << "[Renderer] Adaptive: " << s.convergedFraction * 100.0
+                  << "% of pixels converged, " << s.samples << " paths traced ("
+                  << (s.uniformSamples ? 100.0 * s.samples / s.uniformSamples : 0.0)
+                  << "% of uniform)\n";
+    }
+}
+
+// ---------------------------------------------------------------------------
+// adaptiveStats — how much of the image has converged
+// ---------------------------------------------------------------------------
+
+Renderer::AdaptiveStats Renderer::adaptiveStats(VulkanContext& ctx)
+{
+    CPU_ZONE("Renderer::adaptiveStats");
+    const std::vector<float> moments = readImage(ctx, momentsImage);
+    const size_t pixels = moments.size() / 4;
+
+    uint64_t converged = 0, paths = 0;
+    float    maxPaths  = 0.0f;
+    for (size_t i = 0; i < pixels; ++i) {
+        const float* m = &moments[i * 4];
+        converged += pixelConverged(m, adaptiveThreshold, adaptiveMinSamples) ? 1 : 0;
+        paths     += static_cast<uint64_t>(m[2]);
+        maxPaths   = std::max(maxPaths, m[2]);
+    }
+
+    AdaptiveStats s;
+    s.convergedFraction = pixels ? double(converged) / pixels : 0.0;
+    s.samples           = paths;
+    s.uniformSamples    = pixels * static_cast<uint64_t>(maxPaths);
+    return s;
+}
+
+// ---------------------------------------------------------------------------
+// saveImage — read the accumulation image back and write it to disk
+// ---------------------------------------------------------------------------
+
+void Renderer::saveImage(VulkanContext& ctx, const std::string& path)
+{
+    CPU_ZONE("Renderer::saveImage");
+    const std::vector<float> pixels = readImage(ctx, displayImage());
+    writeImage(path, ctx.renderExtent.width, ctx.renderExtent.height, pixels.data());
+    std::cout << "[Renderer] Wrote " << path << '\n';
+}
+
+// ---------------------------------------------------------------------------
+// saveAovs — first-hit AOVs as exact float images
+// ---------------------------------------------------------------------------
+
+void Renderer::saveAovs(VulkanContext& ctx, const std::string& stem)
+{
+    CPU_ZONE("Renderer::saveAovs");
+    if (!aovs)
+        throw std::runtime_error("AOVs need an RT pipeline built with writeAovs");
+
+    const uint32_t w = ctx.renderExtent.width;
+    const uint32_t h = ctx.renderExtent.height;
+    auto write = [&](const char* suffix, const std::vector<float>& pixels) {
+        const std::string path = stem + suffix;
+        writeImage(path, w, h, pixels.data());
+        std::cout << "[Renderer] Wrote " << path << '\n';
+    };
+
+    // Normal and depth share an image; split them into a file each
+    const std::vector<float> normalDepth = readImage(ctx, normalDepthImage);
+    std::vector<float> normal(normalDepth.size()), depth(normalDepth.size());
+    for (size_t i = 0; i < normalDepth.size(); i += 4) {
+        normal[i + 0] = normalDepth[i + 0];
+        normal[i + 1] = normalDepth[i + 1];
+        normal[i + 2] = normalDepth[i + 2];
+        depth[i + 0]  = depth[i + 1] = depth[i + 2] = normalDepth[i + 3];
+        normal[i + 3] = depth[i + 3] = 1.0f;
+    }
+
+    write("_albedo.pfm", readImage(ctx, albedoImage));
+    write("_normal.pfm", normal);
+    write("_depth.pfm",  depth);
+    write("_id.pfm",     readImage(ctx, idImage));
+}
+
+std::vector<float> Renderer::readImage(VulkanContext& ctx, const AllocatedImage& image)
+{
+    const uint32_t w = ctx.renderExtent.width;
+    const uint32_t h = ctx.renderExtent.height;
+    const VkDeviceSize size = VkDeviceSize(w) * h * 4 * sizeof(float);
+
+    AllocatedBuffer readback = ctx.createBuffer(
+        size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_AUTO,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+
+    VkCommandBuffer cmd = ctx.beginSingleTimeCommands();
+
+    // Written by the trace or the denoiser
+    const VkPipelineStageFlags shaderStages =
+        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    imageBarrier(cmd, image.image,
+        VK_IMAGE_LAYOUT_GENERAL,              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_ACCESS_SHADER_WRITE_BIT,           VK_ACCESS_TRANSFER_READ_BIT,
+        shaderStages,                         VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent      = {w, h, 1};
+    vkCmdCopyImageToBuffer(cmd,
+        image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        readback.buffer, 1, &region);
+
+    imageBarrier(cmd, image.image,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+        VK_ACCESS_TRANSFER_READ_BIT,          VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,       shaderStages);
+
+    ctx.endSingleTimeCommands(cmd);
+
+    std::vector<float> pixels(size_t(w) * h * 4);
+    void* mapped;
+    vmaMapMemory(ctx.allocator, readback.allocation, &mapped);
+    vmaInvalidateAllocation(ctx.allocator, readback.allocation, 0, VK_WHOLE_SIZE);
+    std::memcpy(pixels.data(), mapped, size);
+    vmaUnmapMemory(ctx.allocator, readback.allocation);
+    ctx.destroyBuffer(readback);
+    return pixels;
 }
 
 // ---------------------------------------------------------------------------
@@ -352,12 +804,16 @@ void Renderer::destroy(VulkanContext& ctx)
     vkDeviceWaitIdle(ctx.device);
 
     ctx.destroyImage(storageImage);
-
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        ctx.destroyBuffer(cameraUBOs[i]);
-        vkDestroySemaphore(ctx.device, imageAvailableSems[i], nullptr);
-        vkDestroyFence    (ctx.device, inFlightFences[i],     nullptr);
-    }
+    ctx.destroyImage(momentsImage);
+    ctx.destroyImage(normalDepthImage);
+    ctx.destroyImage(albedoImage);
+    ctx.destroyImage(idImage);
+    denoiser.destroy(ctx);
+
+    for (AllocatedBuffer& ubo : cameraUBOs)
+        ctx.destroyBuffer(ubo);
+    for (VkSemaphore sem : imageAvailableSems)
+        vkDestroySemaphore(ctx.device, sem, nullptr);
     for (VkSemaphore sem : renderFinishedSems)
         vkDestroySemaphore(ctx.device, sem, nullptr);
     vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
@@ -3,49 +3,133 @@
 #include "Scene.h"
 #include "AccelStructure.h"
 #include "RTPipeline.h"
+#include "Denoiser.h"
 #include "types.h"
 
-#include <array>
+#include <string>
 #include <vector>
 
-static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
 class Renderer {
 public:
+    // Adaptive sampling: a pixel stops taking samples once the standard
+    // error of its mean luminance drops below adaptiveThreshold times the
+    // mean, after at least adaptiveMinSamples samples. 0 traces every pixel
+    // every frame.
+    float    adaptiveThreshold  = 0.0f;
+    uint32_t adaptiveMinSamples = 16;
+
+    // Paths traced per pixel per dispatch. Fixed unless frameBudgetMs is
+    // set, in which case drawFrame() steers it from measured GPU frame
+    // times so a frame takes about frameBudgetMs, or stillBudgetMs while an
+    // unmoving view accumulates (0 = frameBudgetMs). samplesPerFrame is
+    // then only the starting point.
+    uint32_t samplesPerFrame    = 1;
+    uint32_t maxSamplesPerFrame = 256;
+    float    frameBudgetMs      = 0.0f;
+    float    stillBudgetMs      = 0.0f;
+    // Dynamic resolution, with frameBudgetMs: below 1, a moving view traces
+    // a smaller top-left region of the storage image (each axis scaled down
+    // to no less than this) sized to fit the budget, and the blit upscales
+    // it to the swapchain. A still view steps back up to native.
+    float    minRenderScale     = 1.0f;
+
+    // Filters what is displayed and saved; the accumulation image itself is
+    // never touched. Set denoiser.iterations (and pipe.writeAovs) before init().
+    Denoiser denoiser;
+
+    struct AdaptiveStats {
+        double   convergedFraction = 0.0;   // pixels that stopped sampling
+        uint64_t samples           = 0;     // paths actually traced
+        uint64_t uniformSamples    = 0;     // paths without adaptive sampling
+    };
+
     void init   (VulkanContext& ctx, Scene& scene,
                  AccelStructure& accel, RTPipeline& pipe);
+    // Refits the TLAS in the frame's command buffer first if
+    // scene.instancesMoved is set (and clears it)
     void drawFrame(VulkanContext& ctx, Scene& scene,
                    AccelStructure& accel, RTPipeline& pipe, float aspect);
+
+    // Headless: accumulate a fixed number of samples into the storage image
+    // with no swapchain acquire/present, then read it back to disk.
+    void renderOffscreen(VulkanContext& ctx, Scene& scene, RTPipeline& pipe,
+                         float aspect, uint32_t samples);
+    void saveImage      (VulkanContext& ctx, const std::string& path);
+    // Write the first-hit AOVs next to an image: <stem>_albedo.pfm,
+    // _normal.pfm, _depth.pfm and _id.pfm (r = instance, g = material,
+    // -1 for the sky). Needs a pipeline built with writeAovs.
+    void saveAovs       (VulkanContext& ctx, const std::string& stem);
+    // Reads the moments image back; waits for all submitted work
+    AdaptiveStats adaptiveStats(VulkanContext& ctx);
+
     void destroy(VulkanContext& ctx);
 
 private:
     AllocatedImage storageImage;
+    AllocatedImage momentsImage;   // per-pixel luminance mean, mean square, count
+    // First-hit AOVs written by raygen (not created unless pipe.writeAovs)
+    bool           aovs = false;
+    AllocatedImage normalDepthImage;   // xyz = normal, w = linear depth
+    AllocatedImage albedoImage;
+    AllocatedImage idImage;            // x = instance, y = material
 
-    std::array<AllocatedBuffer, MAX_FRAMES_IN_FLIGHT> cameraUBOs;
-    std::array<void*,           MAX_FRAMES_IN_FLIGHT> cameraUBOMapped{};
+    // Per frame in flight (ctx.framesInFlight of each)
+    std::vector<AllocatedBuffer> cameraUBOs;
+    std::vector<void*>           cameraUBOMapped;
 
     VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-    std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+    std::vector<VkDescriptorSet> descriptorSets;
+
+    std::vector<VkCommandBuffer> commandBuffers;
+    // Graphics timeline value of the last submission from each frame slot;
+    // the slot's resources are free once the timeline has passed it
+    std::vector<uint64_t>        frameTimeline;
 
-    std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT> commandBuffers{};
-    // One semaphore per frame-in-flight for image acquisition
-    std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> imageAvailableSems{};
-    // One semaphore per swapchain image so the presentation engine never
-    // races with a re-signal before it has finished consuming the semaphore
+    // Swapchain acquire / present still take binary semaphores: one per
+    // frame slot for acquisition, one per swapchain image for present so the
+    // presentation engine never races with a re-signal
+    std::vector<VkSemaphore> imageAvailableSems;
     std::vector<VkSemaphore> renderFinishedSems;
-    std::array<VkFence, MAX_FRAMES_IN_FLIGHT> inFlightFences{};
-    // Tracks which per-frame fence last rendered into each swapchain image
-    std::vector<VkFence> imagesInFlight;
+    // Timeline value of the last frame that rendered into each swapchain image
+    std::vector<uint64_t>    imageTimeline;
 
     uint32_t currentFrame = 0;
     uint32_t sampleCount  = 0;
+    uint32_t pathCount    = 0;   // paths per pixel accumulated before this dispatch
+    uint32_t frameSpp     = 1;   // paths per pixel of the dispatch being recorded
+    float      renderScale   = 1.0f;                // per axis, of ctx.renderExtent
+    VkExtent2D traceExtent{};                       // storage image region traced
+    VkFilter   upscaleFilter = VK_FILTER_NEAREST;   // LINEAR where rgba32f supports it
 
-    void createStorageImage  (VulkanContext& ctx);
+    // Frame-time controller: the profiler's "frame" scope, tagged with the
+    // frame slot so a sample can be matched to what that frame traced
+    bool                  budgetActive  = false;
+    std::vector<uint32_t> slotSpp;           // paths the slot's last frame traced
+    std::vector<float>    slotScale;         // and its render scale
+    uint64_t              framesTimed   = 0; // "frame" samples already folded in
+    double                msPerPath     = 0.0;   // smoothed GPU time of one path per native pixel
+
+    void createStorageImages (VulkanContext& ctx);
     void createDescriptorPool(VulkanContext& ctx);
     void createDescriptorSets(VulkanContext& ctx, Scene& scene,
                               AccelStructure& accel, RTPipeline& pipe);
     void createCommandBuffers(VulkanContext& ctx);
     void createSyncObjects   (VulkanContext& ctx);
+    void initFrameBudget     (VulkanContext& ctx);
+
+    void updateCamera(int frame, Scene& scene, float aspect);
+    // Fold the latest frame timing into msPerPath and pick frameSpp and
+    // renderScale; true if the scale changed (accumulation must restart)
+    bool updateFrameBudget(VulkanContext& ctx, bool still);
+    void recordTrace (VkCommandBuffer cmd, int frame,
+                      VulkanContext& ctx, RTPipeline& pipe);
+    // Copy a full-extent rgba32f image to host memory
+    std::vector<float> readImage(VulkanContext& ctx, const AllocatedImage& image);
+    // What the window shows and saveImage() writes
+    const AllocatedImage& displayImage() const
+    {
+        return denoiser.enabled() ? denoiser.output() : storageImage;
+    }
 
     static void imageBarrier(VkCommandBuffer cmd, VkImage image,
                              VkImageLayout oldLayout, VkImageLayout newLayout,
@@ -1,9 +1,22 @@
 #include "Scene.h"
+#include "CpuProfiler.h"
+#include "MeshLoader.h"
+#include "GltfLoader.h"
+#include "SceneCache.h"
+#include "Hash.h"
 
 #include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <cmath>
+#include <cstddef>
 #include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
 #include <stdexcept>
+#include <unordered_map>
 
 // ---------------------------------------------------------------------------
 // Camera
@@ -68,15 +81,103 @@ void Camera::processInput(GLFWwindow* window, float dt)
     if (moved) target = position + glm::normalize(target - position);
 }
 
+// ---------------------------------------------------------------------------
+// MeshData
+// ---------------------------------------------------------------------------
+
+uint32_t MeshData::vertexCount() const
+{
+    return mapped() ? source.vertexCount : static_cast<uint32_t>(vertices.size());
+}
+
+uint32_t MeshData::indexCount() const
+{
+    return mapped() ? source.indexCount : static_cast<uint32_t>(indices.size());
+}
+
+void MeshData::writeVertices(Vertex* dst) const
+{
+    if (!mapped()) {
+        std::memcpy(dst, vertices.data(), vertices.size() * sizeof(Vertex));
+        return;
+    }
+
+    // Source already interleaved exactly like Vertex (scene caches, some glTF)
+    if (source.positionStride == sizeof(Vertex) && source.normalStride == sizeof(Vertex) &&
+        source.uvStride == sizeof(Vertex) && source.uvComponentSize == 4 &&
+        source.normals == source.positions + offsetof(Vertex, normal) &&
+        source.uvs     == source.positions + offsetof(Vertex, uv)) {
+        std::memcpy(dst, source.positions - offsetof(Vertex, pos), size_t(source.vertexCount) * sizeof(Vertex));
+        return;
+    }
+
+    for (uint32_t i = 0; i < source.vertexCount; ++i) {
+        Vertex v;
+        std::memcpy(&v.pos,    source.positions + i * source.positionStride, sizeof(glm::vec3));
+        std::memcpy(&v.normal, source.normals   + i * source.normalStride,   sizeof(glm::vec3));
+
+        const uint8_t* uv = source.uvs ? source.uvs + i * source.uvStride : nullptr;
+        if (!uv) {
+            v.uv = glm::vec2(0.0f);
+        } else if (source.uvComponentSize == 4) {
+            std::memcpy(&v.uv, uv, sizeof(glm::vec2));
+        } else if (source.uvComponentSize == 2) {
+            uint16_t q[2];
+            std::memcpy(q, uv, sizeof(q));
+            v.uv = glm::vec2(q[0], q[1]) / 65535.0f;
+        } else {
+            v.uv = glm::vec2(uv[0], uv[1]) / 255.0f;
+        }
+        dst[i] = v;
+    }
+}
+
+void MeshData::writeIndices(uint32_t* dst) const
+{
+    if (!mapped()) {
+        std::memcpy(dst, indices.data(), indices.size() * sizeof(uint32_t));
+        return;
+    }
+
+    const uint8_t* src = source.indices;
+    if (!src) {
+        for (uint32_t i = 0; i < source.indexCount; ++i) dst[i] = i;
+    } else if (source.indexSize == 4) {
+        std::memcpy(dst, src, size_t(source.indexCount) * 4);
+    } else if (source.indexSize == 2) {
+        for (uint32_t i = 0; i < source.indexCount; ++i) {
+            uint16_t ix;
+            std::memcpy(&ix, src + i * 2, 2);
+            dst[i] = ix;
+        }
+    } else {
+        for (uint32_t i = 0; i < source.indexCount; ++i) dst[i] = src[i];
+    }
+}
+
+void MeshData::bounds(glm::vec3& min, glm::vec3& max) const
+{
+    min = glm::vec3( std::numeric_limits<float>::max());
+    max = glm::vec3(-std::numeric_limits<float>::max());
+    for (uint32_t i = 0, n = vertexCount(); i < n; ++i) {
+        glm::vec3 p;
+        if (mapped()) std::memcpy(&p, source.positions + i * source.positionStride, sizeof(p));
+        else          p = vertices[i].pos;
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+}
+
 // ---------------------------------------------------------------------------
 // Scene geometry
 // ---------------------------------------------------------------------------
 
+// Unit sphere placed by its instance transform, so every sphere of the same
+// tessellation ends up sharing one mesh after deduplicateMeshes()
 void Scene::addSphere(const glm::vec3& center, float radius,
                       uint32_t materialIdx, int stacks, int slices)
 {
     MeshData mesh;
-    mesh.materialIndex = materialIdx;
 
     for (int i = 0; i <= stacks; ++i) {
         float phi = glm::pi<float>() * i / stacks;
@@ -88,7 +189,7 @@ void Scene::addSphere(const glm::vec3& center, float radius,
                 std::sin(phi) * std::sin(theta)
             };
             Vertex v;
-            v.pos    = center + n * radius;
+            v.pos    = n;
             v.normal = n;
             v.uv     = {static_cast<float>(j) / slices,
                         static_cast<float>(i) / stacks};
@@ -110,7 +211,8 @@ void Scene::addSphere(const glm::vec3& center, float radius,
 
     SceneInstance inst;
     inst.meshIndex     = meshIdx;
-    inst.transform     = glm::mat4(1.0f);
+    inst.transform     = glm::translate(glm::mat4(1.0f), center)
+                       * glm::scale(glm::mat4(1.0f), glm::vec3(radius));
     inst.materialIndex = materialIdx;
     instances.push_back(inst);
 }
@@ -119,7 +221,6 @@ void Scene::addPlane(const glm::vec3& center, float halfW, float halfD,
                      uint32_t materialIdx)
 {
     MeshData mesh;
-    mesh.materialIndex = materialIdx;
 
     glm::vec3 n{0.0f, 1.0f, 0.0f};
     mesh.vertices = {
@@ -140,12 +241,93 @@ void Scene::addPlane(const glm::vec3& center, float halfW, float halfD,
     instances.push_back(inst);
 }
 
+void Scene::addModel(const std::string& path, uint32_t materialIdx, uint32_t loaderThreads)
+{
+    CPU_ZONE("Scene::addModel");
+    const size_t firstInstance = instances.size();
+
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (ext == ".glb" || ext == ".gltf") {
+        loadGltf(path, *this);
+    } else {
+        MeshData mesh;
+        loadMesh(path, mesh, loaderThreads);
+
+        SceneInstance inst;
+        inst.meshIndex     = static_cast<uint32_t>(meshes.size());
+        inst.transform     = glm::mat4(1.0f);
+        inst.materialIndex = materialIdx;
+        meshes.push_back(std::move(mesh));
+        instances.push_back(inst);
+    }
+    fitToFloor(firstInstance);
+}
+
+// Uniform scale of instances [firstInstance, end) to a 3-unit bounding box,
+// centred over the origin and resting on the floor at y = -1. Only instance
+// transforms change; the vertex data stays as authored.
+void Scene::fitToFloor(size_t firstInstance)
+{
+    std::vector<glm::vec3> meshMin(meshes.size()), meshMax(meshes.size());
+    std::vector<bool>      haveBounds(meshes.size(), false);
+
+    glm::vec3 bmin(std::numeric_limits<float>::max());
+    glm::vec3 bmax(-std::numeric_limits<float>::max());
+    for (size_t i = firstInstance; i < instances.size(); ++i) {
+        const SceneInstance& inst = instances[i];
+        if (!haveBounds[inst.meshIndex]) {
+            meshes[inst.meshIndex].bounds(meshMin[inst.meshIndex], meshMax[inst.meshIndex]);
+            haveBounds[inst.meshIndex] = true;
+        }
+        const glm::vec3& lo = meshMin[inst.meshIndex];
+        const glm::vec3& hi = meshMax[inst.meshIndex];
+        if (lo.x > hi.x) continue;
+        for (int c = 0; c < 8; ++c) {
+            glm::vec3 corner{(c & 1) ? hi.x : lo.x, (c & 2) ? hi.y : lo.y, (c & 4) ? hi.z : lo.z};
+            glm::vec3 world = glm::vec3(inst.transform * glm::vec4(corner, 1.0f));
+            bmin = glm::min(bmin, world);
+            bmax = glm::max(bmax, world);
+        }
+    }
+    if (bmin.x > bmax.x)
+        return;
+
+    glm::vec3 extent = bmax - bmin;
+    float     scale  = 3.0f / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+    glm::vec3 offset{-(bmin.x + bmax.x) * 0.5f, -bmin.y, -(bmin.z + bmax.z) * 0.5f};
+
+    glm::mat4 fit = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, 0.0f))
+                  * glm::scale(glm::mat4(1.0f), glm::vec3(scale))
+                  * glm::translate(glm::mat4(1.0f), offset);
+    for (size_t i = firstInstance; i < instances.size(); ++i)
+        instances[i].transform = fit * instances[i].transform;
+}
+
 // ---------------------------------------------------------------------------
 // buildScene — geometry + material definitions
 // ---------------------------------------------------------------------------
 
-void Scene::buildScene()
+void Scene::buildScene(const std::string& modelPath, uint32_t loaderThreads, bool useCache)
 {
+    CPU_ZONE("Scene::buildScene");
+    // A scene cache given directly is loaded as is
+    if (std::filesystem::path(modelPath).extension() == ".rtscene") {
+        if (!loadSceneCache(modelPath, *this))
+            throw std::runtime_error("Failed to load scene cache " + modelPath);
+        return;
+    }
+
+    // Otherwise look for an up-to-date cache next to the asset
+    uint64_t cacheKey = 0;
+    if (!modelPath.empty() && useCache) {
+        cacheKey = sceneCacheKey(modelPath);
+        if (loadSceneCache(sceneCachePath(modelPath), *this, cacheKey))
+            return;
+    }
+
     // Materials
     // 0: white diffuse floor
     materials.push_back({{0.8f, 0.8f, 0.8f}, 0.0f, {0,0,0}, 0.95f, 1.5f, 0, {0,0}});
@@ -162,11 +344,107 @@ void Scene::buildScene()
 
     // Geometry
     addPlane ({0.0f, -1.0f,  0.0f}, 6.0f, 6.0f, 0); // floor
+    instances.back().isStatic = true;
+
+    if (!modelPath.empty()) {
+        addModel(modelPath, 0, loaderThreads);
+        addSphere({ 0.0f, 4.5f,  0.0f}, 0.6f, 4);    // area light
+        deduplicateMeshes();
+        if (useCache)
+            writeSceneCache(sceneCachePath(modelPath), *this, cacheKey);
+        return;
+    }
+
     addSphere({-2.0f, 0.0f,  0.0f}, 1.0f, 1);        // red diffuse
     addSphere({ 0.0f, 0.0f,  0.0f}, 1.0f, 2);        // gold metal
     addSphere({ 2.0f, 0.0f,  0.0f}, 1.0f, 3);        // glass
     addSphere({-2.0f, 0.0f, -3.0f}, 1.0f, 5);        // blue diffuse
     addSphere({ 0.0f, 4.5f,  0.0f}, 0.6f, 4);        // area light
+    deduplicateMeshes();
+}
+
+// ---------------------------------------------------------------------------
+// deduplicateMeshes
+// ---------------------------------------------------------------------------
+
+size_t Scene::deduplicateMeshes()
+{
+    CPU_ZONE("Scene::deduplicateMeshes");
+    if (meshes.size() < 2)
+        return 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    // Only meshes sharing their vertex and index counts with another mesh can
+    // be duplicates; everything else is never read
+    std::unordered_map<uint64_t, std::vector<uint32_t>> bySize;
+    for (uint32_t m = 0; m < meshes.size(); ++m)
+        bySize[uint64_t(meshes[m].vertexCount()) << 32 | meshes[m].indexCount()].push_back(m);
+
+    // Compare in GPU layout, so a mapped mesh and its decoded copy are equal
+    std::vector<Vertex>   verts, otherVerts;
+    std::vector<uint32_t> indices, otherIndices;
+    auto gather = [&](uint32_t m, std::vector<Vertex>& v, std::vector<uint32_t>& ix) {
+        v.resize(meshes[m].vertexCount());
+        ix.resize(meshes[m].indexCount());
+        meshes[m].writeVertices(v.data());
+        meshes[m].writeIndices(ix.data());
+    };
+
+    std::vector<uint32_t> survivor(meshes.size());
+    for (uint32_t m = 0; m < meshes.size(); ++m)
+        survivor[m] = m;
+
+    for (auto& [size, group] : bySize) {
+        if (group.size() < 2)
+            continue;
+
+        std::unordered_multimap<uint64_t, uint32_t> unique;   // hash -> first mesh with it
+        for (uint32_t m : group) {
+            gather(m, verts, indices);
+            uint64_t h = hashBytes(indices.data(), indices.size() * sizeof(uint32_t),
+                                   hashBytes(verts.data(), verts.size() * sizeof(Vertex)));
+
+            auto [first, last] = unique.equal_range(h);
+            for (auto it = first; it != last && survivor[m] == m; ++it) {
+                gather(it->second, otherVerts, otherIndices);
+                if (std::memcmp(verts.data(), otherVerts.data(), verts.size() * sizeof(Vertex)) == 0 &&
+                    std::memcmp(indices.data(), otherIndices.data(), indices.size() * sizeof(uint32_t)) == 0)
+                    survivor[m] = it->second;
+            }
+            if (survivor[m] == m)
+                unique.emplace(h, m);
+        }
+    }
+
+    // Compact the mesh list (order preserved) and remap the instances
+    std::vector<uint32_t> newIndex(meshes.size());
+    size_t kept = 0;
+    for (uint32_t m = 0; m < meshes.size(); ++m) {
+        if (survivor[m] != m) {
+            newIndex[m] = newIndex[survivor[m]];
+            continue;
+        }
+        newIndex[m] = static_cast<uint32_t>(kept);
+        if (kept != m)
+            meshes[kept] = std::move(meshes[m]);
+        ++kept;
+    }
+
+    const size_t removed = meshes.size() - kept;
+    if (removed == 0)
+        return 0;
+
+    meshes.resize(kept);
+    for (SceneInstance& inst : instances)
+        inst.meshIndex = newIndex[inst.meshIndex];
+
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - t0).count();
+    std::cout << "[Scene] Merged " << removed << " duplicate meshes: " << kept
+              << " unique meshes for " << instances.size() << " instances ("
+              << ms << " ms)\n";
+    return removed;
 }
 
 // ---------------------------------------------------------------------------
@@ -177,70 +455,111 @@ AllocatedBuffer Scene::upload(VulkanContext& ctx,
                               const void* data, VkDeviceSize size,
                               VkBufferUsageFlags usage)
 {
-    // Staging buffer (CPU visible)
-    AllocatedBuffer staging = ctx.createBuffer(
-        size,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VMA_MEMORY_USAGE_AUTO,
-        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-
-    void* mapped;
-    vmaMapMemory(ctx.allocator, staging.allocation, &mapped);
-    std::memcpy(mapped, data, size);
-    vmaUnmapMemory(ctx.allocator, staging.allocation);
-
-    // GPU buffer
     AllocatedBuffer gpu = ctx.createBuffer(
         size,
         usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-
-    VkCommandBuffer cmd = ctx.beginSingleTimeCommands();
-    VkBufferCopy region{0, 0, size};
-    vkCmdCopyBuffer(cmd, staging.buffer, gpu.buffer, 1, &region);
-    ctx.endSingleTimeCommands(cmd);
-
-    ctx.destroyBuffer(staging);
+    ctx.staging.upload(ctx, gpu.buffer, 0, data, size);
     return gpu;
 }
 
-void Scene::uploadToGPU(VulkanContext& ctx)
+void Scene::layoutMeshes(std::vector<MeshRange>& ranges,
+                         size_t& vertexCount, size_t& indexCount) const
 {
-    // Flatten all meshes into contiguous vertex / index arrays
-    std::vector<Vertex>       allVerts;
-    std::vector<uint32_t>     allIndices;
-    std::vector<InstanceData> instData;
+    ranges.clear();
+    vertexCount = 0;
+    indexCount  = 0;
+
+    for (const MeshData& mesh : meshes) {
+        ranges.push_back({static_cast<uint32_t>(vertexCount), static_cast<uint32_t>(indexCount)});
+        vertexCount += mesh.vertexCount();
+        indexCount  += mesh.indexCount();
+    }
+}
+
+void Scene::flatten(std::vector<Vertex>&    allVerts,
+                    std::vector<uint32_t>&  allIndices,
+                    std::vector<MeshRange>& ranges) const
+{
+    size_t vertexCount, indexCount;
+    layoutMeshes(ranges, vertexCount, indexCount);
 
+    allVerts.resize(vertexCount);
+    allIndices.resize(indexCount);
     for (size_t i = 0; i < meshes.size(); ++i) {
-        InstanceData id{};
-        id.vertexOffset   = static_cast<uint32_t>(allVerts.size());
-        id.indexOffset    = static_cast<uint32_t>(allIndices.size());
-        id.materialIndex  = meshes[i].materialIndex;
-        instData.push_back(id);
-
-        for (auto& v : meshes[i].vertices) allVerts.push_back(v);
-        for (auto& ix : meshes[i].indices)  allIndices.push_back(ix);
+        meshes[i].writeVertices(allVerts.data()   + ranges[i].vertexOffset);
+        meshes[i].writeIndices (allIndices.data() + ranges[i].indexOffset);
+    }
+}
+
+void Scene::instanceData(const std::vector<MeshRange>& ranges,
+                         std::vector<InstanceData>&    instData) const
+{
+    instData.resize(instances.size());
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const SceneInstance& si = instances[i];
+        instData[i].vertexOffset  = ranges[si.meshIndex].vertexOffset;
+        instData[i].indexOffset   = ranges[si.meshIndex].indexOffset;
+        instData[i].materialIndex = si.materialIndex;
+        instData[i].meshIndex     = si.meshIndex;
     }
+}
+
+void Scene::uploadToGPU(VulkanContext& ctx)
+{
+    CPU_ZONE("Scene::uploadToGPU");
+    auto t0 = std::chrono::steady_clock::now();
+    const StagingStats before = ctx.staging.stats();
+
+    // Each mesh is written straight into the staging ring and copied to its
+    // offset in the global vertex / index buffers; mapped glTF buffer views
+    // are gathered from the file without a flattened copy in between. All
+    // copies go out in as few submissions as the ring size allows.
+    std::vector<MeshRange> ranges;
+    size_t vertexCount, indexCount;
+    layoutMeshes(ranges, vertexCount, indexCount);
 
     constexpr VkBufferUsageFlags geoFlags =
         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
         VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 
-    vertexBuffer = upload(ctx, allVerts.data(),
-        allVerts.size() * sizeof(Vertex),
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | geoFlags);
-
-    indexBuffer = upload(ctx, allIndices.data(),
-        allIndices.size() * sizeof(uint32_t),
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | geoFlags);
-
-    materialBuffer = upload(ctx, materials.data(),
-        materials.size() * sizeof(Material),
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    vertexBuffer = ctx.createBuffer(vertexCount * sizeof(Vertex),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | geoFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    indexBuffer  = ctx.createBuffer(indexCount * sizeof(uint32_t),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT  | geoFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    // All vertices first, then all indices, so consecutive meshes merge into
+    // one copy region
+    for (size_t i = 0; i < meshes.size(); ++i)
+        ctx.staging.upload(ctx, vertexBuffer.buffer,
+            VkDeviceSize(ranges[i].vertexOffset) * sizeof(Vertex),
+            VkDeviceSize(meshes[i].vertexCount()) * sizeof(Vertex),
+            [&](void* mapped) { meshes[i].writeVertices(static_cast<Vertex*>(mapped)); },
+            alignof(Vertex));
+    for (size_t i = 0; i < meshes.size(); ++i)
+        ctx.staging.upload(ctx, indexBuffer.buffer,
+            VkDeviceSize(ranges[i].indexOffset) * sizeof(uint32_t),
+            VkDeviceSize(meshes[i].indexCount()) * sizeof(uint32_t),
+            [&](void* mapped) { meshes[i].writeIndices(static_cast<uint32_t*>(mapped)); },
+            alignof(uint32_t));
 
+    std::vector<InstanceData> instData;
+    instanceData(ranges, instData);
     instanceDataBuffer = upload(ctx, instData.data(),
         instData.size() * sizeof(InstanceData),
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+
+    // Submitted without waiting; later work on the queue is ordered after it
+    ctx.staging.flush(ctx);
+
+    const StagingStats& after = ctx.staging.stats();
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - t0).count();
+    std::cout << "[Scene] Queued " << (after.bytes - before.bytes) / (1024.0 * 1024.0)
+              << " MiB for upload: " << after.copies - before.copies << " uploads, "
+              << after.regions - before.regions << " copy regions, "
+              << after.submissions - before.submissions << " submissions, "
+              << after.stalls - before.stalls << " stalls (" << ms << " ms)\n";
 }
 
 // ---------------------------------------------------------------------------
@@ -251,6 +570,5 @@ void Scene::destroy(VulkanContext& ctx)
 {
     ctx.destroyBuffer(vertexBuffer);
     ctx.destroyBuffer(indexBuffer);
-    ctx.destroyBuffer(materialBuffer);
     ctx.destroyBuffer(instanceDataBuffer);
 }
@@ -6,6 +6,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <GLFW/glfw3.h>
 
+#include <memory>
+#include <string>
 #include <vector>
 
 // ---------------------------------------------------------------------------
@@ -39,16 +41,52 @@ private:
 // Scene
 // ---------------------------------------------------------------------------
 
+// Geometry read in place from a memory-mapped asset (glTF buffer views)
+// instead of being copied into MeshData's vectors. The pointers stay valid for
+// as long as the owning entry in Scene::assetStorage.
+struct MeshSource {
+    const uint8_t* positions      = nullptr;   // float3
+    size_t         positionStride = 0;
+    const uint8_t* normals        = nullptr;   // float3
+    size_t         normalStride   = 0;
+    const uint8_t* uvs            = nullptr;   // optional
+    size_t         uvStride       = 0;
+    uint32_t       uvComponentSize = 4;        // 4 = float, 2 / 1 = normalized unsigned
+    const uint8_t* indices        = nullptr;   // optional; null = non-indexed
+    uint32_t       indexSize      = 4;         // 1, 2 or 4 bytes
+    uint32_t       vertexCount    = 0;
+    uint32_t       indexCount     = 0;
+};
+
 struct MeshData {
     std::vector<Vertex>   vertices;
     std::vector<uint32_t> indices;
-    uint32_t              materialIndex = 0;
+    MeshSource            source;             // used instead of the vectors when set
+
+    bool     mapped()      const { return source.positions != nullptr; }
+    uint32_t vertexCount() const;
+    uint32_t indexCount()  const;
+
+    // Write the mesh in GPU layout (Vertex / uint32 indices) to `dst`, which
+    // may be write-combined staging memory: writes are whole and sequential.
+    void writeVertices(Vertex*   dst) const;
+    void writeIndices (uint32_t* dst) const;
+    void bounds(glm::vec3& min, glm::vec3& max) const;
 };
 
+// Materials belong to instances, so meshes that differ only in material share
+// one MeshData (and one BLAS).
 struct SceneInstance {
     uint32_t  meshIndex;
     glm::mat4 transform;
     uint32_t  materialIndex;
+    bool      isStatic = false;   // held in place by --animate (the floor)
+};
+
+// Where a mesh starts in the global vertex / index arrays
+struct MeshRange {
+    uint32_t vertexOffset;
+    uint32_t indexOffset;
 };
 
 class Scene {
@@ -57,15 +95,43 @@ public:
     std::vector<SceneInstance> instances;
     std::vector<Material>      materials;
     Camera                     camera;
+    bool                       instancesMoved = false;   // transforms changed: refit TLAS, reset accumulation
+
+    // Keeps mapped asset files (and parser state) alive for MeshSource views
+    std::vector<std::shared_ptr<const void>> assetStorage;
 
     // GPU-side resources (filled by uploadToGPU)
     AllocatedBuffer vertexBuffer;
     AllocatedBuffer indexBuffer;
-    AllocatedBuffer materialBuffer;
     AllocatedBuffer instanceDataBuffer;
 
-    void buildScene();
+    // Demo scene: floor, area light and either the default spheres or, if
+    // `modelPath` is set, that .obj / .ply / .glb / .gltf asset scaled to sit
+    // on the floor. With `useCache` a model scene is loaded from / saved to
+    // <model>.rtscene (see SceneCache.h); a .rtscene path is loaded directly.
+    void buildScene(const std::string& modelPath = "", uint32_t loaderThreads = 0,
+                    bool useCache = true);
     void uploadToGPU(VulkanContext& ctx);
+
+    // Merge meshes with identical geometry (content hash, confirmed by a full
+    // compare) and point their instances at the survivor, so each unique
+    // mesh gets one BLAS. Returns the number of meshes removed.
+    size_t deduplicateMeshes();
+
+    // Concatenate all meshes into the global vertex / index arrays exactly as
+    // they are laid out on the GPU, with each mesh's range in them.
+    void flatten(std::vector<Vertex>&    allVerts,
+                 std::vector<uint32_t>&  allIndices,
+                 std::vector<MeshRange>& ranges) const;
+
+    // Just the mesh ranges plus total vertex / index counts.
+    void layoutMeshes(std::vector<MeshRange>& ranges,
+                      size_t& vertexCount, size_t& indexCount) const;
+
+    // One InstanceData per SceneInstance (indexed by instanceCustomIndex):
+    // its mesh's ranges plus its own material.
+    void instanceData(const std::vector<MeshRange>& ranges,
+                      std::vector<InstanceData>&    instData) const;
     void destroy(VulkanContext& ctx);
 
 private:
@@ -74,8 +140,10 @@ private:
                    uint32_t materialIdx, int stacks = 16, int slices = 32);
     void addPlane(const glm::vec3& center, float halfW, float halfD,
                   uint32_t materialIdx);
+    void addModel(const std::string& path, uint32_t materialIdx, uint32_t loaderThreads);
+    void fitToFloor(size_t firstInstance);
 
-    // Upload a CPU buffer to a GPU buffer via a staging buffer
+    // Create a GPU buffer and queue `data` for it on the staging arena
     AllocatedBuffer upload(VulkanContext& ctx, const void* data, VkDeviceSize size,
                            VkBufferUsageFlags usage);
 };
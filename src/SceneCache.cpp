@@ -0,0 +1,355 @@
+#include "SceneCache.h"
+#include "CpuProfiler.h"
+#include "Hash.h"
+#include "MappedFile.h"
+
+#include <cgltf.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Bump whenever the file layout or anything baked into it (Vertex / Material
+// layout, buildScene contents, loader behaviour) changes.
+constexpr uint32_t kCacheVersion = 3;
+constexpr char     kCacheMagic[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+constexpr uint64_t kSectionAlign  = 64;
+
+struct CacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t key;
+    uint32_t vertexSize;        // layout guards: sizeof(Vertex), sizeof(Material)
+    uint32_t materialSize;
+    uint32_t meshCount;
+    uint32_t instanceCount;
+    uint32_t materialCount;
+    uint32_t _pad;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t meshOffset;        // byte offsets of the sections from file start
+    uint64_t instanceOffset;
+    uint64_t materialOffset;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t fileSize;
+};
+
+struct CacheMesh {
+    uint32_t vertexOffset;      // in elements of the flattened arrays
+    uint32_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+};
+
+struct CacheInstance {
+    float    transform[16];     // column-major
+    uint32_t meshIndex;
+    uint32_t materialIndex;
+    uint32_t isStatic;          // SceneInstance::isStatic
+    uint32_t _pad;
+};
+
+uint64_t alignUp(uint64_t v) { return (v + kSectionAlign - 1) & ~(kSectionAlign - 1); }
+
+// Section [offset, offset + count * elemSize) lies inside the file
+bool inFile(uint64_t offset, uint64_t count, uint64_t elemSize, uint64_t fileSize)
+{
+    return offset <= fileSize && count <= (fileSize - offset) / elemSize;
+}
+
+// Mix every external buffer and image a glTF references into `key`: its URI,
+// size and modification time. Contents are not read, so a cache hit still
+// never touches the .bin files it stands in for. Data URIs are part of the
+// JSON, which is already hashed.
+uint64_t mixGltfReferences(const std::string& assetPath, const MappedFile& file, uint64_t key)
+{
+    cgltf_options options{};
+    cgltf_data*   raw = nullptr;
+    if (cgltf_parse(&options, file.data(), file.size(), &raw) != cgltf_result_success)
+        return key;     // loadGltf reports it
+    std::unique_ptr<cgltf_data, void (*)(cgltf_data*)> data(raw, cgltf_free);
+
+    const std::filesystem::path dir = std::filesystem::path(assetPath).parent_path();
+    auto mix = [&](const char* uri) {
+        if (!uri || std::strncmp(uri, "data:", 5) == 0 || std::strstr(uri, "://"))
+            return;
+        std::string name = uri;
+        name.resize(cgltf_decode_uri(&name[0]));
+
+        // A missing file hashes as size ~0; loading it fails anyway
+        std::error_code ec;
+        const std::filesystem::path p = dir / std::filesystem::u8path(name);
+        const uint64_t size  = std::filesystem::file_size(p, ec);
+        const auto     mtime = std::filesystem::last_write_time(p, ec);
+        const int64_t  ticks = ec ? 0 : static_cast<int64_t>(mtime.time_since_epoch().count());
+
+        key = hashBytes(name.data(), name.size(), key);
+        key = hashBytes(&size,  sizeof(size),  key);
+        key = hashBytes(&ticks, sizeof(ticks), key);
+    };
+    for (cgltf_size i = 0; i < data->buffers_count; ++i)
+        mix(data->buffers[i].uri);
+    for (cgltf_size i = 0; i < data->images_count; ++i)
+        mix(data->images[i].uri);
+    return key;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Key
+// ---------------------------------------------------------------------------
+
+std::string sceneCachePath(const std::string& assetPath)
+{
+    return assetPath + ".rtscene";
+}
+
+uint64_t sceneCacheKey(const std::string& assetPath)
+{
+    MappedFile file;
+    file.open(assetPath);
+    uint64_t key = hashBytes(file.data(), file.size(), kCacheVersion);
+
+    // A .gltf is only the JSON; its geometry sits in the files it references
+    // (a .glb may reference external buffers too)
+    std::string ext = std::filesystem::path(assetPath).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (ext == ".gltf" || ext == ".glb")
+        key = mixGltfReferences(assetPath, file, key);
+    return key;
+}
+
+// ---------------------------------------------------------------------------
+// Write
+// ---------------------------------------------------------------------------
+
+bool writeSceneCache(const std::string& path, const Scene& scene, uint64_t key)
+{
+    CPU_ZONE("writeSceneCache");
+    auto t0 = std::chrono::steady_clock::now();
+
+    std::vector<MeshRange> layout;
+    size_t vertexCount, indexCount;
+    scene.layoutMeshes(layout, vertexCount, indexCount);
+
+    CacheHeader hdr{};
+    std::memcpy(hdr.magic, kCacheMagic, sizeof(kCacheMagic));
+    hdr.version        = kCacheVersion;
+    hdr.headerSize     = sizeof(CacheHeader);
+    hdr.key            = key;
+    hdr.vertexSize     = sizeof(Vertex);
+    hdr.materialSize   = sizeof(Material);
+    hdr.meshCount      = static_cast<uint32_t>(scene.meshes.size());
+    hdr.instanceCount  = static_cast<uint32_t>(scene.instances.size());
+    hdr.materialCount  = static_cast<uint32_t>(scene.materials.size());
+    hdr.vertexCount    = vertexCount;
+    hdr.indexCount     = indexCount;
+    hdr.meshOffset     = alignUp(sizeof(CacheHeader));
+    hdr.instanceOffset = alignUp(hdr.meshOffset     + hdr.meshCount     * sizeof(CacheMesh));
+    hdr.materialOffset = alignUp(hdr.instanceOffset + hdr.instanceCount * sizeof(CacheInstance));
+    hdr.vertexOffset   = alignUp(hdr.materialOffset + hdr.materialCount * sizeof(Material));
+    hdr.indexOffset    = alignUp(hdr.vertexOffset   + vertexCount       * sizeof(Vertex));
+    hdr.fileSize       = hdr.indexOffset + indexCount * sizeof(uint32_t);
+
+    // Written next to the final file and renamed into place, so a reader never
+    // sees a partial cache
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[SceneCache] Cannot write " << tmpPath << "\n";
+            return false;
+        }
+
+        uint64_t pos = 0;
+        auto write = [&](const void* data, uint64_t size) {
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            pos += size;
+        };
+        auto padTo = [&](uint64_t offset) {
+            static const char zeros[kSectionAlign] = {};
+            write(zeros, offset - pos);
+        };
+
+        write(&hdr, sizeof(hdr));
+
+        padTo(hdr.meshOffset);
+        for (size_t m = 0; m < scene.meshes.size(); ++m) {
+            CacheMesh cm{};
+            cm.vertexOffset = layout[m].vertexOffset;
+            cm.indexOffset  = layout[m].indexOffset;
+            cm.vertexCount  = scene.meshes[m].vertexCount();
+            cm.indexCount   = scene.meshes[m].indexCount();
+            write(&cm, sizeof(cm));
+        }
+
+        padTo(hdr.instanceOffset);
+        for (const SceneInstance& inst : scene.instances) {
+            CacheInstance ci{};
+            std::memcpy(ci.transform, &inst.transform, sizeof(ci.transform));
+            ci.meshIndex     = inst.meshIndex;
+            ci.materialIndex = inst.materialIndex;
+            ci.isStatic      = inst.isStatic ? 1 : 0;
+            write(&ci, sizeof(ci));
+        }
+
+        padTo(hdr.materialOffset);
+        write(scene.materials.data(), scene.materials.size() * sizeof(Material));
+
+        // Geometry goes out one mesh at a time in GPU layout
+        padTo(hdr.vertexOffset);
+        std::vector<Vertex> verts;
+        for (const MeshData& mesh : scene.meshes) {
+            verts.resize(mesh.vertexCount());
+            mesh.writeVertices(verts.data());
+            write(verts.data(), verts.size() * sizeof(Vertex));
+        }
+
+        padTo(hdr.indexOffset);
+        std::vector<uint32_t> idx;
+        for (const MeshData& mesh : scene.meshes) {
+            idx.resize(mesh.indexCount());
+            mesh.writeIndices(idx.data());
+            write(idx.data(), idx.size() * sizeof(uint32_t));
+        }
+
+        if (!out.flush()) {
+            out.close();
+            std::remove(tmpPath.c_str());
+            std::cerr << "[SceneCache] Write to " << tmpPath << " failed\n";
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::remove(tmpPath.c_str());
+        std::cerr << "[SceneCache] Cannot replace " << path << ": " << ec.message() << "\n";
+        return false;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "[SceneCache] Wrote " << std::filesystem::path(path).filename().string() << " ("
+              << hdr.fileSize / (1024.0 * 1024.0) << " MB) in " << ms << " ms\n";
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Load
+// ---------------------------------------------------------------------------
+
+bool loadSceneCache(const std::string& path, Scene& scene, uint64_t key)
+{
+    CPU_ZONE("loadSceneCache");
+    auto t0 = std::chrono::steady_clock::now();
+
+    auto file = std::make_shared<MappedFile>();
+    try {
+        file->open(path);
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    auto reject = [&](const char* why) {
+        std::cout << "[SceneCache] Ignoring " << path << ": " << why << "\n";
+        return false;
+    };
+
+    CacheHeader hdr;
+    if (file->size() < sizeof(hdr))
+        return reject("truncated header");
+    std::memcpy(&hdr, file->data(), sizeof(hdr));
+
+    if (std::memcmp(hdr.magic, kCacheMagic, sizeof(kCacheMagic)) != 0)
+        return reject("not a scene cache");
+    if (hdr.version != kCacheVersion || hdr.headerSize != sizeof(CacheHeader) ||
+        hdr.vertexSize != sizeof(Vertex) || hdr.materialSize != sizeof(Material))
+        return reject("different format version");
+    if (key != 0 && hdr.key != key)
+        return reject("source asset changed");
+    if (hdr.fileSize != file->size() ||
+        !inFile(hdr.meshOffset,     hdr.meshCount,     sizeof(CacheMesh),     hdr.fileSize) ||
+        !inFile(hdr.instanceOffset, hdr.instanceCount, sizeof(CacheInstance), hdr.fileSize) ||
+        !inFile(hdr.materialOffset, hdr.materialCount, sizeof(Material),      hdr.fileSize) ||
+        !inFile(hdr.vertexOffset,   hdr.vertexCount,   sizeof(Vertex),        hdr.fileSize) ||
+        !inFile(hdr.indexOffset,    hdr.indexCount,    sizeof(uint32_t),      hdr.fileSize))
+        return reject("truncated or corrupt");
+
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(file->data());
+
+    // Meshes become views over the mapped vertex / index sections
+    std::vector<MeshData> meshes(hdr.meshCount);
+    size_t triangles = 0;
+    for (uint32_t m = 0; m < hdr.meshCount; ++m) {
+        CacheMesh cm;
+        std::memcpy(&cm, base + hdr.meshOffset + m * sizeof(CacheMesh), sizeof(cm));
+        if (uint64_t(cm.vertexOffset) + cm.vertexCount > hdr.vertexCount ||
+            uint64_t(cm.indexOffset)  + cm.indexCount  > hdr.indexCount  ||
+            cm.vertexCount == 0 || cm.indexCount % 3 != 0)
+            return reject("bad mesh range");
+
+        // Indices are mesh-local; one out of range would reach the BVH
+        // build and the GPU as an out-of-bounds vertex fetch
+        const uint32_t* meshIndices = reinterpret_cast<const uint32_t*>(
+            base + hdr.indexOffset + uint64_t(cm.indexOffset) * sizeof(uint32_t));
+        uint32_t maxIndex = 0;
+        for (uint32_t i = 0; i < cm.indexCount; ++i)
+            maxIndex = std::max(maxIndex, meshIndices[i]);
+        if (maxIndex >= cm.vertexCount)
+            return reject("index out of range");
+
+        const uint8_t* verts = base + hdr.vertexOffset + uint64_t(cm.vertexOffset) * sizeof(Vertex);
+        MeshSource& s    = meshes[m].source;
+        s.positions      = verts + offsetof(Vertex, pos);
+        s.normals        = verts + offsetof(Vertex, normal);
+        s.uvs            = verts + offsetof(Vertex, uv);
+        s.positionStride = s.normalStride = s.uvStride = sizeof(Vertex);
+        s.uvComponentSize = 4;
+        s.indices        = base + hdr.indexOffset + uint64_t(cm.indexOffset) * sizeof(uint32_t);
+        s.indexSize      = 4;
+        s.vertexCount    = cm.vertexCount;
+        s.indexCount     = cm.indexCount;
+        triangles += cm.indexCount / 3;
+    }
+
+    std::vector<SceneInstance> instances(hdr.instanceCount);
+    for (uint32_t i = 0; i < hdr.instanceCount; ++i) {
+        CacheInstance ci;
+        std::memcpy(&ci, base + hdr.instanceOffset + i * sizeof(CacheInstance), sizeof(ci));
+        if (ci.meshIndex >= hdr.meshCount || ci.materialIndex >= hdr.materialCount)
+            return reject("bad instance");
+        std::memcpy(&instances[i].transform, ci.transform, sizeof(ci.transform));
+        instances[i].meshIndex     = ci.meshIndex;
+        instances[i].materialIndex = ci.materialIndex;
+        instances[i].isStatic      = ci.isStatic != 0;
+    }
+
+    std::vector<Material> materials(hdr.materialCount);
+    std::memcpy(materials.data(), base + hdr.materialOffset, hdr.materialCount * sizeof(Material));
+
+    scene.meshes    = std::move(meshes);
+    scene.instances = std::move(instances);
+    scene.materials = std::move(materials);
+    scene.assetStorage.push_back(file);
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "[SceneCache] Loaded " << std::filesystem::path(path).filename().string() << ": "
+              << hdr.meshCount << " meshes, " << hdr.instanceCount << " instances, " << triangles
+              << " triangles, " << hdr.fileSize / (1024.0 * 1024.0) << " MB mapped in " << ms << " ms\n";
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "Scene.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ---------------------------------------------------------------------------
+// SceneCache — versioned binary snapshot of a built scene (.rtscene)
+//
+// Stores the scene exactly as uploadToGPU lays it out: the flattened vertex
+// and index arrays, per-mesh ranges, instances and materials. Loading maps
+// the file and turns every mesh into a MeshSource view over the mapping, so
+// nothing is parsed or copied until the data is written into staging memory.
+//
+// Each cache records a 64-bit key (format version + hash of the source asset
+// bytes, plus path / size / mtime of any files a glTF references) and is
+// ignored when the key does not match, so it can live next to the asset it
+// was built from.
+// ---------------------------------------------------------------------------
+
+// <asset>.rtscene
+std::string sceneCachePath(const std::string& assetPath);
+
+// Key of a cache built from `assetPath`: hash of the file contents mixed with
+// the cache format version and, for glTF, the size and modification time of
+// every external buffer and image. Throws std::runtime_error if the asset
+// cannot be read.
+uint64_t sceneCacheKey(const std::string& assetPath);
+
+// Write `scene` (meshes, instances, materials; the camera is not stored) to
+// `path` via a temporary file and rename. Returns false on I/O errors.
+bool writeSceneCache(const std::string& path, const Scene& scene, uint64_t key);
+
+// Replace the geometry, instances and materials of `scene` with the contents
+// of `path`. Returns false, leaving `scene` untouched, if the file is missing,
+// malformed, from another format version or (unless `key` is 0) built with a
+// different key.
+bool loadSceneCache(const std::string& path, Scene& scene, uint64_t key = 0);
@@ -0,0 +1,327 @@
+#include "StagingArena.h"
+#include "CpuProfiler.h"
+#include "VulkanContext.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// ---------------------------------------------------------------------------
+// init / destroy
+// ---------------------------------------------------------------------------
+
+void StagingArena::createMapped(VulkanContext& ctx, VkDeviceSize bytes, Dedicated& out, void*& ptr)
+{
+    VkBufferCreateInfo bufInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    bufInfo.size  = bytes;
+    bufInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo allocCI{};
+    allocCI.usage = VMA_MEMORY_USAGE_AUTO;
+    allocCI.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                    VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo info{};
+    if (vmaCreateBuffer(ctx.allocator, &bufInfo, &allocCI,
+                        &out.buffer, &out.allocation, &info) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create staging buffer");
+    ptr = info.pMappedData;
+}
+
+void StagingArena::init(VulkanContext& ctx, VkDeviceSize capacity)
+{
+    Dedicated ring;
+    void*     ptr;
+    createMapped(ctx, capacity, ring, ptr);
+
+    buffer     = ring.buffer;
+    allocation = ring.allocation;
+    mapped     = static_cast<uint8_t*>(ptr);
+    size       = capacity;
+    head = tail = 0;
+
+    VkSemaphoreTypeCreateInfo typeInfo{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue  = 0;
+    VkSemaphoreCreateInfo semInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    semInfo.pNext = &typeInfo;
+    if (vkCreateSemaphore(ctx.device, &semInfo, nullptr, &timeline) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create staging timeline semaphore");
+
+    crossFamily = ctx.transferQueueFamily != ctx.graphicsQueueFamily;
+}
+
+void StagingArena::destroy(VulkanContext& ctx)
+{
+    if (buffer == VK_NULL_HANDLE)
+        return;
+
+    finish(ctx);
+    released.clear();
+    vkDestroySemaphore(ctx.device, timeline, nullptr);
+    timeline = VK_NULL_HANDLE;
+
+    vmaDestroyBuffer(ctx.allocator, buffer, allocation);
+    buffer     = VK_NULL_HANDLE;
+    allocation = VK_NULL_HANDLE;
+    mapped     = nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// upload
+// ---------------------------------------------------------------------------
+
+bool StagingArena::fits(VkDeviceSize bytes, VkDeviceSize alignment, VkDeviceSize& offset) const
+{
+    VkDeviceSize aligned = (head + alignment - 1) & ~(alignment - 1);
+
+    if (ringEmpty()) {
+        offset = 0;
+        return bytes <= size;
+    }
+    if (head > tail) {
+        // Free: [head, size) and, wrapping around, [0, tail)
+        if (aligned + bytes <= size) { offset = aligned; return true; }
+        if (bytes <= tail)           { offset = 0;       return true; }
+        return false;
+    }
+    if (head < tail && aligned + bytes <= tail) {
+        offset = aligned;
+        return true;
+    }
+    return false;   // head == tail: full
+}
+
+void StagingArena::upload(VulkanContext& ctx, VkBuffer dst, VkDeviceSize dstOffset,
+                          VkDeviceSize bytes, const std::function<void(void*)>& fill,
+                          VkDeviceSize alignment)
+{
+    if (bytes == 0)
+        return;
+
+    ++counters.copies;
+    counters.bytes += bytes;
+
+    if (bytes > size) {
+        Dedicated d;
+        void*     ptr;
+        createMapped(ctx, bytes, d, ptr);
+        fill(ptr);
+        vmaFlushAllocation(ctx.allocator, d.allocation, 0, VK_WHOLE_SIZE);
+
+        pendingDedicated.push_back(d);
+        pending.push_back({d.buffer, dst, {0, dstOffset, bytes}});
+        ++counters.oversized;
+        return;
+    }
+
+    // Take back whatever the GPU has finished with, then make room if needed:
+    // our own queued copies have to be submitted before their space can free up
+    retire(ctx, false);
+    VkDeviceSize offset = 0;
+    for (;;) {
+        if (ringEmpty())
+            head = tail = 0;
+        if (fits(bytes, alignment, offset))
+            break;
+        if (pendingRing) {
+            flush(ctx);
+        } else {
+            retire(ctx, true);
+            ++counters.stalls;
+        }
+    }
+
+    fill(mapped + offset);
+    vmaFlushAllocation(ctx.allocator, allocation, offset, bytes);
+    head        = offset + bytes;
+    pendingRing = true;
+
+    // Continues the previous copy in both buffers: extend it
+    if (!pending.empty()) {
+        Copy& last = pending.back();
+        if (last.src == buffer && last.dst == dst &&
+            last.region.srcOffset + last.region.size == offset &&
+            last.region.dstOffset + last.region.size == dstOffset) {
+            last.region.size += bytes;
+            return;
+        }
+    }
+    pending.push_back({buffer, dst, {offset, dstOffset, bytes}});
+}
+
+void StagingArena::upload(VulkanContext& ctx, VkBuffer dst, VkDeviceSize dstOffset,
+                          const void* data, VkDeviceSize bytes)
+{
+    upload(ctx, dst, dstOffset, bytes,
+           [&](void* staging) { std::memcpy(staging, data, bytes); });
+}
+
+// ---------------------------------------------------------------------------
+// flush / acquire / wait
+// ---------------------------------------------------------------------------
+
+VkCommandBuffer StagingArena::beginCommands(VulkanContext& ctx)
+{
+    VkCommandBufferAllocateInfo ai{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    ai.commandPool        = ctx.transferCommandPool;
+    ai.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    ai.commandBufferCount = 1;
+
+    VkCommandBuffer cmd;
+    vkAllocateCommandBuffers(ctx.device, &ai, &cmd);
+
+    VkCommandBufferBeginInfo bi{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmd, &bi);
+    ctx.profiler.open(cmd, ctx.transferQueueFamily);
+    return cmd;
+}
+
+// End `cmd`, submit it on the transfer queue and track it as the next batch
+void StagingArena::submit(VulkanContext& ctx, VkCommandBuffer cmd, bool usesRing)
+{
+    vkEndCommandBuffer(cmd);
+
+    const uint64_t ticket = nextTicket;
+    VkTimelineSemaphoreSubmitInfo timelineInfo{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues    = &ticket;
+
+    VkSubmitInfo si{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    si.pNext                = &timelineInfo;
+    si.commandBufferCount   = 1;
+    si.pCommandBuffers      = &cmd;
+    si.signalSemaphoreCount = 1;
+    si.pSignalSemaphores    = &timeline;
+    if (vkQueueSubmit(ctx.transferQueue, 1, &si, VK_NULL_HANDLE) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit staging uploads");
+    ctx.profiler.submitted(cmd, timeline, ticket);
+
+    lastTicket = nextTicket++;
+    inFlight.push_back({lastTicket, cmd, head, usesRing, std::move(pendingDedicated)});
+    if (usesRing)
+        ++ringBatches;
+    pendingDedicated.clear();
+    ++counters.submissions;
+}
+
+uint64_t StagingArena::flush(VulkanContext& ctx)
+{
+    CPU_ZONE("StagingArena::flush");
+    if (pending.empty())
+        return lastTicket;
+
+    VkCommandBuffer cmd   = beginCommands(ctx);
+    uint32_t        scope = ctx.profiler.begin(cmd, "upload");
+
+    // Runs of copies between the same two buffers go out as one command
+    std::vector<VkBufferCopy> regions;
+    for (size_t i = 0; i < pending.size();) {
+        regions.clear();
+        size_t j = i;
+        while (j < pending.size() && pending[j].src == pending[i].src && pending[j].dst == pending[i].dst)
+            regions.push_back(pending[j++].region);
+        vkCmdCopyBuffer(cmd, pending[i].src, pending[i].dst,
+                        static_cast<uint32_t>(regions.size()), regions.data());
+        counters.regions += regions.size();
+        if (crossFamily && std::find(released.begin(), released.end(), pending[i].dst) == released.end())
+            released.push_back(pending[i].dst);
+        i = j;
+    }
+    ctx.profiler.end(cmd, scope);
+
+    // On a separate family the release barrier in acquire() makes the writes
+    // available instead
+    if (!crossFamily) {
+        VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    submit(ctx, cmd, pendingRing);
+    pending.clear();
+    pendingRing = false;
+    return lastTicket;
+}
+
+uint64_t StagingArena::acquire(VulkanContext& ctx, VkCommandBuffer cmd)
+{
+    flush(ctx);
+    if (released.empty())
+        return 0;
+
+    // Release and acquire have to name the same ranges: whole buffers
+    std::vector<VkBufferMemoryBarrier> barriers(released.size());
+    for (size_t i = 0; i < released.size(); ++i) {
+        VkBufferMemoryBarrier& b = barriers[i];
+        b = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        b.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+        b.srcQueueFamilyIndex = ctx.transferQueueFamily;
+        b.dstQueueFamilyIndex = ctx.graphicsQueueFamily;
+        b.buffer              = released[i];
+        b.offset              = 0;
+        b.size                = VK_WHOLE_SIZE;
+    }
+
+    // Release on the transfer queue; queue order puts it after every batch
+    VkCommandBuffer releaseCmd = beginCommands(ctx);
+    vkCmdPipelineBarrier(releaseCmd,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    submit(ctx, releaseCmd, false);
+
+    // Acquire in the caller's graphics command buffer
+    for (VkBufferMemoryBarrier& b : barriers) {
+        b.srcAccessMask = 0;
+        b.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    }
+    vkCmdPipelineBarrier(cmd,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+
+    released.clear();
+    return lastTicket;
+}
+
+void StagingArena::wait(VulkanContext& ctx, uint64_t ticket)
+{
+    while (!inFlight.empty() && inFlight.front().ticket <= ticket)
+        retire(ctx, true);
+}
+
+// Retire finished batches in submission order; with `block`, wait for the
+// oldest one first
+void StagingArena::retire(VulkanContext& ctx, bool block)
+{
+    if (inFlight.empty())
+        return;
+
+    uint64_t completed = 0;
+    if (block) {
+        VkSemaphoreWaitInfo wi{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+        wi.semaphoreCount = 1;
+        wi.pSemaphores    = &timeline;
+        wi.pValues        = &inFlight.front().ticket;
+        vkWaitSemaphores(ctx.device, &wi, UINT64_MAX);
+    }
+    vkGetSemaphoreCounterValue(ctx.device, timeline, &completed);
+
+    if (inFlight.front().ticket <= completed)
+        ctx.profiler.collect(ctx);   // frees the batches' query blocks too
+
+    while (!inFlight.empty() && inFlight.front().ticket <= completed) {
+        Batch& b = inFlight.front();
+        vkFreeCommandBuffers(ctx.device, ctx.transferCommandPool, 1, &b.cmd);
+        for (Dedicated& d : b.dedicated)
+            vmaDestroyBuffer(ctx.allocator, d.buffer, d.allocation);
+        if (b.usesRing) {
+            tail = b.end;
+            --ringBatches;
+        }
+        inFlight.pop_front();
+    }
+}
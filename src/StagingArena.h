@@ -0,0 +1,126 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+class VulkanContext;
+
+// ---------------------------------------------------------------------------
+// StagingArena — ring of persistently mapped staging memory for uploads
+//
+// upload() suballocates from one host-visible buffer, lets the caller write
+// the data in place and queues a copy into the current batch. flush() submits
+// the whole batch as one command buffer on the transfer queue, signalling the
+// arena's timeline semaphore with the batch's ticket; its part of the ring is
+// reused once the semaphore has reached it, so the host only ever waits when
+// the ring is full.
+//
+// Graphics work consumes the uploads through acquire(). When the transfer
+// queue is the graphics family that is only a flush, since every batch ends
+// with a transfer -> all-commands barrier. With a separate transfer family
+// the buffers are exclusive to one family at a time: acquire() releases
+// everything written since the last call on the transfer queue, records the
+// matching acquire barriers into the graphics command buffer and returns the
+// timeline value that submission has to wait for. Once acquired a buffer
+// belongs to the graphics family; uploading into it again is not supported
+// (give streamed buffers VK_SHARING_MODE_CONCURRENT instead).
+//
+// Used from the thread that owns the VulkanContext only.
+// ---------------------------------------------------------------------------
+
+struct StagingStats {
+    uint64_t bytes       = 0;   // total bytes uploaded
+    uint64_t copies      = 0;   // upload() calls
+    uint64_t regions     = 0;   // VkBufferCopy regions recorded after merging
+    uint64_t submissions = 0;
+    uint64_t stalls      = 0;   // waits for ring space
+    uint64_t oversized   = 0;   // uploads larger than the ring (own staging buffer)
+};
+
+class StagingArena {
+public:
+    void init   (VulkanContext& ctx, VkDeviceSize capacity);
+    void destroy(VulkanContext& ctx);
+
+    // Queue `size` bytes for `dst` at `dstOffset`; `fill` writes them into
+    // staging memory (sequentially — it may be write-combined). Uploads larger
+    // than the ring get a staging buffer of their own for the batch.
+    void upload(VulkanContext& ctx, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size,
+                const std::function<void(void*)>& fill, VkDeviceSize alignment = 16);
+    void upload(VulkanContext& ctx, VkBuffer dst, VkDeviceSize dstOffset,
+                const void* data, VkDeviceSize size);
+
+    // Submit everything queued so far. Returns the batch's ticket for wait()
+    // (or the last ticket if nothing was queued).
+    uint64_t flush (VulkanContext& ctx);
+    void     wait  (VulkanContext& ctx, uint64_t ticket);
+    void     finish(VulkanContext& ctx) { wait(ctx, flush(ctx)); }
+
+    // Flush and hand the uploaded buffers to the graphics family, recording the
+    // acquire side into `cmd`. Returns the value of semaphore() the submission
+    // of `cmd` must wait for (at VK_PIPELINE_STAGE_ALL_COMMANDS_BIT), or 0 if
+    // queue order is enough.
+    uint64_t acquire(VulkanContext& ctx, VkCommandBuffer cmd);
+    bool     needsAcquire() const { return !pending.empty() || !released.empty(); }
+
+    VkSemaphore         semaphore() const { return timeline; }
+    VkDeviceSize        capacity()  const { return size; }
+    const StagingStats& stats()     const { return counters; }
+
+private:
+    struct Dedicated {
+        VkBuffer      buffer;
+        VmaAllocation allocation;
+    };
+
+    struct Copy {
+        VkBuffer     src;
+        VkBuffer     dst;
+        VkBufferCopy region;
+    };
+
+    struct Batch {
+        uint64_t               ticket;     // timeline value signalled on completion
+        VkCommandBuffer        cmd;
+        VkDeviceSize           end;        // ring head when submitted
+        bool                   usesRing;
+        std::vector<Dedicated> dedicated;
+    };
+
+    VkBuffer      buffer     = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    uint8_t*      mapped     = nullptr;
+    VkDeviceSize  size       = 0;
+
+    // In use: [tail, head), wrapping at `size`
+    VkDeviceSize  head = 0;
+    VkDeviceSize  tail = 0;
+
+    // Current, not yet submitted batch
+    std::vector<Copy>      pending;
+    std::vector<Dedicated> pendingDedicated;
+    bool                   pendingRing = false;   // pending copies use ring memory
+
+    // Buffers written on a separate transfer family since the last acquire()
+    std::vector<VkBuffer> released;
+    bool                  crossFamily = false;
+
+    std::deque<Batch>     inFlight;
+    uint32_t              ringBatches = 0;        // in-flight batches holding ring memory
+    VkSemaphore           timeline   = VK_NULL_HANDLE;
+    uint64_t              nextTicket = 1;
+    uint64_t              lastTicket = 0;
+
+    StagingStats counters;
+
+    bool ringEmpty() const { return ringBatches == 0 && !pendingRing; }
+    bool fits(VkDeviceSize bytes, VkDeviceSize alignment, VkDeviceSize& offset) const;
+    void retire(VulkanContext& ctx, bool block);
+    void submit(VulkanContext& ctx, VkCommandBuffer cmd, bool usesRing);
+    VkCommandBuffer beginCommands(VulkanContext& ctx);
+    void createMapped(VulkanContext& ctx, VkDeviceSize bytes, Dedicated& out, void*& ptr);
+};
@@ -3,8 +3,9 @@
 #include <vk_mem_alloc.h>
 
 #include "VulkanContext.h"
+#include "CpuProfiler.h"
 
-#include <fstream>
+#include <cassert>
 #include <iostream>
 #include <stdexcept>
 
@@ -29,7 +30,9 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 
 void VulkanContext::init(GLFWwindow* win, uint32_t width, uint32_t height)
 {
-    window = win;
+    CPU_ZONE("VulkanContext::init");
+    window   = win;
+    headless = (win == nullptr);
 
     // ------------------------------------------------------------------
     // Instance
@@ -40,6 +43,7 @@ void VulkanContext::init(GLFWwindow* win, uint32_t width, uint32_t height)
         .require_api_version(1, 2, 0)
         .request_validation_layers(true)
         .set_debug_callback(debugCallback)
+        .set_headless(headless)
         .build();
     if (!instResult)
         throw std::runtime_error("Failed to create Vulkan instance: " + instResult.error().message());
@@ -49,17 +53,19 @@ void VulkanContext::init(GLFWwindow* win, uint32_t width, uint32_t height)
     debugMessenger = vkbInstance.debug_messenger;
 
     // ------------------------------------------------------------------
-    // Surface
+    // Surface (windowed mode only)
     // ------------------------------------------------------------------
-    if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
+    if (!headless &&
+        glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
         throw std::runtime_error("Failed to create window surface");
 
     // ------------------------------------------------------------------
     // Physical device — require RT extensions
     // ------------------------------------------------------------------
     vkb::PhysicalDeviceSelector selector(vkbInstance);
+    if (!headless)
+        selector.set_surface(surface);
     auto physResult = selector
-        .set_surface(surface)
         .set_minimum_version(1, 2)
         .add_required_extension(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME)
         .add_required_extension(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME)
@@ -91,9 +97,12 @@ void VulkanContext::init(GLFWwindow* win, uint32_t width, uint32_t height)
         VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
     features12.bufferDeviceAddress                              = VK_TRUE;
     features12.descriptorIndexing                               = VK_TRUE;
+    features12.descriptorBindingPartiallyBound                  = VK_TRUE;
     features12.runtimeDescriptorArray                           = VK_TRUE;
     features12.shaderSampledImageArrayNonUniformIndexing        = VK_TRUE;
     features12.scalarBlockLayout                                = VK_TRUE;
+    features12.timelineSemaphore                                = VK_TRUE;
+    features12.hostQueryReset                                   = VK_TRUE;
 
     VkPhysicalDeviceAccelerationStructureFeaturesKHR asFeatures{
         VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR};
@@ -121,6 +130,29 @@ void VulkanContext::init(GLFWwindow* win, uint32_t width, uint32_t height)
     graphicsQueue       = qRes.value();
     graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+    // Transfer queue, falling back towards graphics (compute families can
+    // transfer too)
+    auto separateQueue = [&](vkb::QueueType type, bool dedicated, VkQueue& queue, uint32_t& family) {
+        auto q = dedicated ? vkbDevice.get_dedicated_queue(type)       : vkbDevice.get_queue(type);
+        auto i = dedicated ? vkbDevice.get_dedicated_queue_index(type) : vkbDevice.get_queue_index(type);
+        if (!q || !i || i.value() == graphicsQueueFamily)
+            return false;
+        queue  = q.value();
+        family = i.value();
+        return true;
+    };
+
+    if (!separateQueue(vkb::QueueType::transfer, true,  transferQueue, transferQueueFamily) &&
+        !separateQueue(vkb::QueueType::transfer, false, transferQueue, transferQueueFamily) &&
+        !separateQueue(vkb::QueueType::compute,  false, transferQueue, transferQueueFamily)) {
+        transferQueue       = graphicsQueue;
+        transferQueueFamily = graphicsQueueFamily;
+    }
+
+    std::cout << "[Vulkan] Queue families: graphics " << graphicsQueueFamily
+              << ", transfer " << transferQueueFamily
+              << (transferQueueFamily == graphicsQueueFamily ? " (shared)" : "") << '\n';
+
     // ------------------------------------------------------------------
     // Vulkan Memory Allocator
     // ------------------------------------------------------------------
@@ -140,17 +172,47 @@ void VulkanContext::init(GLFWwindow* win, uint32_t width, uint32_t height)
         throw std::runtime_error("Failed to create VMA allocator");
 
     // ------------------------------------------------------------------
-    // Command pool
+    // Command pools — one per queue family in use
     // ------------------------------------------------------------------
-    VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
-    poolInfo.queueFamilyIndex = graphicsQueueFamily;
-    poolInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool);
+    auto createPool = [&](uint32_t family) {
+        VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        poolInfo.queueFamilyIndex = family;
+        poolInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        VkCommandPool pool;
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create command pool");
+        return pool;
+    };
+    commandPool         = createPool(graphicsQueueFamily);
+    transferCommandPool = transferQueueFamily == graphicsQueueFamily ? commandPool
+                                                                     : createPool(transferQueueFamily);
+
+    profiler.init(*this);
+
+    // Staging ring shared by all uploads
+    staging.init(*this, stagingSize);
+
+    // Graphics timeline for frame pacing and one-off submissions
+    VkSemaphoreTypeCreateInfo typeInfo{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue  = 0;
+    VkSemaphoreCreateInfo semInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    semInfo.pNext = &typeInfo;
+    if (vkCreateSemaphore(device, &semInfo, nullptr, &graphicsTimeline) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create graphics timeline semaphore");
+    graphicsSubmitted = 0;
+
+    // parseArgs rejects anything else
+    assert(framesInFlight >= 1 && framesInFlight <= MAX_FRAMES_IN_FLIGHT);
+    std::cout << "[Vulkan] " << framesInFlight << " frame(s) in flight\n";
 
     // ------------------------------------------------------------------
-    // Swapchain
+    // Swapchain — headless rendering goes straight to the storage image
     // ------------------------------------------------------------------
-    createSwapchain(width, height);
+    if (headless)
+        renderExtent = {width, height};
+    else
+        createSwapchain(width, height);
 
     // ------------------------------------------------------------------
     // Load KHR RT function pointers
@@ -184,6 +246,7 @@ void VulkanContext::createSwapchain(uint32_t width, uint32_t height)
     swapchainExtent   = vkbSwapchain.extent;
     swapchainImages   = vkbSwapchain.get_images().value();
     swapchainImageViews = vkbSwapchain.get_image_views().value();
+    renderExtent        = swapchainExtent;
 }
 
 // ---------------------------------------------------------------------------
@@ -207,6 +270,8 @@ void VulkanContext::loadRTFunctions()
     load(rt.createRayTracingPipelines,             "vkCreateRayTracingPipelinesKHR");
     load(rt.getRayTracingShaderGroupHandles,       "vkGetRayTracingShaderGroupHandlesKHR");
     load(rt.cmdTraceRays,                          "vkCmdTraceRaysKHR");
+    load(rt.cmdWriteAccelerationStructuresProperties, "vkCmdWriteAccelerationStructuresPropertiesKHR");
+    load(rt.cmdCopyAccelerationStructure,          "vkCmdCopyAccelerationStructureKHR");
 }
 
 // ---------------------------------------------------------------------------
@@ -305,44 +370,106 @@ VkCommandBuffer VulkanContext::beginSingleTimeCommands()
     VkCommandBufferBeginInfo bi{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
     bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     vkBeginCommandBuffer(cmd, &bi);
+    profiler.open(cmd, graphicsQueueFamily);
     return cmd;
 }
 
 void VulkanContext::endSingleTimeCommands(VkCommandBuffer cmd)
 {
+    CPU_ZONE("endSingleTimeCommands");
     vkEndCommandBuffer(cmd);
 
-    VkSubmitInfo si{VK_STRUCTURE_TYPE_SUBMIT_INFO};
-    si.commandBufferCount = 1;
-    si.pCommandBuffers    = &cmd;
+    // Uploads queued so far go first; buffers filled on a separate transfer
+    // family are acquired in a command buffer ahead of `cmd`
+    VkCommandBuffer cmds[2];
+    uint32_t        cmdCount  = 0;
+    uint64_t        uploadValue = 0;
+    staging.flush(*this);
+    if (staging.needsAcquire()) {
+        VkCommandBuffer acquireCmd = beginSingleTimeCommands();
+        uploadValue = staging.acquire(*this, acquireCmd);
+        vkEndCommandBuffer(acquireCmd);
+        cmds[cmdCount++] = acquireCmd;
+    }
+    cmds[cmdCount++] = cmd;
 
-    vkQueueSubmit(graphicsQueue, 1, &si, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
-    vkFreeCommandBuffers(device, commandPool, 1, &cmd);
+    SemaphoreWait upload{staging.semaphore(), uploadValue, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+    waitGraphics(submitGraphics(cmds, cmdCount, &upload, uploadValue != 0 ? 1 : 0));
+    profiler.collect(*this);
+    vkFreeCommandBuffers(device, commandPool, cmdCount, cmds);
 }
 
 // ---------------------------------------------------------------------------
-// Shader module
+// Graphics timeline
 // ---------------------------------------------------------------------------
 
-VkShaderModule VulkanContext::loadShaderModule(const std::string& path)
+uint64_t VulkanContext::submitGraphics(const VkCommandBuffer* cmds, uint32_t cmdCount,
+                                       const SemaphoreWait* waits, uint32_t waitCount,
+                                       VkSemaphore signalBinary)
 {
-    std::ifstream file(path, std::ios::ate | std::ios::binary);
-    if (!file.is_open())
-        throw std::runtime_error("Cannot open shader: " + path);
+    std::vector<VkSemaphore>          waitSems(waitCount);
+    std::vector<uint64_t>             waitValues(waitCount);
+    std::vector<VkPipelineStageFlags> waitStages(waitCount);
+    for (uint32_t i = 0; i < waitCount; ++i) {
+        waitSems[i]   = waits[i].semaphore;
+        waitValues[i] = waits[i].value;
+        waitStages[i] = waits[i].stage;
+    }
 
-    size_t            size = static_cast<size_t>(file.tellg());
-    std::vector<char> code(size);
-    file.seekg(0);
-    file.read(code.data(), size);
+    const uint64_t value = graphicsSubmitted + 1;
+    VkSemaphore signalSems[2]   = {graphicsTimeline, signalBinary};
+    uint64_t    signalValues[2] = {value, 0};
 
+    VkTimelineSemaphoreSubmitInfo timelineInfo{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    timelineInfo.waitSemaphoreValueCount   = waitCount;
+    timelineInfo.pWaitSemaphoreValues      = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = signalBinary != VK_NULL_HANDLE ? 2 : 1;
+    timelineInfo.pSignalSemaphoreValues    = signalValues;
+
+    VkSubmitInfo si{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    si.pNext                = &timelineInfo;
+    si.waitSemaphoreCount   = waitCount;
+    si.pWaitSemaphores      = waitSems.data();
+    si.pWaitDstStageMask    = waitStages.data();
+    si.commandBufferCount   = cmdCount;
+    si.pCommandBuffers      = cmds;
+    si.signalSemaphoreCount = timelineInfo.signalSemaphoreValueCount;
+    si.pSignalSemaphores    = signalSems;
+    if (vkQueueSubmit(graphicsQueue, 1, &si, VK_NULL_HANDLE) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit to the graphics queue");
+
+    for (uint32_t i = 0; i < cmdCount; ++i)
+        profiler.submitted(cmds[i], graphicsTimeline, value);
+
+    graphicsSubmitted = value;
+    return value;
+}
+
+void VulkanContext::waitGraphics(uint64_t value)
+{
+    if (value == 0)
+        return;
+
+    VkSemaphoreWaitInfo wi{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    wi.semaphoreCount = 1;
+    wi.pSemaphores    = &graphicsTimeline;
+    wi.pValues        = &value;
+    vkWaitSemaphores(device, &wi, UINT64_MAX);
+}
+
+// ---------------------------------------------------------------------------
+// Shader module
+// ---------------------------------------------------------------------------
+
+VkShaderModule VulkanContext::createShaderModule(const SpirvModule& spirv)
+{
     VkShaderModuleCreateInfo info{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
-    info.codeSize = size;
-    info.pCode    = reinterpret_cast<const uint32_t*>(code.data());
+    info.codeSize = spirv.bytes();
+    info.pCode    = spirv.code;
 
     VkShaderModule mod;
     if (vkCreateShaderModule(device, &info, nullptr, &mod) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create shader module: " + path);
+        throw std::runtime_error(std::string("Failed to create shader module: ") + spirv.name);
     return mod;
 }
 
@@ -367,11 +494,18 @@ void VulkanContext::destroy()
 
     for (auto& view : swapchainImageViews)
         vkDestroyImageView(device, view, nullptr);
-    vkb::destroy_swapchain(vkbSwapchain);
-
+    if (swapchain != VK_NULL_HANDLE)
+        vkb::destroy_swapchain(vkbSwapchain);
+
+    staging.destroy(*this);
+    profiler.destroy(*this);
+    vkDestroySemaphore(device, graphicsTimeline, nullptr);
+    if (transferCommandPool != commandPool)
+        vkDestroyCommandPool(device, transferCommandPool, nullptr);
     vkDestroyCommandPool(device, commandPool, nullptr);
     vmaDestroyAllocator(allocator);
     vkb::destroy_device(vkbDevice);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (surface != VK_NULL_HANDLE)
+        vkDestroySurfaceKHR(instance, surface, nullptr);
     vkb::destroy_instance(vkbInstance);
 }
@@ -5,10 +5,17 @@
 #include <vk_mem_alloc.h>
 #include <GLFW/glfw3.h>
 
+#include "EmbeddedShaders.h"
+#include "GpuProfiler.h"
+#include "StagingArena.h"
+
 #include <vector>
 #include <string>
 #include <stdexcept>
 
+// Upper bound for VulkanContext::framesInFlight
+static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 8;
+
 // ---------------------------------------------------------------------------
 // Resource wrappers
 // ---------------------------------------------------------------------------
@@ -38,6 +45,8 @@ struct RTFunctions {
     PFN_vkCreateRayTracingPipelinesKHR             createRayTracingPipelines            = nullptr;
     PFN_vkGetRayTracingShaderGroupHandlesKHR       getRayTracingShaderGroupHandles      = nullptr;
     PFN_vkCmdTraceRaysKHR                          cmdTraceRays                         = nullptr;
+    PFN_vkCmdWriteAccelerationStructuresPropertiesKHR cmdWriteAccelerationStructuresProperties = nullptr;
+    PFN_vkCmdCopyAccelerationStructureKHR          cmdCopyAccelerationStructure         = nullptr;
 };
 
 // ---------------------------------------------------------------------------
@@ -46,7 +55,8 @@ struct RTFunctions {
 
 class VulkanContext {
 public:
-    GLFWwindow* window = nullptr;
+    GLFWwindow* window   = nullptr;
+    bool        headless = false;   // no window, surface or swapchain
 
     VkInstance               instance       = VK_NULL_HANDLE;
     VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
@@ -57,8 +67,35 @@ public:
     VkQueue  graphicsQueue      = VK_NULL_HANDLE;
     uint32_t graphicsQueueFamily = 0;
 
+    // Transfer: a dedicated transfer family if there is one, else a separate
+    // compute family, else the graphics queue; compare families to see
+    // whether it is separate.
+    VkQueue  transferQueue       = VK_NULL_HANDLE;
+    uint32_t transferQueueFamily = 0;
+
     VmaAllocator   allocator    = VK_NULL_HANDLE;
-    VkCommandPool  commandPool  = VK_NULL_HANDLE;
+    VkCommandPool  commandPool  = VK_NULL_HANDLE;           // graphics family
+    VkCommandPool  transferCommandPool = VK_NULL_HANDLE;    // == commandPool when shared
+
+    // Batched buffer uploads on the transfer queue (see StagingArena.h); size
+    // set before init()
+    StagingArena   staging;
+    VkDeviceSize   stagingSize  = 64ull << 20;
+
+    // Frames the CPU may record ahead of the GPU; per-frame resources (command
+    // buffers, UBOs, TLAS instance buffers) are allocated this many times.
+    // More hides GPU bubbles, fewer cuts input latency. Set before init();
+    // must be in [1, MAX_FRAMES_IN_FLIGHT].
+    uint32_t       framesInFlight = 2;
+
+    // GPU pass timings (see GpuProfiler.h); enable before init()
+    GpuProfiler    profiler;
+
+    // Graphics timeline: every submitGraphics() signals the next value, so a
+    // frame, a one-off command buffer or an AS build is "done" once the
+    // counter has reached the value its submission returned.
+    VkSemaphore    graphicsTimeline  = VK_NULL_HANDLE;
+    uint64_t       graphicsSubmitted = 0;   // value of the latest submission
 
     // Swapchain
     VkSwapchainKHR           swapchain      = VK_NULL_HANDLE;
@@ -67,13 +104,17 @@ public:
     std::vector<VkImage>     swapchainImages;
     std::vector<VkImageView> swapchainImageViews;
 
+    // Resolution the ray tracer renders at: the swapchain extent in windowed
+    // mode, or the requested size when running headless.
+    VkExtent2D               renderExtent{};
+
     // Hardware RT properties (pipeline + acceleration structure)
     VkPhysicalDeviceRayTracingPipelinePropertiesKHR   rtPipelineProperties{};
     VkPhysicalDeviceAccelerationStructurePropertiesKHR asProperties{};
 
     RTFunctions rt;
 
-    // Lifecycle
+    // Lifecycle — pass win = nullptr to run headless (offscreen only)
     void init(GLFWwindow* win, uint32_t width, uint32_t height);
     void destroy();
 
@@ -87,12 +128,30 @@ public:
                                 VkFormat format, VkImageUsageFlags usage);
     void            destroyImage(AllocatedImage& img);
 
-    // Single-use command buffer helpers
+    // Single-use graphics command buffer helpers. The submit first acquires
+    // every upload queued on the staging arena, so the commands see them, and
+    // waits for the commands on the graphics timeline. Profiler scopes may be
+    // recorded into the command buffer.
     VkCommandBuffer beginSingleTimeCommands();
     void            endSingleTimeCommands(VkCommandBuffer cmd);
 
-    // Shader module from a SPIR-V file
-    VkShaderModule loadShaderModule(const std::string& path);
+    // Graphics queue submission signalling the timeline (plus `signalBinary`,
+    // e.g. for present). Waits on binary semaphores ignore `value`. Returns
+    // the timeline value that marks completion; opened profiler command
+    // buffers are tied to it.
+    struct SemaphoreWait {
+        VkSemaphore          semaphore;
+        uint64_t             value;
+        VkPipelineStageFlags stage;
+    };
+    uint64_t submitGraphics(const VkCommandBuffer* cmds, uint32_t cmdCount,
+                            const SemaphoreWait* waits = nullptr, uint32_t waitCount = 0,
+                            VkSemaphore signalBinary = VK_NULL_HANDLE);
+    // Block until the graphics timeline reaches `value` (0 returns at once)
+    void     waitGraphics(uint64_t value);
+
+    // Shader module from embedded SPIR-V
+    VkShaderModule createShaderModule(const SpirvModule& spirv);
 
     // Buffer device address (Vulkan 1.2 core)
     VkDeviceAddress getBufferAddress(VkBuffer buffer);
@@ -0,0 +1,340 @@
+#include "WideBvh.h"
+#include "WideBvhKernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(RT_WIDEBVH_SIMD) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// build — greedy collapse: open the largest-area interior child until the
+// node holds WIDTH children or only leaves remain
+// ---------------------------------------------------------------------------
+
+void WideBvh::build(const Bvh& binary)
+{
+    nodes.clear();
+    depth       = 0;
+    primIndices = binary.primIndices;
+    if (binary.empty())
+        return;
+
+    if (primIndices.size() > FIRST_MASK)
+        throw std::runtime_error("WideBvh: too many primitives for the leaf encoding");
+
+    nodes.reserve(binary.nodes.size() / 4 + 1);
+    collapse(binary, 0, 1);
+
+    // Every wide level consumes at least one binary level, so this only
+    // trips on a binary tree that broke Bvh's own depth cap
+    if (depth > Bvh::MAX_DEPTH)
+        throw std::runtime_error("WideBvh: tree deeper than the traversal stack allows");
+}
+
+uint32_t WideBvh::collapse(const Bvh& binary, uint32_t binaryNode, uint32_t level)
+{
+    depth = std::max(depth, level);
+
+    auto area = [&](uint32_t n) {
+        Aabb b;
+        b.min = binary.nodes[n].boundsMin;
+        b.max = binary.nodes[n].boundsMax;
+        return b.area();
+    };
+
+    // Gather up to WIDTH binary subtrees under this wide node
+    uint32_t children[WIDTH];
+    uint32_t childCount = 0;
+    const BvhNode& root = binary.nodes[binaryNode];
+    if (root.isLeaf()) {
+        children[childCount++] = binaryNode;
+    } else {
+        children[childCount++] = root.leftOrFirst;
+        children[childCount++] = root.leftOrFirst + 1;
+    }
+
+    while (childCount < WIDTH) {
+        int   best     = -1;
+        float bestArea = -1.0f;
+        for (uint32_t i = 0; i < childCount; ++i) {
+            if (binary.nodes[children[i]].isLeaf()) continue;
+            float a = area(children[i]);
+            if (a > bestArea) { bestArea = a; best = static_cast<int>(i); }
+        }
+        if (best < 0) break;
+
+        uint32_t opened          = children[best];
+        children[best]           = binary.nodes[opened].leftOrFirst;
+        children[childCount++]   = binary.nodes[opened].leftOrFirst + 1;
+    }
+
+    const uint32_t nodeIdx = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    // ---- Quantization frame -----------------------------------------------
+    {
+        Node& node = nodes[nodeIdx];
+        node.origin    = root.boundsMin;
+        node.validMask = 0;
+
+        glm::vec3 extent = root.boundsMax - root.boundsMin;
+        for (int a = 0; a < 3; ++a) {
+            int e = extent[a] > 0.0f
+                  ? static_cast<int>(std::ceil(std::log2(extent[a] / 255.0f)))
+                  : -126;
+            while (std::ldexp(255.0f, e) < extent[a]) ++e;
+            node.exponent[a] = static_cast<int8_t>(std::clamp(e, -126, 127));
+        }
+
+        for (uint32_t i = 0; i < WIDTH; ++i) {
+            for (int a = 0; a < 3; ++a) { node.qlo[a][i] = 255; node.qhi[a][i] = 0; }
+            node.child[i] = 0;
+        }
+
+        for (uint32_t i = 0; i < childCount; ++i) {
+            const BvhNode& c = binary.nodes[children[i]];
+            for (int a = 0; a < 3; ++a) {
+                const float scale = std::ldexp(1.0f, node.exponent[a]);
+                float lo = std::floor((c.boundsMin[a] - node.origin[a]) / scale);
+                float hi = std::ceil ((c.boundsMax[a] - node.origin[a]) / scale);
+                // Stay conservative against rounding in the subtraction
+                while (lo > 0.0f   && node.origin[a] + lo * scale > c.boundsMin[a]) lo -= 1.0f;
+                while (hi < 255.0f && node.origin[a] + hi * scale < c.boundsMax[a]) hi += 1.0f;
+                node.qlo[a][i] = static_cast<uint8_t>(std::clamp(lo, 0.0f, 255.0f));
+                node.qhi[a][i] = static_cast<uint8_t>(std::clamp(hi, 0.0f, 255.0f));
+            }
+            node.validMask |= uint8_t(1u << i);
+        }
+    }
+
+    // ---- Children (recursion may reallocate `nodes`, so index by nodeIdx) -
+    for (uint32_t i = 0; i < childCount; ++i) {
+        const BvhNode& c = binary.nodes[children[i]];
+        uint32_t encoded;
+        if (c.isLeaf())
+            encoded = LEAF_BIT | ((c.count - 1) << 28) | c.leftOrFirst;
+        else
+            encoded = collapse(binary, children[i], level + 1);
+        nodes[nodeIdx].child[i] = encoded;
+    }
+    return nodeIdx;
+}
+
+// ---------------------------------------------------------------------------
+// Slab test for all eight children of a node. The scalar kernel is always
+// built; the SIMD ones (WideBvhKernels.h) are picked by CPUID at run time.
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// 2^e for e in [-126, 127], built directly from the exponent bits
+inline float exp2i(int e)
+{
+    uint32_t bits = static_cast<uint32_t>(e + 127) << 23;
+    float    f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+uint32_t slabTestScalar(const WideBvh::Node& node, const float scale[3], const float offset[3],
+                        float tMin, float tMax, float tNearOut[WideBvh::WIDTH])
+{
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < WideBvh::WIDTH; ++i) {
+        float tNear = tMin, tFar = tMax;
+        for (int a = 0; a < 3; ++a) {
+            float t0 = node.qlo[a][i] * scale[a] + offset[a];
+            float t1 = node.qhi[a][i] * scale[a] + offset[a];
+            tNear = std::max(tNear, std::min(t0, t1));
+            tFar  = std::min(tFar,  std::max(t0, t1));
+        }
+        tNearOut[i] = tNear;
+        if (tNear <= tFar) mask |= 1u << i;
+    }
+    return mask & node.validMask;
+}
+
+enum class Kernel { Scalar, Sse41, Avx2 };
+
+Kernel detectKernel()
+{
+#if defined(RT_WIDEBVH_SIMD)
+    // AVX2 also needs the OS to save YMM state (OSXSAVE + XCR0 bits 1 and 2)
+    unsigned int r1[4] = {}, r7[4] = {};
+    unsigned long long xcr0 = 0;
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    const unsigned int maxLeaf = static_cast<unsigned int>(regs[0]);
+    __cpuid(regs, 1);
+    for (int i = 0; i < 4; ++i) r1[i] = static_cast<unsigned int>(regs[i]);
+    if (maxLeaf >= 7) {
+        __cpuidex(regs, 7, 0);
+        for (int i = 0; i < 4; ++i) r7[i] = static_cast<unsigned int>(regs[i]);
+    }
+    if (r1[2] & (1u << 27))
+        xcr0 = _xgetbv(0);
+#else
+    const unsigned int maxLeaf = __get_cpuid_max(0, nullptr);
+    __cpuid(1, r1[0], r1[1], r1[2], r1[3]);
+    if (maxLeaf >= 7)
+        __cpuid_count(7, 0, r7[0], r7[1], r7[2], r7[3]);
+    if (r1[2] & (1u << 27)) {
+        unsigned int lo, hi;
+        __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        xcr0 = (static_cast<unsigned long long>(hi) << 32) | lo;
+    }
+#endif
+    const bool ymm   = (xcr0 & 6) == 6;
+    const bool fma   = (r1[2] & (1u << 12)) != 0;
+    const bool sse41 = (r1[2] & (1u << 19)) != 0;
+    const bool avx2  = (r7[1] & (1u << 5))  != 0;
+    if (avx2 && fma && ymm) return Kernel::Avx2;
+    if (sse41)              return Kernel::Sse41;
+#endif
+    return Kernel::Scalar;
+}
+
+// RT_WIDEBVH_KERNEL=sse4.1 or scalar caps the choice, so the narrower
+// kernels can be tested on a machine that has AVX2
+Kernel activeKernel()
+{
+    static const Kernel kernel = [] {
+        Kernel k = detectKernel();
+        if (const char* cap = std::getenv("RT_WIDEBVH_KERNEL")) {
+            if (!std::strcmp(cap, "scalar"))
+                k = Kernel::Scalar;
+            else if (!std::strcmp(cap, "sse4.1") && k == Kernel::Avx2)
+                k = Kernel::Sse41;
+        }
+        return k;
+    }();
+    return kernel;
+}
+
+inline uint32_t lowestSetBit(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward(&i, mask);
+    return static_cast<uint32_t>(i);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+}
+
+} // namespace
+
+const char* WideBvh::kernelName()
+{
+    switch (activeKernel()) {
+    case Kernel::Avx2:  return "AVX2";
+    case Kernel::Sse41: return "SSE4.1";
+    default:            return "scalar";
+    }
+}
+
+// ---------------------------------------------------------------------------
+// traverse — ordered, stack-based; children are pushed far-to-near
+// ---------------------------------------------------------------------------
+
+template <bool AnyHit, WideBvh::SlabTestFn SlabTest>
+bool WideBvh::traverse(const MeshGeometry& geo, const glm::vec3& origin, const glm::vec3& dir,
+                       float tMin, float tMax, TriangleHit* hit) const
+{
+    if (nodes.empty())
+        return false;
+
+    struct Entry { uint32_t child; float tNear; };
+    Entry stack[STACK_SIZE];
+    int   sp = 0;
+    stack[sp++] = {0, tMin};
+
+    const glm::vec3 invDir = safeInverse(dir);
+    bool found = false;
+
+    while (sp > 0) {
+        const Entry e = stack[--sp];
+        if (e.tNear > tMax) continue;
+
+        if (e.child & LEAF_BIT) {
+            const uint32_t first = e.child & FIRST_MASK;
+            const uint32_t count = ((e.child >> 28) & 7u) + 1;
+            for (uint32_t i = first; i < first + count; ++i) {
+                const uint32_t prim = primIndices[i];
+                const glm::vec3& p0 = geo.vertices[geo.indices[prim * 3 + 0]].pos;
+                const glm::vec3& p1 = geo.vertices[geo.indices[prim * 3 + 1]].pos;
+                const glm::vec3& p2 = geo.vertices[geo.indices[prim * 3 + 2]].pos;
+                float t, u, v;
+                if (!intersectTriangle(origin, dir, p0, p1, p2, tMin, tMax, t, u, v))
+                    continue;
+                if (AnyHit) return true;
+                tMax  = t;
+                *hit  = {t, u, v, prim};
+                found = true;
+            }
+            continue;
+        }
+
+        // Child box plane a, slot i:  t = q[a][i] * scale[a] + offset[a]
+        const Node& node = nodes[e.child];
+        float scale[3], offset[3];
+        for (int a = 0; a < 3; ++a) {
+            scale[a]  = invDir[a] * exp2i(node.exponent[a]);
+            offset[a] = (node.origin[a] - origin[a]) * invDir[a];
+        }
+        float    tNear[WIDTH];
+        uint32_t mask = SlabTest(node, scale, offset, tMin, tMax, tNear);
+        if (!mask) continue;
+
+        // Insertion-sort the hit children by distance, farthest first, so
+        // the nearest child ends up on top of the stack.
+        Entry hits[WIDTH];
+        int   n = 0;
+        for (; mask; mask &= mask - 1) {
+            uint32_t i = lowestSetBit(mask);
+            Entry    c{node.child[i], tNear[i]};
+            int j = n++;
+            while (j > 0 && hits[j - 1].tNear < c.tNear) { hits[j] = hits[j - 1]; --j; }
+            hits[j] = c;
+        }
+        assert(sp + n <= static_cast<int>(STACK_SIZE));
+        for (int i = 0; i < n; ++i)
+            stack[sp++] = hits[i];
+    }
+    return found;
+}
+
+// One kernel switch per ray; inside the loop the slab test is a direct call
+bool WideBvh::intersect(const MeshGeometry& geo, const glm::vec3& origin, const glm::vec3& dir,
+                        float tMin, float tMax, TriangleHit& hit) const
+{
+    switch (activeKernel()) {
+#if defined(RT_WIDEBVH_SIMD)
+    case Kernel::Avx2:  return traverse<false, slabTestAvx2> (geo, origin, dir, tMin, tMax, &hit);
+    case Kernel::Sse41: return traverse<false, slabTestSse41>(geo, origin, dir, tMin, tMax, &hit);
+#endif
+    default:            return traverse<false, slabTestScalar>(geo, origin, dir, tMin, tMax, &hit);
+    }
+}
+
+bool WideBvh::occluded(const MeshGeometry& geo, const glm::vec3& origin, const glm::vec3& dir,
+                       float tMin, float tMax) const
+{
+    switch (activeKernel()) {
+#if defined(RT_WIDEBVH_SIMD)
+    case Kernel::Avx2:  return traverse<true, slabTestAvx2> (geo, origin, dir, tMin, tMax, nullptr);
+    case Kernel::Sse41: return traverse<true, slabTestSse41>(geo, origin, dir, tMin, tMax, nullptr);
+#endif
+    default:            return traverse<true, slabTestScalar>(geo, origin, dir, tMin, tMax, nullptr);
+    }
+}
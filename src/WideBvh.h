@@ -0,0 +1,96 @@
+#pragma once
+#include "Bvh.h"
+#include "types.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// WideBvh — 8-wide BVH with 8-bit quantized child bounds
+//
+// Collapsed from a binary Bvh. Each node stores its own bounds origin and a
+// power-of-two scale per axis; the eight child boxes are stored as bytes
+// relative to that frame, so one 96-byte node replaces up to seven 32-byte
+// binary nodes and all eight slab tests run in one AVX2 pass (two SSE4.1
+// passes, or a scalar loop), whichever the CPU running it supports.
+//
+// Triangles are fetched straight from the flattened Vertex / index arrays
+// produced by Scene::flatten — the same data Scene::uploadToGPU sends to
+// the GPU — so no second copy of the geometry is kept.
+// ---------------------------------------------------------------------------
+
+// Mesh view into the flattened arrays (already offset by the mesh's
+// MeshRange::vertexOffset / indexOffset)
+struct MeshGeometry {
+    const Vertex*   vertices = nullptr;
+    const uint32_t* indices  = nullptr;
+};
+
+struct TriangleHit {
+    float    t    = 0.0f;
+    float    u    = 0.0f;   // barycentric weight of v1
+    float    v    = 0.0f;   // barycentric weight of v2
+    uint32_t prim = ~0u;    // triangle index within the mesh (gl_PrimitiveID)
+};
+
+class WideBvh {
+public:
+    static constexpr uint32_t WIDTH = 8;
+
+    struct alignas(32) Node {
+        glm::vec3 origin;              // lower corner of the node bounds
+        int8_t    exponent[3];         // child box scale per axis = 2^exponent
+        uint8_t   validMask;           // bit i set if child slot i is used
+        uint8_t   qlo[3][WIDTH];       // quantized child min, per axis
+        uint8_t   qhi[3][WIDTH];       // quantized child max, per axis
+        uint32_t  child[WIDTH];        // node index, or LEAF_BIT | (count-1) << 28 | first
+    };
+    static_assert(sizeof(Node) == 96, "WideBvh::Node is expected to be 96 bytes");
+
+    static constexpr uint32_t LEAF_BIT   = 0x80000000u;
+    static constexpr uint32_t FIRST_MASK = 0x0FFFFFFFu;
+
+    std::vector<Node>     nodes;        // nodes[0] is the root
+    std::vector<uint32_t> primIndices;  // copied from the source Bvh
+    uint32_t              depth = 0;    // wide levels, root = 1; never above Bvh::MAX_DEPTH
+
+    // Traversal pops a node and pushes up to WIDTH children, so a node at
+    // depth d is reached with at most 7 (d - 1) pending entries and leaves
+    // at most 7 d + 1 behind
+    static constexpr uint32_t STACK_SIZE = (WIDTH - 1) * Bvh::MAX_DEPTH + 1;
+
+    // Slab test against all eight children (see WideBvhKernels.h)
+    using SlabTestFn = uint32_t (*)(const Node& node, const float scale[3], const float offset[3],
+                                    float tMin, float tMax, float tNearOut[WIDTH]);
+
+    // Collapse a built binary BVH (leaves must hold at most 8 primitives).
+    // Throws if the result is deeper than Bvh::MAX_DEPTH.
+    void build(const Bvh& binary);
+
+    // Closest hit; tMax is narrowed to the hit distance on success.
+    bool intersect(const MeshGeometry& geo, const glm::vec3& origin, const glm::vec3& dir,
+                   float tMin, float tMax, TriangleHit& hit) const;
+
+    // Any hit (shadow rays)
+    bool occluded (const MeshGeometry& geo, const glm::vec3& origin, const glm::vec3& dir,
+                   float tMin, float tMax) const;
+
+    bool   empty()       const { return nodes.empty(); }
+    size_t memoryBytes() const { return nodes.size() * sizeof(Node)
+                                      + primIndices.size() * sizeof(uint32_t); }
+
+    // Name of the slab-test kernel picked for this CPU ("AVX2", "SSE4.1" or
+    // "scalar"); the environment variable RT_WIDEBVH_KERNEL=sse4.1 / scalar
+    // caps it
+    static const char* kernelName();
+
+private:
+    uint32_t collapse(const Bvh& binary, uint32_t binaryNode, uint32_t level);
+
+    template <bool AnyHit, SlabTestFn SlabTest>
+    bool traverse(const MeshGeometry& geo, const glm::vec3& origin, const glm::vec3& dir,
+                  float tMin, float tMax, TriangleHit* hit) const;
+};
@@ -0,0 +1,28 @@
+// Built with -mavx2 -mfma (/arch:AVX2); called only once CPUID reports AVX2 + FMA
+#include "WideBvhKernels.h"
+
+#if defined(RT_WIDEBVH_SIMD)
+#include <immintrin.h>
+
+uint32_t slabTestAvx2(const WideBvh::Node& node, const float scale[3], const float offset[3],
+                      float tMin, float tMax, float tNearOut[WideBvh::WIDTH])
+{
+    __m256 tNear = _mm256_set1_ps(tMin);
+    __m256 tFar  = _mm256_set1_ps(tMax);
+    for (int a = 0; a < 3; ++a) {
+        __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(node.qlo[a]))));
+        __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(node.qhi[a]))));
+        __m256 s  = _mm256_set1_ps(scale[a]);
+        __m256 o  = _mm256_set1_ps(offset[a]);
+        __m256 t0 = _mm256_fmadd_ps(lo, s, o);
+        __m256 t1 = _mm256_fmadd_ps(hi, s, o);
+        tNear = _mm256_max_ps(tNear, _mm256_min_ps(t0, t1));
+        tFar  = _mm256_min_ps(tFar,  _mm256_max_ps(t0, t1));
+    }
+    _mm256_storeu_ps(tNearOut, tNear);
+    return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ)))
+         & node.validMask;
+}
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+#include "WideBvh.h"
+
+#include <cstdint>
+
+// ---------------------------------------------------------------------------
+// WideBvh SIMD slab-test kernels, one translation unit per instruction set
+//
+// WideBvhAvx2.cpp and WideBvhSse41.cpp are the only files built with ISA
+// flags (CMakeLists.txt defines RT_WIDEBVH_SIMD when it adds them); WideBvh
+// picks a kernel at run time from CPUID. The kernels read nothing but the
+// node's byte arrays and plain floats, so no shared inline function is ever
+// emitted with AVX2 code and linked into paths that run without it.
+// ---------------------------------------------------------------------------
+
+#if defined(RT_WIDEBVH_SIMD)
+// Both match WideBvh::SlabTestFn:  t = q[a][i] * scale[a] + offset[a]
+uint32_t slabTestAvx2 (const WideBvh::Node& node, const float scale[3], const float offset[3],
+                       float tMin, float tMax, float tNearOut[WideBvh::WIDTH]);
+uint32_t slabTestSse41(const WideBvh::Node& node, const float scale[3], const float offset[3],
+                       float tMin, float tMax, float tNearOut[WideBvh::WIDTH]);
+#endif
@@ -0,0 +1,34 @@
+// Built with -msse4.1; called only once CPUID reports SSE4.1
+#include "WideBvhKernels.h"
+
+#if defined(RT_WIDEBVH_SIMD)
+#include <smmintrin.h>
+
+#include <cstring>
+
+uint32_t slabTestSse41(const WideBvh::Node& node, const float scale[3], const float offset[3],
+                       float tMin, float tMax, float tNearOut[WideBvh::WIDTH])
+{
+    uint32_t mask = 0;
+    for (int half = 0; half < 2; ++half) {
+        __m128 tNear = _mm_set1_ps(tMin);
+        __m128 tFar  = _mm_set1_ps(tMax);
+        for (int a = 0; a < 3; ++a) {
+            int loBytes, hiBytes;
+            std::memcpy(&loBytes, node.qlo[a] + half * 4, 4);
+            std::memcpy(&hiBytes, node.qhi[a] + half * 4, 4);
+            __m128 lo = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(loBytes)));
+            __m128 hi = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(hiBytes)));
+            __m128 s  = _mm_set1_ps(scale[a]);
+            __m128 o  = _mm_set1_ps(offset[a]);
+            __m128 t0 = _mm_add_ps(_mm_mul_ps(lo, s), o);
+            __m128 t1 = _mm_add_ps(_mm_mul_ps(hi, s), o);
+            tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+            tFar  = _mm_min_ps(tFar,  _mm_max_ps(t0, t1));
+        }
+        _mm_storeu_ps(tNearOut + half * 4, tNear);
+        mask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(tNear, tFar))) << (half * 4);
+    }
+    return mask & node.validMask;
+}
+#endif
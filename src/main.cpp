@@ -6,10 +6,20 @@
 #include "AccelStructure.h"
 #include "RTPipeline.h"
 #include "Renderer.h"
+#include "CpuTracer.h"
+#include "CpuProfiler.h"
+#include "BvhBenchmark.h"
+#include "ImageIO.h"
 
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <iomanip>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
 // ---------------------------------------------------------------------------
 // Window dimensions
@@ -18,39 +28,403 @@ static constexpr uint32_t WIDTH  = 1280;
 static constexpr uint32_t HEIGHT = 720;
 
 // ---------------------------------------------------------------------------
-// main
+// Command-line options
+// ---------------------------------------------------------------------------
+struct Options {
+    bool        headless = false;
+    bool        cpu      = false;      // CPU reference tracer, implies headless
+    bool        bvhStats = false;      // build CPU BVHs, print quality report, exit
+    bool        benchBvh = false;      // binary vs wide BVH traversal benchmark, exit
+    bool        wavefront      = false;  // CPU tracer: ray-stream execution
+    bool        benchWavefront = false;  // per-path vs wavefront comparison, exit
+    uint32_t    rays     = 1u << 20;   // rays per benchmark pass
+    uint32_t    threads  = 0;          // CPU tracer worker count, 0 = all cores
+    uint32_t    width    = WIDTH;
+    uint32_t    height   = HEIGHT;
+    uint32_t    spp      = 256;        // headless only
+    uint32_t    bounces  = 4;
+    uint32_t    samplesPerFrame = 1;   // GPU paths per pixel per dispatch
+    float       frameBudget = 0.0f;    // windowed: ms per GPU frame the samples per frame aim at, 0 = fixed
+    float       stillBudget = 0.0f;    // the same while the view is still, 0 = frameBudget
+    float       minRenderScale = 1.0f; // with frameBudget: lowest per-axis scale while moving
+    float       adaptive = 0.0f;       // adaptive sampling error target, 0 = off
+    uint32_t    adaptiveMinSpp = 16;   // samples before a pixel may stop
+    uint32_t    denoise  = 0;          // a-trous filter passes, 0 = off
+    bool        aov      = false;      // headless: also write first-hit AOVs next to the output
+    std::string output   = "render.png";
+    std::string model;                 // .obj / .ply / .glb / .gltf / .rtscene instead of the spheres
+    bool        sceneCache = true;     // load / write <model>.rtscene next to the model
+    bool        compactBlas = true;    // compact BLASes after building them
+    bool        pipelineCache = true;  // load / write pipeline.cache in the working directory
+    bool        animate  = false;      // bob the instances every frame (TLAS refit)
+    uint32_t    framesInFlight = 2;    // CPU frames recorded ahead of the GPU
+    bool        gpuProfile = false;    // GPU pass timings, printed at exit
+    std::string gpuTrace;              // Chrome trace JSON of the GPU passes, written at exit
+    bool        cpuProfile = false;    // CPU zone timings, printed at exit
+    std::string cpuTrace;              // Chrome trace JSON of the CPU zones, written at exit
+};
+
+static void printUsage(const char* exe)
+{
+    std::cout <<
+        "Usage: " << exe << " [options]\n"
+        "  --headless          Render offscreen (no window) and write an image\n"
+        "  --width  <px>       Render width            (default " << WIDTH  << ")\n"
+        "  --height <px>       Render height           (default " << HEIGHT << ")\n"
+        "  --spp    <n>        Samples per pixel       (headless, default 256)\n"
+        "  --bounces <n>       Max path bounces        (default 4)\n"
+        "  --samples-per-frame <n>  GPU paths per pixel per dispatch (default 1)\n"
+        "  --frame-budget <ms> Windowed: adjust samples per frame to this GPU frame time (e.g. 16)\n"
+        "  --still-budget <ms> Frame budget while the view is still (e.g. 250; default: --frame-budget)\n"
+        "  --min-render-scale <s>  With --frame-budget: trace at down to s x resolution while moving (e.g. 0.5)\n"
+        "  --adaptive <err>    Stop sampling pixels whose relative standard error is below err\n"
+        "                      (e.g. 0.01); with --headless, --spp becomes the cap\n"
+        "  --adaptive-min-spp <n>  Samples every pixel takes before it may stop (default 16)\n"
+        "  --denoise <n>       Filter the image with n edge-avoiding a-trous passes (1-" << Denoiser::kMaxIterations << ", e.g. 5)\n"
+        "  --output <file>     Output image, .png/.hdr/.pfm (headless, default render.png)\n"
+        "  --aov               Also write first-hit albedo / normal / depth / ID as <output>_*.pfm (headless)\n"
+        "  --model <file>      Load an .obj / binary .ply / .glb / .gltf / .rtscene in place of the spheres\n"
+        "  --no-scene-cache    Do not read or write the <model>.rtscene cache next to the model\n"
+        "  --no-blas-compaction  Keep BLASes at their build size instead of compacting them\n"
+        "  --no-pipeline-cache Compile the RT pipeline from scratch; do not read or write pipeline.cache\n"
+        "  --animate           Move the scene instances every frame (windowed; refits the TLAS)\n"
+        "  --frames-in-flight <n>  Frames the CPU may queue ahead of the GPU, 1-" << MAX_FRAMES_IN_FLIGHT << " (default 2)\n"
+        "  --gpu-profile       Time GPU passes with timestamp queries, print min/avg/p99 at exit\n"
+        "  --gpu-trace <file>  Like --gpu-profile, and write every pass as Chrome trace JSON\n"
+        "  --cpu-profile       Time startup and per-frame CPU zones, print a summary at exit\n"
+        "  --cpu-trace <file>  Like --cpu-profile, and write every zone as Chrome trace JSON\n"
+        "  --cpu               Use the multithreaded CPU reference tracer (no GPU)\n"
+        "  --threads <n>       CPU worker threads: tracer, BVH build, mesh loading (default: all cores)\n"
+        "  --bvh-stats         Build CPU BVHs and print time / nodes / SAH cost\n"
+        "  --bench-bvh         Benchmark binary vs 8-wide BVH traversal and exit\n"
+        "  --wavefront         CPU tracer: trace each bounce as a sorted ray stream\n"
+        "  --bench-wavefront   Compare per-path and wavefront CPU tracing and exit\n"
+        "  --rays <n>          Rays per benchmark pass    (default 1048576)\n"
+        "  --help              Show this message\n";
+}
+
+// Returns false if the program should exit (bad arguments or --help).
+static bool parseArgs(int argc, char** argv, Options& opt)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc)
+                throw std::runtime_error(std::string("Missing value for ") + arg);
+            return argv[++i];
+        };
+        auto uintValue = [&]() -> uint32_t {
+            // stoul accepts "-1" (wrapping to ULONG_MAX), leading blanks and
+            // trailing junk, so require the whole argument to be decimal digits
+            const char* v = value();
+            const auto  bad = [&]() {
+                return std::runtime_error(std::string(arg) + " expects an unsigned integer, got \"" + v + "\"");
+            };
+            if (!std::isdigit(static_cast<unsigned char>(v[0])))
+                throw bad();
+            size_t             used = 0;
+            unsigned long long n    = 0;
+            try {
+                n = std::stoull(v, &used);
+            } catch (const std::out_of_range&) {
+                throw bad();
+            }
+            if (v[used] != '\0' || n > UINT32_MAX)
+                throw bad();
+            if (n == 0 && std::strcmp(arg, "--bounces") != 0)
+                throw std::runtime_error(std::string(arg) + " must be > 0");
+            return static_cast<uint32_t>(n);
+        };
+        auto floatValue = [&]() -> float {
+            // Same for stof: it skips leading blanks, stops at the first
+            // non-number character ("16ms") and accepts "nan" / "inf"
+            const char* v = value();
+            const auto  bad = [&]() {
+                return std::runtime_error(std::string(arg) + " expects a number, got \"" + v + "\"");
+            };
+            if (std::isspace(static_cast<unsigned char>(v[0])))
+                throw bad();
+            size_t used = 0;
+            float  f    = 0.0f;
+            try {
+                f = std::stof(v, &used);
+            } catch (const std::invalid_argument&) {
+                throw bad();
+            } catch (const std::out_of_range&) {
+                throw bad();
+            }
+            if (used != std::strlen(v) || !std::isfinite(f))
+                throw bad();
+            return f;
+        };
+        auto msValue = [&]() -> float {
+            float ms = floatValue();
+            if (!(ms > 0.0f))
+                throw std::runtime_error(std::string(arg) + " must be > 0");
+            return ms;
+        };
+
+        if      (!std::strcmp(arg, "--headless")) opt.headless = true;
+        else if (!std::strcmp(arg, "--width"))    opt.width    = uintValue();
+        else if (!std::strcmp(arg, "--height"))   opt.height   = uintValue();
+        else if (!std::strcmp(arg, "--spp"))      opt.spp      = uintValue();
+        else if (!std::strcmp(arg, "--bounces"))  opt.bounces  = uintValue();
+        else if (!std::strcmp(arg, "--samples-per-frame")) opt.samplesPerFrame = uintValue();
+        else if (!std::strcmp(arg, "--frame-budget")) opt.frameBudget = msValue();
+        else if (!std::strcmp(arg, "--still-budget")) opt.stillBudget = msValue();
+        else if (!std::strcmp(arg, "--min-render-scale")) {
+            opt.minRenderScale = floatValue();
+            if (!(opt.minRenderScale > 0.0f && opt.minRenderScale <= 1.0f))
+                throw std::runtime_error("--min-render-scale must be in (0, 1]");
+        }
+        else if (!std::strcmp(arg, "--adaptive")) {
+            opt.adaptive = floatValue();
+            if (!(opt.adaptive >= 0.0f))
+                throw std::runtime_error("--adaptive must be >= 0");
+        }
+        else if (!std::strcmp(arg, "--adaptive-min-spp")) opt.adaptiveMinSpp = uintValue();
+        else if (!std::strcmp(arg, "--denoise")) {
+            opt.denoise = uintValue();
+            if (opt.denoise > Denoiser::kMaxIterations)
+                throw std::runtime_error("--denoise takes at most " +
+                                         std::to_string(Denoiser::kMaxIterations) + " passes");
+        }
+        else if (!std::strcmp(arg, "--output"))   opt.output   = value();
+        else if (!std::strcmp(arg, "--aov"))      opt.aov      = true;
+        else if (!std::strcmp(arg, "--model"))    opt.model    = value();
+        else if (!std::strcmp(arg, "--no-scene-cache")) opt.sceneCache = false;
+        else if (!std::strcmp(arg, "--no-blas-compaction")) opt.compactBlas = false;
+        else if (!std::strcmp(arg, "--no-pipeline-cache")) opt.pipelineCache = false;
+        else if (!std::strcmp(arg, "--animate"))  opt.animate  = true;
+        else if (!std::strcmp(arg, "--frames-in-flight")) {
+            opt.framesInFlight = uintValue();
+            if (opt.framesInFlight > MAX_FRAMES_IN_FLIGHT)
+                throw std::runtime_error("--frames-in-flight must be 1-" +
+                                         std::to_string(MAX_FRAMES_IN_FLIGHT));
+        }
+        else if (!std::strcmp(arg, "--gpu-profile")) opt.gpuProfile = true;
+        else if (!std::strcmp(arg, "--gpu-trace")) { opt.gpuTrace = value(); opt.gpuProfile = true; }
+        else if (!std::strcmp(arg, "--cpu-profile")) opt.cpuProfile = true;
+        else if (!std::strcmp(arg, "--cpu-trace")) { opt.cpuTrace = value(); opt.cpuProfile = true; }
+        else if (!std::strcmp(arg, "--cpu"))      opt.cpu      = opt.headless = true;
+        else if (!std::strcmp(arg, "--threads"))  opt.threads  = uintValue();
+        else if (!std::strcmp(arg, "--bvh-stats")) opt.bvhStats = true;
+        else if (!std::strcmp(arg, "--bench-bvh")) opt.benchBvh = true;
+        else if (!std::strcmp(arg, "--rays"))     opt.rays     = uintValue();
+        else if (!std::strcmp(arg, "--wavefront")) opt.wavefront = true;
+        else if (!std::strcmp(arg, "--bench-wavefront")) opt.benchWavefront = true;
+        else if (!std::strcmp(arg, "--help") || !std::strcmp(arg, "-h")) {
+            printUsage(argv[0]);
+            return false;
+        } else {
+            std::cerr << "Unknown option: " << arg << '\n';
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    if (opt.stillBudget > 0.0f && opt.frameBudget <= 0.0f)
+        throw std::runtime_error("--still-budget needs --frame-budget");
+    if (opt.minRenderScale < 1.0f && opt.frameBudget <= 0.0f)
+        throw std::runtime_error("--min-render-scale needs --frame-budget");
+    if (opt.aov && (!opt.headless || opt.cpu))
+        throw std::runtime_error("--aov needs a headless GPU render (--headless, not --cpu)");
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// CPU reference path — no Vulkan at all
+// ---------------------------------------------------------------------------
+static int runCpu(const Options& opt)
+{
+    try {
+        Scene scene;
+        std::cout << "Building scene...\n";
+        scene.buildScene(opt.model, opt.threads, opt.sceneCache);
+
+        CpuTracer tracer;
+        tracer.maxBounces  = opt.bounces;
+        tracer.threadCount = opt.threads;
+        tracer.wavefront   = opt.wavefront;
+        tracer.build(scene);
+        tracer.render(scene, opt.width, opt.height, opt.spp);
+
+        writeImage(opt.output, opt.width, opt.height, tracer.image().data());
+        std::cout << "[CpuTracer] Wrote " << opt.output << '\n';
+    } catch (const std::exception& e) {
+        std::cerr << "[FATAL] " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// BVH quality report — one row per mesh plus the instance level
 // ---------------------------------------------------------------------------
-int main()
+static int runBvhStats(const Options& opt)
 {
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW\n";
+    Scene     scene;
+    CpuTracer tracer;
+    try {
+        scene.buildScene(opt.model, opt.threads, opt.sceneCache);
+        tracer.threadCount = opt.threads;
+        tracer.build(scene);
+    } catch (const std::exception& e) {
+        std::cerr << "[FATAL] " << e.what() << '\n';
         return 1;
     }
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE,  GLFW_FALSE); // no resize handling needed for now
 
-    GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT,
-                                          "Vulkan RTX Path Tracer", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Failed to create GLFW window\n";
-        glfwTerminate();
+    auto row = [](const std::string& name, size_t prims, const BvhStats& s) {
+        std::cout << std::left  << std::setw(12) << name
+                  << std::right << std::setw(10) << prims
+                  << std::setw(10) << s.nodeCount
+                  << std::setw(9)  << s.leafCount
+                  << std::setw(7)  << s.maxDepth
+                  << std::setw(10) << std::fixed << std::setprecision(2) << s.sahCost
+                  << std::setw(11) << std::setprecision(3) << s.buildMs << '\n';
+    };
+
+    std::cout << std::left  << std::setw(12) << "BVH"
+              << std::right << std::setw(10) << "prims" << std::setw(10) << "nodes"
+              << std::setw(9) << "leaves" << std::setw(7) << "depth"
+              << std::setw(10) << "SAH" << std::setw(11) << "ms" << '\n';
+    for (size_t m = 0; m < scene.meshes.size(); ++m)
+        row("mesh " + std::to_string(m), scene.meshes[m].indexCount() / 3, tracer.meshBvhStats(m));
+    row("instances", scene.instances.size(), tracer.instanceBvhStats());
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// BVH traversal benchmark
+// ---------------------------------------------------------------------------
+static int runBenchBvh(const Options& opt)
+{
+    try {
+        Scene scene;
+        scene.buildScene(opt.model, opt.threads, opt.sceneCache);
+        runBvhBenchmark(scene, opt.rays, opt.threads);
+    } catch (const std::exception& e) {
+        std::cerr << "[FATAL] " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Per-path vs wavefront CPU tracing. Paths are deterministic, so the work done
+// for bounces 0-1 is identical at --bounces 1 and --bounces N; the difference
+// between the two runs isolates the incoherent bounce 2+ segments.
+// ---------------------------------------------------------------------------
+static int runBenchWavefront(const Options& opt)
+{
+    if (opt.bounces < 2) {
+        std::cerr << "--bench-wavefront needs --bounces >= 2\n";
+        return 1;
+    }
+
+    struct Run { double seconds; uint64_t rays; std::vector<float> image; };
+
+    try {
+        Scene scene;
+        scene.buildScene(opt.model, opt.threads, opt.sceneCache);
+
+        CpuTracer tracer;
+        tracer.threadCount = opt.threads;
+        tracer.build(scene);
+
+        auto run = [&](bool wavefront, uint32_t bounces) {
+            tracer.wavefront  = wavefront;
+            tracer.maxBounces = bounces;
+            tracer.render(scene, opt.width, opt.height, opt.spp);
+            return Run{tracer.stats().seconds, tracer.stats().rays, tracer.image()};
+        };
+
+        Run pathShort = run(false, 1), pathFull = run(false, opt.bounces);
+        Run waveShort = run(true,  1), waveFull = run(true,  opt.bounces);
+
+        auto deepRate = [](const Run& shortRun, const Run& fullRun) {
+            double dt = fullRun.seconds - shortRun.seconds;
+            return dt > 0.0 ? (fullRun.rays - shortRun.rays) / dt * 1e-6 : 0.0;
+        };
+        double pathDeep = deepRate(pathShort, pathFull);
+        double waveDeep = deepRate(waveShort, waveFull);
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << "[Bench] all bounces : per-path " << pathFull.rays / pathFull.seconds * 1e-6
+                  << " Mrays/s, wavefront " << waveFull.rays / waveFull.seconds * 1e-6 << " Mrays/s\n"
+                  << "[Bench] bounce 2+   : per-path " << pathDeep
+                  << " Mrays/s, wavefront " << waveDeep << " Mrays/s ("
+                  << (pathDeep > 0.0 ? waveDeep / pathDeep : 0.0) << "x)\n"
+                  << "[Bench] images " << (pathFull.image == waveFull.image ? "identical" : "DIFFER")
+                  << '\n';
+    } catch (const std::exception& e) {
+        std::cerr << "[FATAL] " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// CPU zone summary / trace at exit
+// ---------------------------------------------------------------------------
+static void reportCpuProfile(const Options& opt)
+{
+    if (!opt.cpuProfile)
+        return;
+    CpuProfiler::report();
+    if (!opt.cpuTrace.empty())
+        CpuProfiler::writeChromeTrace(opt.cpuTrace);
+}
+
+// ---------------------------------------------------------------------------
+// main
+// ---------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    Options opt;
+    try {
+        if (!parseArgs(argc, argv, opt))
+            return 1;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
         return 1;
     }
 
-    glfwSetKeyCallback(window, [](GLFWwindow* w, int key, int, int action, int) {
-        if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
-            glfwSetWindowShouldClose(w, GLFW_TRUE);
-    });
+    CpuProfiler::setEnabled(opt.cpuProfile);
 
-    // Shader SPIR-V files are placed next to the executable in a /shaders/ sub-folder
-    // by the CMake build system.  Use the executable's working directory as the base.
-    std::filesystem::path shaderPath =
-        std::filesystem::current_path() / "shaders" / "";
+    int toolExit = -1;
+    if      (opt.bvhStats)       toolExit = runBvhStats(opt);
+    else if (opt.benchBvh)       toolExit = runBenchBvh(opt);
+    else if (opt.benchWavefront) toolExit = runBenchWavefront(opt);
+    else if (opt.cpu)            toolExit = runCpu(opt);
+    if (toolExit >= 0) {
+        reportCpuProfile(opt);
+        return toolExit;
+    }
+
+    GLFWwindow* window = nullptr;
+
+    if (!opt.headless) {
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW\n";
+            return 1;
+        }
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_RESIZABLE,  GLFW_FALSE); // no resize handling needed for now
 
-    // Normalise to forward slashes (works on all platforms)
-    std::string shaderDir = shaderPath.generic_string();
-    if (!shaderDir.empty() && shaderDir.back() != '/')
-        shaderDir += '/';
+        window = glfwCreateWindow(static_cast<int>(opt.width), static_cast<int>(opt.height),
+                                  "Vulkan RTX Path Tracer", nullptr, nullptr);
+        if (!window) {
+            std::cerr << "Failed to create GLFW window\n";
+            glfwTerminate();
+            return 1;
+        }
+
+        glfwSetKeyCallback(window, [](GLFWwindow* w, int key, int, int action, int) {
+            if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+                glfwSetWindowShouldClose(w, GLFW_TRUE);
+        });
+    }
 
     VulkanContext  ctx;
     Scene          scene;
@@ -58,48 +432,113 @@ int main()
     RTPipeline     rtPipeline;
     Renderer       renderer;
 
+    int exitCode = 0;
+
     try {
-        std::cout << "Initialising Vulkan context...\n";
-        ctx.init(window, WIDTH, HEIGHT);
+        const uint64_t startupNs = CpuProfiler::nowNs();
+
+        std::cout << "Initialising Vulkan context"
+                  << (opt.headless ? " (headless)" : "") << "...\n";
+        ctx.framesInFlight   = opt.framesInFlight;
+        // The frame budget controller reads its timings from the profiler
+        ctx.profiler.enabled = opt.gpuProfile || (!opt.headless && opt.frameBudget > 0.0f);
+        ctx.profiler.trace   = !opt.gpuTrace.empty();
+        ctx.init(window, opt.width, opt.height);
 
         std::cout << "Building scene...\n";
-        scene.buildScene();
+        scene.buildScene(opt.model, opt.threads, opt.sceneCache);
         scene.uploadToGPU(ctx);
 
         std::cout << "Building acceleration structures...\n";
+        accel.compactBLASes = opt.compactBlas;
         accel.buildBLASes(ctx, scene);
         accel.buildTLAS  (ctx, scene);
 
-        std::cout << "Building RT pipeline (shader dir: " << shaderDir << ")...\n";
-        rtPipeline.build(ctx, shaderDir);
+        std::cout << "Building RT pipeline...\n";
+        rtPipeline.maxBounces   = opt.bounces;
+        rtPipeline.writeAovs    = opt.denoise > 0 || opt.aov;
+        rtPipeline.writeMoments = opt.adaptive > 0.0f || opt.denoise > 0;
+        if (opt.pipelineCache)
+            rtPipeline.cacheFile = "pipeline.cache";
+        rtPipeline.build(ctx, scene);
 
         std::cout << "Initialising renderer...\n";
+        renderer.adaptiveThreshold  = opt.adaptive;
+        renderer.adaptiveMinSamples = opt.adaptiveMinSpp;
+        renderer.samplesPerFrame    = opt.samplesPerFrame;
+        renderer.denoiser.iterations = opt.denoise;
+        if (!opt.headless) {
+            renderer.frameBudgetMs  = opt.frameBudget;
+            renderer.stillBudgetMs  = opt.stillBudget;
+            renderer.minRenderScale = opt.minRenderScale;
+        }
         renderer.init(ctx, scene, accel, rtPipeline);
 
-        std::cout << "Ready.  Controls: WASD/QE = move, RMB-drag = look, ESC = quit\n";
+        // Context creation through renderer set-up, i.e. up to the first frame
+        if (CpuProfiler::enabled())
+            CpuProfiler::record("startup", startupNs, CpuProfiler::nowNs());
+
+        if (opt.headless) {
+            float aspect = static_cast<float>(opt.width) / static_cast<float>(opt.height);
+            renderer.renderOffscreen(ctx, scene, rtPipeline, aspect, opt.spp);
+            renderer.saveImage(ctx, opt.output);
+            if (opt.aov)
+                renderer.saveAovs(ctx, std::filesystem::path(opt.output).replace_extension().string());
+        } else {
+            std::cout << "Ready.  Controls: WASD/QE = move, RMB-drag = look, ESC = quit\n";
+
+            double lastTime = glfwGetTime();
 
-        double lastTime = glfwGetTime();
+            // Everything but static instances (the floor) bobs around its
+            // authored transform
+            std::vector<glm::mat4> baseTransforms;
+            for (const SceneInstance& si : scene.instances)
+                baseTransforms.push_back(si.transform);
 
-        while (!glfwWindowShouldClose(window)) {
-            double now = glfwGetTime();
-            float  dt  = static_cast<float>(now - lastTime);
-            lastTime   = now;
+            while (!glfwWindowShouldClose(window)) {
+                double now = glfwGetTime();
+                float  dt  = static_cast<float>(now - lastTime);
+                lastTime   = now;
 
-            glfwPollEvents();
+                glfwPollEvents();
 
-            int w, h;
-            glfwGetFramebufferSize(window, &w, &h);
-            if (w == 0 || h == 0) continue; // minimised
+                int w, h;
+                glfwGetFramebufferSize(window, &w, &h);
+                if (w == 0 || h == 0) continue; // minimised
 
-            scene.camera.processInput(window, dt);
-            renderer.drawFrame(ctx, scene, accel, rtPipeline,
-                               static_cast<float>(w) / static_cast<float>(h));
+                scene.camera.processInput(window, dt);
+                if (opt.animate) {
+                    for (size_t i = 0; i < scene.instances.size(); ++i) {
+                        if (scene.instances[i].isStatic)
+                            continue;
+                        float y = 0.25f * std::sin(2.0f * static_cast<float>(now) + static_cast<float>(i));
+                        scene.instances[i].transform =
+                            glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, y, 0.0f)) * baseTransforms[i];
+                    }
+                    scene.instancesMoved = true;
+                }
+                renderer.drawFrame(ctx, scene, accel, rtPipeline,
+                                   static_cast<float>(w) / static_cast<float>(h));
+
+                // Keeps the per-thread rings from filling on long sessions
+                if (CpuProfiler::enabled())
+                    CpuProfiler::collect();
+            }
         }
 
         vkDeviceWaitIdle(ctx.device);
 
+        if (opt.gpuProfile) {
+            ctx.profiler.collect(ctx);
+            ctx.profiler.report();
+        }
+        if (!opt.gpuTrace.empty())
+            ctx.profiler.writeChromeTrace(opt.gpuTrace);
+        reportCpuProfile(opt);
+
     } catch (const std::exception& e) {
         std::cerr << "[FATAL] " << e.what() << '\n';
+        exitCode = 1;
     }
 
     renderer.destroy(ctx);
@@ -108,7 +547,9 @@ int main()
     scene.destroy(ctx);
     ctx.destroy();
 
-    glfwDestroyWindow(window);
-    glfwTerminate();
-    return 0;
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+    return exitCode;
 }
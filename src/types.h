@@ -22,13 +22,15 @@ struct Material {
     float     _pad[2];
 };
 
-// Per-mesh data uploaded to the GPU so the closest-hit shader can look up
-// vertex/index data and material by instanceCustomIndex.
+// Per-instance data uploaded to the GPU so the closest-hit shaders can look up
+// vertex/index data by instanceCustomIndex (= scene instance index). The
+// material itself arrives in the hit record. Instances of the same mesh
+// share its offsets and BLAS.
 struct InstanceData {
     uint32_t vertexOffset;   // first vertex in the global vertex buffer
     uint32_t indexOffset;    // first index  in the global index  buffer
     uint32_t materialIndex;
-    uint32_t pad;
+    uint32_t meshIndex;
 };
 
 // Camera matrices updated every frame.
@@ -37,11 +39,19 @@ struct CameraUBO {
     glm::mat4 invProj;
     uint32_t  sampleCount;   // accumulation counter (0 = first frame after reset)
     uint32_t  frameIndex;
-    float     _pad[2];
+    float     varianceThreshold;   // adaptive sampling: relative error target, 0 = off
+    uint32_t  minSamples;          // paths a pixel takes before it may stop
+    uint32_t  samplesPerFrame;     // paths per pixel in this dispatch
+    uint32_t  pathCount;           // paths per pixel before it (pipelines without moments)
+    uint32_t  _pad[2];
 };
 
-// Small push-constant block (available in both raygen and closest-hit).
-struct PushConstants {
-    uint32_t maxBounces;
-    uint32_t samplesPerFrame;
+// Push constants of one à-trous denoiser pass (atrous.comp).
+struct AtrousPushConstants {
+    glm::ivec2 size;          // traced region of the images
+    int32_t    stepWidth;     // 2^pass
+    uint32_t   flags;         // 1 = demodulate the input, 2 = remodulate the output
+    float      sigmaColor;
+    float      sigmaNormal;
+    float      sigmaDepth;
 };
@@ -0,0 +1,163 @@
+// ---------------------------------------------------------------------------
+// Bvh structural tests — builds over small fixed meshes and walks the tree:
+// every primitive sits in exactly one leaf, every node's bounds contain its
+// children (and a leaf's its primitives), leaves stay within the size the
+// wide BVH can encode and the depth stays within Bvh::MAX_DEPTH.
+// Exit code is the number of failed checks.
+// ---------------------------------------------------------------------------
+#include "Bvh.h"
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what)
+{
+    if (!ok) {
+        std::cerr << "FAILED: " << what << '\n';
+        ++failures;
+    }
+}
+
+struct Triangle {
+    glm::vec3 p[3];
+};
+
+bool contains(const glm::vec3& outerMin, const glm::vec3& outerMax,
+              const glm::vec3& innerMin, const glm::vec3& innerMax)
+{
+    return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+           outerMax.x >= innerMax.x && outerMax.y >= innerMax.y && outerMax.z >= innerMax.z;
+}
+
+// Sphere of (2 * stacks * slices) triangles, some of them degenerate at the poles
+std::vector<Triangle> sphere(int stacks, int slices)
+{
+    auto point = [&](int i, int j) {
+        float theta = 3.14159265f * float(i) / float(stacks);
+        float phi   = 2.0f * 3.14159265f * float(j) / float(slices);
+        return glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta),
+                         std::sin(theta) * std::sin(phi));
+    };
+    std::vector<Triangle> tris;
+    for (int i = 0; i < stacks; ++i)
+        for (int j = 0; j < slices; ++j) {
+            tris.push_back({{point(i, j), point(i + 1, j), point(i, j + 1)}});
+            tris.push_back({{point(i + 1, j), point(i + 1, j + 1), point(i, j + 1)}});
+        }
+    return tris;
+}
+
+// Flat n x n grid of quads split into two triangles each
+std::vector<Triangle> grid(int n)
+{
+    std::vector<Triangle> tris;
+    for (int z = 0; z < n; ++z)
+        for (int x = 0; x < n; ++x) {
+            glm::vec3 a(float(x), 0.0f, float(z)), b(float(x + 1), 0.0f, float(z));
+            glm::vec3 c(float(x), 0.0f, float(z + 1)), d(float(x + 1), 0.0f, float(z + 1));
+            tris.push_back({{a, b, c}});
+            tris.push_back({{b, d, c}});
+        }
+    return tris;
+}
+
+void checkBvh(const char* name, const std::vector<Triangle>& tris, uint32_t threads)
+{
+    const std::string tag = std::string(name) + ": ";
+
+    std::vector<Aabb> bounds(tris.size());
+    for (size_t t = 0; t < tris.size(); ++t)
+        for (const glm::vec3& p : tris[t].p)
+            bounds[t].grow(p);
+
+    Bvh bvh;
+    bvh.build(bounds, threads);
+    check(!bvh.empty(), tag + "tree is empty");
+    if (bvh.empty())
+        return;
+    check(bvh.primIndices.size() == tris.size(), tag + "primIndices size");
+
+    std::vector<uint32_t> references(tris.size(), 0);
+    uint32_t maxDepth = 0;
+    bool     boundsOk = true, leavesOk = true, indicesOk = true;
+
+    struct Entry { uint32_t node, depth; };
+    std::vector<Entry> stack{{0, 1}};
+    while (!stack.empty()) {
+        const Entry    e    = stack.back();
+        const BvhNode& node = bvh.nodes[e.node];
+        stack.pop_back();
+        maxDepth = std::max(maxDepth, e.depth);
+
+        if (node.isLeaf()) {
+            // WideBvh encodes leaves of at most 8 primitives
+            leavesOk &= node.count <= 8;
+            if (uint64_t(node.leftOrFirst) + node.count > bvh.primIndices.size()) {
+                indicesOk = false;
+                continue;
+            }
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+                const uint32_t prim = bvh.primIndices[i];
+                if (prim >= tris.size()) {
+                    indicesOk = false;
+                    continue;
+                }
+                ++references[prim];
+                boundsOk &= contains(node.boundsMin, node.boundsMax,
+                                     bounds[prim].min, bounds[prim].max);
+            }
+            continue;
+        }
+
+        if (node.leftOrFirst + 1 >= bvh.nodes.size()) {
+            indicesOk = false;
+            continue;
+        }
+        for (uint32_t c = node.leftOrFirst; c <= node.leftOrFirst + 1; ++c) {
+            boundsOk &= contains(node.boundsMin, node.boundsMax,
+                                 bvh.nodes[c].boundsMin, bvh.nodes[c].boundsMax);
+            stack.push_back({c, e.depth + 1});
+        }
+    }
+
+    check(indicesOk, tag + "node or primitive index out of range");
+    check(boundsOk,  tag + "a node's bounds do not contain its children");
+    check(leavesOk,  tag + "leaf holds more than 8 primitives");
+
+    uint32_t missing = 0, repeated = 0;
+    for (uint32_t r : references) {
+        missing  += r == 0;
+        repeated += r > 1;
+    }
+    check(missing == 0 && repeated == 0,
+          tag + std::to_string(missing) + " triangles unreferenced, " +
+          std::to_string(repeated) + " referenced more than once");
+
+    check(maxDepth <= Bvh::MAX_DEPTH, tag + "depth " + std::to_string(maxDepth) +
+                                      " exceeds Bvh::MAX_DEPTH");
+    check(maxDepth == bvh.stats.maxDepth, tag + "stats.maxDepth does not match the tree");
+}
+
+} // namespace
+
+int main()
+{
+    // Single-threaded, then large enough to fork subtrees and split binning
+    checkBvh("sphere",     sphere(24, 48), 1);
+    checkBvh("grid",       grid(192),      4);
+
+    // Identical boxes give SAH nothing to split on; the depth cap has to
+    // bring every leaf down to size anyway
+    checkBvh("degenerate", std::vector<Triangle>(20000, sphere(1, 3)[0]), 4);
+
+    if (failures == 0)
+        std::cout << "BvhTest: all checks passed\n";
+    return failures;
+}
@@ -0,0 +1,140 @@
+// ---------------------------------------------------------------------------
+// MeshLoader regression tests — writes small meshes to the temp directory,
+// loads them back with several threads and checks the result.
+// Exit code is the number of failed checks.
+// ---------------------------------------------------------------------------
+#include "MeshLoader.h"
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what)
+{
+    if (!ok) {
+        std::cerr << "FAILED: " << what << '\n';
+        ++failures;
+    }
+}
+
+std::string tempPath(const char* name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+template <typename T>
+void put(std::ofstream& out, T v)
+{
+    out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+// ---------------------------------------------------------------------------
+// Binary PLY mixing triangles and quads: the all-triangles fast path must
+// give way to the general path instead of failing on misaligned records
+// ---------------------------------------------------------------------------
+void testPlyMixedTrianglesAndQuads()
+{
+    const uint32_t vertexCount = 64;
+    const uint32_t faceCount   = 4096;
+
+    // Quads scattered through the file so several worker ranges hit one.
+    // Every face ends in index 3: read at a triangle stride after a quad,
+    // that low byte looks like a triangle's vertex count, so a decoder that
+    // does not confirm the layout first trips over the garbage behind it.
+    std::vector<std::vector<uint32_t>> faces(faceCount);
+    std::vector<uint32_t>              expected;
+    for (uint32_t f = 0; f < faceCount; ++f) {
+        const uint32_t n = (f % 97 == 13) ? 4 : 3;
+        for (uint32_t k = 0; k + 1 < n; ++k)
+            faces[f].push_back((f * 7 + k * 5) % vertexCount);
+        faces[f].push_back(3);
+        for (uint32_t k = 2; k < n; ++k)
+            expected.insert(expected.end(), {faces[f][0], faces[f][k - 1], faces[f][k]});
+    }
+
+    const std::string path = tempPath("rt_mesh_mixed.ply");
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "ply\nformat binary_little_endian 1.0\n"
+            << "element vertex " << vertexCount << "\n"
+            << "property float x\nproperty float y\nproperty float z\n"
+            << "element face " << faceCount << "\n"
+            << "property list uchar int vertex_indices\nend_header\n";
+        for (uint32_t v = 0; v < vertexCount; ++v) {
+            put(out, float(v % 8));
+            put(out, float(v / 8));
+            put(out, float((v * 3) % 5));
+        }
+        for (const std::vector<uint32_t>& face : faces) {
+            put(out, static_cast<uint8_t>(face.size()));
+            for (uint32_t i : face)
+                put(out, static_cast<int32_t>(i));
+        }
+    }
+
+    MeshData mesh;
+    try {
+        loadMesh(path, mesh, 8);
+    } catch (const std::exception& e) {
+        check(false, std::string("mixed tri/quad PLY loads: ") + e.what());
+        return;
+    }
+    check(mesh.vertices.size() == vertexCount, "mixed tri/quad PLY vertex count");
+    check(mesh.indices == expected, "mixed tri/quad PLY fan-triangulated indices");
+    std::filesystem::remove(path);
+}
+
+// ---------------------------------------------------------------------------
+// OBJ where only some corners have a vn: the file's normals are kept and
+// only the others are computed
+// ---------------------------------------------------------------------------
+void testObjPartialNormals()
+{
+    const std::string path = tempPath("rt_mesh_partial_normals.obj");
+    {
+        std::ofstream out(path, std::ios::trunc);
+        out << "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+               "v 5 0 0\nv 6 0 0\nv 5 1 0\n"
+               "vn 1 0 0\n"
+               "f 1//1 2//1 3//1\n"   // supplied normal, deliberately not the face normal
+               "f 4 5 6\n";           // no normals: gets the face normal, +z
+    }
+
+    MeshData mesh;
+    try {
+        loadMesh(path, mesh, 4);
+    } catch (const std::exception& e) {
+        check(false, std::string("partial-normal OBJ loads: ") + e.what());
+        return;
+    }
+    check(mesh.vertices.size() == 6, "partial-normal OBJ vertex count");
+    for (size_t v = 0; v < mesh.vertices.size() && v < 6; ++v) {
+        const glm::vec3 n    = mesh.vertices[v].normal;
+        const glm::vec3 want = v < 3 ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+        check(glm::length(n - want) < 1e-5f,
+              "partial-normal OBJ vertex " + std::to_string(v) +
+              (v < 3 ? " keeps its file normal" : " gets a computed normal"));
+    }
+    std::filesystem::remove(path);
+}
+
+} // namespace
+
+int main()
+{
+    testPlyMixedTrianglesAndQuads();
+    testObjPartialNormals();
+
+    if (failures == 0)
+        std::cout << "MeshLoaderTest: all checks passed\n";
+    return failures;
+}
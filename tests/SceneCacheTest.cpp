@@ -0,0 +1,189 @@
+// ---------------------------------------------------------------------------
+// SceneCache tests — round-trips a small scene through writeSceneCache /
+// loadSceneCache, then damages copies of the file (truncated, other format
+// version, index past its mesh, other key) and checks each is rejected
+// without touching the scene it was loaded into.
+// Exit code is the number of failed checks.
+// ---------------------------------------------------------------------------
+#include "SceneCache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what)
+{
+    if (!ok) {
+        std::cerr << "FAILED: " << what << '\n';
+        ++failures;
+    }
+}
+
+std::string tempPath(const char* name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+std::vector<char> readFile(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+void writeFile(const std::string& path, const std::vector<char>& bytes)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// Two meshes (a quad and a triangle), three instances, two materials
+Scene makeScene()
+{
+    Scene scene;
+
+    MeshData quad;
+    quad.vertices = {
+        {{-1, 0, -1}, {0, 1, 0}, {0, 0}}, {{ 1, 0, -1}, {0, 1, 0}, {1, 0}},
+        {{ 1, 0,  1}, {0, 1, 0}, {1, 1}}, {{-1, 0,  1}, {0, 1, 0}, {0, 1}},
+    };
+    quad.indices = {0, 1, 2, 0, 2, 3};
+    scene.meshes.push_back(std::move(quad));
+
+    MeshData tri;
+    tri.vertices = {
+        {{0, 0, 0}, {0, 0, 1}, {0, 0}}, {{1, 0, 0}, {0, 0, 1}, {1, 0}}, {{0, 1, 0}, {0, 0, 1}, {0, 1}},
+    };
+    tri.indices = {0, 1, 2};
+    scene.meshes.push_back(std::move(tri));
+
+    scene.materials.push_back({{0.8f, 0.8f, 0.8f}, 0.0f, {0, 0, 0}, 0.9f, 1.5f, 0, {0, 0}});
+    scene.materials.push_back({{1.0f, 0.9f, 0.8f}, 0.0f, {6, 5, 4}, 0.9f, 1.5f, 0, {0, 0}});
+
+    SceneInstance floor;
+    floor.meshIndex     = 0;
+    floor.transform     = glm::mat4(1.0f);
+    floor.materialIndex = 0;
+    floor.isStatic      = true;
+    scene.instances.push_back(floor);
+
+    for (int i = 0; i < 2; ++i) {
+        SceneInstance inst;
+        inst.meshIndex     = 1;
+        inst.transform     = glm::translate(glm::mat4(1.0f), glm::vec3(float(i), 2.0f, 0.0f));
+        inst.materialIndex = static_cast<uint32_t>(i);
+        scene.instances.push_back(inst);
+    }
+    return scene;
+}
+
+bool sameGeometry(const MeshData& a, const MeshData& b)
+{
+    if (a.vertexCount() != b.vertexCount() || a.indexCount() != b.indexCount())
+        return false;
+    std::vector<Vertex>   va(a.vertexCount()), vb(b.vertexCount());
+    std::vector<uint32_t> ia(a.indexCount()),  ib(b.indexCount());
+    a.writeVertices(va.data()); a.writeIndices(ia.data());
+    b.writeVertices(vb.data()); b.writeIndices(ib.data());
+    return std::memcmp(va.data(), vb.data(), va.size() * sizeof(Vertex)) == 0 && ia == ib;
+}
+
+// ---------------------------------------------------------------------------
+// Round trip: everything written comes back bit for bit
+// ---------------------------------------------------------------------------
+void testRoundTrip(const std::string& path, const Scene& original)
+{
+    Scene loaded;
+    check(loadSceneCache(path, loaded, 42), "round trip: cache does not load");
+    check(loaded.meshes.size()    == original.meshes.size(),    "round trip: mesh count");
+    check(loaded.instances.size() == original.instances.size(), "round trip: instance count");
+    check(loaded.materials.size() == original.materials.size(), "round trip: material count");
+    if (failures)
+        return;
+
+    for (size_t m = 0; m < original.meshes.size(); ++m)
+        check(sameGeometry(original.meshes[m], loaded.meshes[m]),
+              "round trip: mesh " + std::to_string(m) + " geometry differs");
+    for (size_t i = 0; i < original.instances.size(); ++i) {
+        const SceneInstance& a = original.instances[i];
+        const SceneInstance& b = loaded.instances[i];
+        check(a.meshIndex == b.meshIndex && a.materialIndex == b.materialIndex &&
+              a.isStatic == b.isStatic &&
+              std::memcmp(&a.transform, &b.transform, sizeof(a.transform)) == 0,
+              "round trip: instance " + std::to_string(i) + " differs");
+    }
+    check(std::memcmp(original.materials.data(), loaded.materials.data(),
+                      original.materials.size() * sizeof(Material)) == 0,
+          "round trip: materials differ");
+}
+
+// ---------------------------------------------------------------------------
+// Damaged caches are refused and leave the target scene as it was
+// ---------------------------------------------------------------------------
+void expectRejected(const char* what, const std::vector<char>& bytes, uint64_t key = 42)
+{
+    const std::string path = tempPath("rt_cache_damaged.rtscene");
+    writeFile(path, bytes);
+
+    Scene scene;
+    scene.materials.resize(1);
+    check(!loadSceneCache(path, scene, key), std::string(what) + ": cache was accepted");
+    check(scene.meshes.empty() && scene.instances.empty() && scene.materials.size() == 1,
+          std::string(what) + ": rejected load modified the scene");
+    std::filesystem::remove(path);
+}
+
+void testRejects(const std::string& path)
+{
+    const std::vector<char> good = readFile(path);
+    check(good.size() > 64, "cache file is implausibly small");
+    if (good.size() <= 64)
+        return;
+
+    // Cut inside the index section (the last one), and inside the header
+    expectRejected("truncated", std::vector<char>(good.begin(), good.end() - 4));
+    expectRejected("truncated header", std::vector<char>(good.begin(), good.begin() + 16));
+
+    // The format version follows the 8-byte magic
+    std::vector<char> version = good;
+    uint32_t v;
+    std::memcpy(&v, version.data() + 8, sizeof(v));
+    ++v;
+    std::memcpy(version.data() + 8, &v, sizeof(v));
+    expectRejected("wrong version", version);
+
+    // The file ends with the last mesh's indices (the 3-vertex triangle)
+    std::vector<char> index = good;
+    const uint32_t    outOfRange = 3;
+    std::memcpy(index.data() + index.size() - sizeof(uint32_t), &outOfRange, sizeof(uint32_t));
+    expectRejected("out-of-range index", index);
+
+    expectRejected("other key", good, 43);
+}
+
+} // namespace
+
+int main()
+{
+    const std::string path  = tempPath("rt_cache_test.rtscene");
+    const Scene       scene = makeScene();
+    check(writeSceneCache(path, scene, 42), "writeSceneCache failed");
+
+    if (failures == 0) {
+        testRoundTrip(path, scene);
+        testRejects(path);
+    }
+    std::filesystem::remove(path);
+
+    if (failures == 0)
+        std::cout << "SceneCacheTest: all checks passed\n";
+    return failures;
+}
@@ -0,0 +1,159 @@
+// ---------------------------------------------------------------------------
+// WideBvh agreement test — closest-hit distance and any-hit result of the
+// 8-wide quantized BVH must match a brute-force loop over every triangle.
+// Catches conservative-quantization and SIMD slab-test regressions; ctest
+// runs it once per kernel via RT_WIDEBVH_KERNEL (see WideBvh::kernelName).
+// Exit code is the number of failed checks.
+// ---------------------------------------------------------------------------
+#include "WideBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what)
+{
+    if (!ok) {
+        std::cerr << "FAILED: " << what << '\n';
+        ++failures;
+    }
+}
+
+struct Mesh {
+    std::vector<Vertex>   vertices;
+    std::vector<uint32_t> indices;
+};
+
+// Small triangles in a few clusters far apart, so node frames have to
+// quantize children that are tiny relative to the node
+Mesh clusteredSoup(uint32_t triCount, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> U(0.0f, 1.0f);
+    const glm::vec3 centres[] = {{0, 0, 0}, {40, 3, -7}, {-25, 60, 12}, {5, -30, 80}};
+
+    Mesh mesh;
+    for (uint32_t t = 0; t < triCount; ++t) {
+        const glm::vec3 c = centres[t % 4] + glm::vec3(U(rng), U(rng), U(rng)) * 6.0f;
+        for (int k = 0; k < 3; ++k) {
+            Vertex v{};
+            v.pos = c + (glm::vec3(U(rng), U(rng), U(rng)) - glm::vec3(0.5f)) * 0.6f;
+            mesh.indices.push_back(static_cast<uint32_t>(mesh.vertices.size()));
+            mesh.vertices.push_back(v);
+        }
+    }
+    return mesh;
+}
+
+// Closed, indexed sphere: shared edges and exactly axis-aligned rays
+Mesh sphere(int stacks, int slices)
+{
+    Mesh mesh;
+    for (int i = 0; i <= stacks; ++i)
+        for (int j = 0; j <= slices; ++j) {
+            float theta = 3.14159265f * float(i) / float(stacks);
+            float phi   = 2.0f * 3.14159265f * float(j) / float(slices);
+            Vertex v{};
+            v.pos = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta),
+                              std::sin(theta) * std::sin(phi)) * 3.0f;
+            mesh.vertices.push_back(v);
+        }
+    for (int i = 0; i < stacks; ++i)
+        for (int j = 0; j < slices; ++j) {
+            uint32_t a = i * (slices + 1) + j, b = a + slices + 1;
+            mesh.indices.insert(mesh.indices.end(), {a, b, a + 1, b, b + 1, a + 1});
+        }
+    return mesh;
+}
+
+void checkAgreement(const char* name, const Mesh& mesh, std::mt19937& rng, uint32_t rayCount)
+{
+    const std::string  tag      = std::string(name) + ": ";
+    const uint32_t     triCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+    const MeshGeometry geo{mesh.vertices.data(), mesh.indices.data()};
+    auto corner = [&](uint32_t t, int k) { return mesh.vertices[mesh.indices[t * 3 + k]].pos; };
+
+    std::vector<Aabb> bounds(triCount);
+    for (uint32_t t = 0; t < triCount; ++t)
+        for (int k = 0; k < 3; ++k)
+            bounds[t].grow(corner(t, k));
+
+    Bvh binary;
+    binary.build(bounds, 4);
+    WideBvh wide;
+    wide.build(binary);
+    check(wide.depth >= 1 && wide.depth <= Bvh::MAX_DEPTH, tag + "wide depth out of range");
+
+    const BvhNode& root   = binary.nodes[0];
+    const glm::vec3 centre = (root.boundsMin + root.boundsMax) * 0.5f;
+    const float     radius = glm::length(root.boundsMax - root.boundsMin);
+    std::uniform_real_distribution<float> U(0.0f, 1.0f);
+
+    uint32_t hits = 0, closestWrong = 0, occludedWrong = 0;
+    for (uint32_t r = 0; r < rayCount; ++r) {
+        glm::vec3 origin, dir;
+        if (r % 8 == 0) {
+            // Axis-aligned: zero direction components hit safeInverse's clamp
+            const int axis = (r / 8) % 3;
+            origin = root.boundsMin + (root.boundsMax - root.boundsMin)
+                                    * glm::vec3(U(rng), U(rng), U(rng));
+            origin[axis] = centre[axis] - radius;
+            dir = glm::vec3(0.0f);
+            dir[axis] = 1.0f;
+        } else {
+            glm::vec3 out = glm::vec3(U(rng), U(rng), U(rng)) * 2.0f - glm::vec3(1.0f);
+            origin = centre + glm::normalize(out + glm::vec3(1e-3f)) * radius;
+            // Toward a random triangle's bounds, so sparse meshes still get hit
+            const Aabb& b = bounds[std::min(triCount - 1, uint32_t(U(rng) * float(triCount)))];
+            glm::vec3 target = b.min + (b.max - b.min) * glm::vec3(U(rng), U(rng), U(rng));
+            dir = glm::normalize(target - origin);
+        }
+
+        const float tMin = 1e-3f, tMax = 1e4f;
+        float bestT = tMax;
+        bool  found = false;
+        for (uint32_t t = 0; t < triCount; ++t) {
+            float hitT, u, v;
+            if (intersectTriangle(origin, dir, corner(t, 0), corner(t, 1), corner(t, 2),
+                                  tMin, bestT, hitT, u, v)) {
+                bestT = hitT;
+                found = true;
+            }
+        }
+        hits += found;
+
+        // Equal-distance triangles (shared edges) may report either primitive,
+        // so only the distance is compared
+        TriangleHit hit;
+        const bool wideFound = wide.intersect(geo, origin, dir, tMin, tMax, hit);
+        closestWrong  += wideFound != found || (found && hit.t != bestT);
+        occludedWrong += wide.occluded(geo, origin, dir, tMin, tMax) != found;
+    }
+
+    check(hits > rayCount / 10, tag + "too few rays hit to mean anything (" +
+                                std::to_string(hits) + ")");
+    check(closestWrong == 0,  tag + std::to_string(closestWrong)  + " closest hits disagree");
+    check(occludedWrong == 0, tag + std::to_string(occludedWrong) + " any-hit results disagree");
+}
+
+} // namespace
+
+int main()
+{
+    std::cout << "WideBvhTest: " << WideBvh::kernelName() << " kernel\n";
+
+    std::mt19937 rng(7);
+    checkAgreement("clustered soup", clusteredSoup(4000, rng), rng, 4000);
+    checkAgreement("sphere",         sphere(32, 64),           rng, 4000);
+
+    if (failures == 0)
+        std::cout << "WideBvhTest: all checks passed\n";
+    return failures;
+}